@@ -26,6 +26,7 @@
 #define IDENTICAL_NAME "patchdiff:identical"
 #define FLAGUNFLAG_NAME "patchdiff:flagunflag"
 #define MSYM_NAME "patchdiff:msym"
+#define BDIFF_NAME "patchdiff:bdiff"
 #define IUNMATCH_NAME "patchdiff:iunmatch"
 #define ITOM_NAME "patchdiff:itom"
 #define ISYM_NAME "patchdiff:isym"
@@ -75,6 +76,16 @@ struct msym_action_handler_t : public action_handler_t {
    virtual action_state_t idaapi update(action_update_ctx_t *ctx);
 };
 
+struct bdiff_action_handler_t : public action_handler_t {
+
+   pd_plugmod_t *plugin;
+
+   bdiff_action_handler_t(pd_plugmod_t *plug) : plugin(plug) {};
+
+   virtual int idaapi activate(action_activation_ctx_t *ctx);
+   virtual action_state_t idaapi update(action_update_ctx_t *ctx);
+};
+
 struct iunmatch_action_handler_t : public action_handler_t {
 
    pd_plugmod_t *plugin;
@@ -196,10 +196,10 @@ static size_t singleton_serialize(char *buf, size_t blen, sig_t *s, int nfile) {
 static size_t singleton_unserialize(char *buf, size_t blen, sig_t **s, int version) {
    char tmp[512];
    size_t pos = 0;
-   char c;
-   int num, i;
-   ea_t ea;
-   int type;
+   char c = 0;
+   int num = 0, i;
+   ea_t ea = 0;
+   int type = 0;
 
    *s = new sig_t();
    if (!(*s)) {
@@ -226,6 +226,10 @@ static size_t singleton_unserialize(char *buf, size_t blen, sig_t **s, int versi
 
    buffer_unserialize_int(buf, blen, &pos, &num);
    for (i = 0; i < num; i++) {
+      // truncated entry
+      if (pos >= blen) {
+         break;
+      }
       buffer_unserialize_ea(buf, blen, &pos, &ea);
       buffer_unserialize_int(buf, blen, &pos, &type);
 
@@ -282,43 +286,231 @@ static size_t pair_unserialize(char *buf, size_t blen, sig_t **s, int version) {
    return len;
 }
 
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4   // shorter matches would not save space
+#define LZ_MAX_MATCH (127 + LZ_MIN_MATCH)
+#define LZ_MAX_LIT   128
+#define LZ_MAX_OFF   0xFFFF
+
+/*------------------------------------------------*/
+/* function : lz_bound                            */
+/* description: Returns the largest packed size   */
+/*              of len bytes                      */
+/*------------------------------------------------*/
+
+static size_t lz_bound(size_t len) {
+   return len + len / LZ_MAX_LIT + 1;
+}
+
+/*------------------------------------------------*/
+/* function : lz_pack                             */
+/* description: Compresses len bytes of src into  */
+/*              dst (lz_bound(len) bytes)         */
+/* note: control byte c < 0x80 is followed by c+1 */
+/*       literals, otherwise it is a match of     */
+/*       (c & 0x7f) + 4 bytes at a 16 bits offset */
+/*------------------------------------------------*/
+
+static size_t lz_pack(const uchar *src, size_t len, uchar *dst) {
+   uint32_t *table;
+   size_t pos, lit, ref, out, mlen, n;
+   uint32_t h;
+
+   table = new uint32_t[1 << LZ_HASH_BITS];
+   memset(table, 0xFF, sizeof(uint32_t) << LZ_HASH_BITS);
+
+   pos = lit = out = 0;
+
+   while (pos < len) {
+      mlen = 0;
+
+      if (pos + LZ_MIN_MATCH <= len) {
+         h = (((uint32_t)src[pos] << 24) | (src[pos + 1] << 16) | (src[pos + 2] << 8) | src[pos + 3]) * 2654435761U;
+         h >>= 32 - LZ_HASH_BITS;
+         ref = table[h];
+         table[h] = (uint32_t)pos;
+
+         if (ref != 0xFFFFFFFF && pos - ref <= LZ_MAX_OFF && !memcmp(src + ref, src + pos, LZ_MIN_MATCH)) {
+            mlen = LZ_MIN_MATCH;
+            while (mlen < LZ_MAX_MATCH && pos + mlen < len && src[ref + mlen] == src[pos + mlen]) {
+               mlen++;
+            }
+         }
+      }
+
+      if (!mlen) {
+         pos++;
+         if (pos - lit == LZ_MAX_LIT) {
+            dst[out++] = (uchar)(LZ_MAX_LIT - 1);
+            memcpy(dst + out, src + lit, LZ_MAX_LIT);
+            out += LZ_MAX_LIT;
+            lit = pos;
+         }
+         continue;
+      }
+
+      // flushes the pending literals
+      n = pos - lit;
+      if (n) {
+         dst[out++] = (uchar)(n - 1);
+         memcpy(dst + out, src + lit, n);
+         out += n;
+      }
+
+      dst[out++] = (uchar)(0x80 | (mlen - LZ_MIN_MATCH));
+      dst[out++] = (uchar)((pos - ref) & 0xFF);
+      dst[out++] = (uchar)((pos - ref) >> 8);
+
+      pos += mlen;
+      lit = pos;
+   }
+
+   n = pos - lit;
+   if (n) {
+      dst[out++] = (uchar)(n - 1);
+      memcpy(dst + out, src + lit, n);
+      out += n;
+   }
+
+   delete [] table;
+
+   return out;
+}
+
+/*------------------------------------------------*/
+/* function : lz_unpack                           */
+/* description: Decompresses src into dst         */
+/*              (exactly dlen bytes)              */
+/*------------------------------------------------*/
+
+static bool lz_unpack(const uchar *src, size_t len, uchar *dst, size_t dlen) {
+   size_t pos, out, n, off;
+   uchar c;
+
+   pos = out = 0;
+
+   while (pos < len) {
+      c = src[pos++];
+
+      if (c < 0x80) {
+         n = (size_t)c + 1;
+         if (pos + n > len || out + n > dlen) {
+            return false;
+         }
+         memcpy(dst + out, src + pos, n);
+         pos += n;
+         out += n;
+      }
+      else {
+         n = (size_t)(c & 0x7F) + LZ_MIN_MATCH;
+         if (pos + 2 > len) {
+            return false;
+         }
+         off = src[pos] | (src[pos + 1] << 8);
+         pos += 2;
+         if (!off || off > out || out + n > dlen) {
+            return false;
+         }
+         // overlapping copies repeat the pattern
+         for (; n; n--, out++) {
+            dst[out] = dst[out - off];
+         }
+      }
+   }
+
+   return out == dlen;
+}
+
+/*------------------------------------------------*/
+/* function : backup_save_chunk                   */
+/* description: Compresses and saves a chunk of   */
+/*              serialized entries                */
+/*------------------------------------------------*/
+
+static void backup_save_chunk(netnode &node, uint32_t num, const uchar *raw, bkchunk_t *ck) {
+   uchar *packed;
+   size_t len;
+
+   packed = new uchar[lz_bound(ck->raw_size)];
+   len = lz_pack(raw, ck->raw_size, packed);
+
+   if (len >= ck->raw_size) {
+      len = ck->raw_size;
+      node.setblob(raw, len, (nodeidx_t)num << BACKUP_CHUNK_SHIFT, 'C');
+   }
+   else {
+      node.setblob(packed, len, (nodeidx_t)num << BACKUP_CHUNK_SHIFT, 'C');
+   }
+   ck->packed_size = (uint32_t)len;
+
+   delete [] packed;
+}
+
 /*------------------------------------------------*/
 /* function : backup_save_list                    */
 /* description: Backups result list inside a      */
-/*              netnode                           */
+/*              netnode (version 4)               */
 /*------------------------------------------------*/
 
 static void backup_save_list(const char *node_name, slist_t *sl) {
-   char buf[5000];
-   size_t i;
-   size_t len;
+   qvector<uchar> raw;
+   qvector<uint32_t> offs;
+   qvector<bkchunk_t> chunks;
+   bkindex_t hdr;
+   bkchunk_t ck;
+   uchar *index;
+   char *buf;
+   size_t i, len, isize;
    netnode node;
 
    if (!sl) return;
 
    node.create(node_name);
 
+   buf = new char[BACKUP_ENTRY_SIZE];
+   ck.first = 0;
+
    for (i = 0; i < sl->num; i++) {
-      nodeidx_t nidx = node.altval(i);
-      if (nidx != 0) {
-         msg("backup failed: netnode already exists !!\n");
-         return;
+      if (sl->sigs[i]->msig != NULL) {
+         len = pair_serialize(buf, BACKUP_ENTRY_SIZE, sl->sigs[i]);
+      }
+      else {
+         len = singleton_serialize(buf, BACKUP_ENTRY_SIZE, sl->sigs[i], sl->sigs[i]->nfile);
       }
 
-      netnode n(nidx);
+      offs.push_back((uint32_t)raw.size());
+      raw.resize(raw.size() + len);
+      memcpy(&raw[raw.size() - len], buf, len);
 
-      n.create();
-      node.altset(i, n);
+      if (raw.size() >= BACKUP_CHUNK_SIZE || i + 1 == sl->num) {
+         ck.num = (uint32_t)(i + 1 - ck.first);
+         ck.raw_size = (uint32_t)raw.size();
+         backup_save_chunk(node, (uint32_t)chunks.size(), &raw[0], &ck);
+         chunks.push_back(ck);
 
-      if (sl->sigs[i]->msig != NULL) {
-         len = pair_serialize(buf, sizeof(buf), sl->sigs[i]);
-      }
-      else {
-         len = singleton_serialize(buf, sizeof(buf), sl->sigs[i], sl->sigs[i]->nfile);
+         ck.first = (uint32_t)(i + 1);
+         raw.clear();
       }
+   }
+
+   delete [] buf;
+
+   hdr.num = (uint32_t)sl->num;
+   hdr.nchunks = (uint32_t)chunks.size();
 
-      n.setblob(buf, len, 0, 'P');
+   isize = sizeof(hdr) + chunks.size() * sizeof(bkchunk_t) + offs.size() * sizeof(uint32_t);
+   index = new uchar[isize];
+   memcpy(index, &hdr, sizeof(hdr));
+   len = sizeof(hdr);
+   if (!chunks.empty()) {
+      memcpy(index + len, &chunks[0], chunks.size() * sizeof(bkchunk_t));
+      len += chunks.size() * sizeof(bkchunk_t);
+      memcpy(index + len, &offs[0], offs.size() * sizeof(uint32_t));
    }
+
+   node.setblob(index, isize, 0, 'I');
+
+   delete [] index;
 }
 
 /*------------------------------------------------*/
@@ -366,21 +558,254 @@ static bool backup_load_list(const char *node_name, slist_t *sl, int type, int v
    return true;
 }
 
+/*------------------------------------------------*/
+/* function : backup_get_blob                     */
+/* description: Reads a whole netnode blob        */
+/*              (NULL if missing)                 */
+/*------------------------------------------------*/
+
+static uchar *backup_get_blob(netnode &node, nodeidx_t start, char tag, size_t *size) {
+   uchar *buf;
+
+   *size = node.blobsize(start, tag);
+   if (!*size) {
+      return NULL;
+   }
+
+   buf = new uchar[*size];
+   if (!node.getblob(buf, size, start, tag)) {
+      delete [] buf;
+      return NULL;
+   }
+
+   return buf;
+}
+
+// version 4 list loaded on demand: the last decompressed chunks are kept
+// so that neighbouring rows do not unpack their chunk again
+#define BACKUP_CACHE_CHUNKS 4
+
+struct bklazy_t {
+   slazy_t base;
+   netnode node;
+   uchar *index;
+   const bkindex_t *hdr;
+   const bkchunk_t *chunks;
+   const uint32_t *offs;
+   int type;
+   int version;
+   uchar *raw[BACKUP_CACHE_CHUNKS];   // most recently used first
+   uint32_t cid[BACKUP_CACHE_CHUNKS];
+   bool *bad;                         // unreadable chunks (reported once)
+};
+
+/*------------------------------------------------*/
+/* function : bklazy_chunk                        */
+/* description: Returns the raw data of chunk i   */
+/*              (from the cache if possible)      */
+/*------------------------------------------------*/
+
+static uchar *bklazy_chunk(bklazy_t *b, uint32_t i) {
+   const bkchunk_t *ck = &b->chunks[i];
+   uchar *blob, *raw;
+   size_t bsize;
+   int j;
+
+   for (j = 0; j < BACKUP_CACHE_CHUNKS && b->raw[j]; j++) {
+      if (b->cid[j] == i) {
+         break;
+      }
+   }
+
+   if (j < BACKUP_CACHE_CHUNKS && b->raw[j]) {
+      raw = b->raw[j];
+   }
+   else {
+      // the other rows of a bad chunk are dropped without a new read
+      if (b->bad[i]) {
+         return NULL;
+      }
+
+      blob = backup_get_blob(b->node, (nodeidx_t)i << BACKUP_CHUNK_SHIFT, 'C', &bsize);
+      if (!blob || bsize != ck->packed_size) {
+         msg("backup failed: list chunk %u is missing !!\n", i);
+         delete [] blob;
+         b->bad[i] = true;
+         return NULL;
+      }
+
+      raw = blob;
+      if (ck->packed_size != ck->raw_size) {
+         raw = new uchar[ck->raw_size];
+         if (!lz_unpack(blob, bsize, raw, ck->raw_size)) {
+            msg("backup failed: list chunk %u is corrupted !!\n", i);
+            delete [] raw;
+            delete [] blob;
+            b->bad[i] = true;
+            return NULL;
+         }
+         delete [] blob;
+      }
+
+      j = BACKUP_CACHE_CHUNKS - 1;
+      delete [] b->raw[j];
+   }
+
+   // moves the chunk to the front
+   for (; j > 0; j--) {
+      b->raw[j] = b->raw[j - 1];
+      b->cid[j] = b->cid[j - 1];
+   }
+   b->raw[0] = raw;
+   b->cid[0] = i;
+
+   return raw;
+}
+
+/*------------------------------------------------*/
+/* function : bklazy_load                         */
+/* description: Unserializes entry id of a lazy   */
+/*              list                              */
+/*------------------------------------------------*/
+
+static sig_t *bklazy_load(slazy_t *lz, uint32_t id) {
+   bklazy_t *b = (bklazy_t *)lz;
+   const bkchunk_t *ck;
+   uint32_t lo, hi, mid;
+   size_t end;
+   uchar *raw;
+   sig_t *sig = NULL;
+
+   if (id >= b->hdr->num) {
+      return NULL;
+   }
+
+   // last chunk starting at or before id
+   lo = 0;
+   hi = b->hdr->nchunks;
+   while (hi - lo > 1) {
+      mid = (lo + hi) / 2;
+      if (b->chunks[mid].first <= id) {
+         lo = mid;
+      }
+      else {
+         hi = mid;
+      }
+   }
+   ck = &b->chunks[lo];
+
+   raw = bklazy_chunk(b, lo);
+   if (!raw) {
+      return NULL;
+   }
+
+   end = (id + 1 < ck->first + ck->num) ? b->offs[id + 1] : ck->raw_size;
+   if (b->offs[id] > end || end > ck->raw_size) {
+      return NULL;
+   }
+
+   if (b->type) {
+      pair_unserialize((char *)raw + b->offs[id], end - b->offs[id], &sig, b->version);
+   }
+   else {
+      singleton_unserialize((char *)raw + b->offs[id], end - b->offs[id], &sig, b->version);
+   }
+
+   return sig;
+}
+
+/*------------------------------------------------*/
+/* function : bklazy_release                      */
+/* description: Frees a lazy list source          */
+/*------------------------------------------------*/
+
+static void bklazy_release(slazy_t *lz) {
+   bklazy_t *b = (bklazy_t *)lz;
+   int j;
+
+   for (j = 0; j < BACKUP_CACHE_CHUNKS; j++) {
+      delete [] b->raw[j];
+   }
+   delete [] b->bad;
+   delete [] b->index;
+   delete b;
+}
+
+/*------------------------------------------------*/
+/* function : backup_load_list4                   */
+/* description: Opens a version 4 result list,    */
+/*              the entries are loaded when the   */
+/*              choosers show them                */
+/*------------------------------------------------*/
+
+static bool backup_load_list4(const char *node_name, slist_t *sl, int type, int version) {
+   const bkindex_t *hdr;
+   const bkchunk_t *chunks;
+   bklazy_t *b;
+   uchar *index;
+   size_t isize;
+   uint32_t i, k;
+   netnode node;
+
+   if (!sl) {
+      return true;
+   }
+   node.create(node_name);
+
+   index = backup_get_blob(node, 0, 'I', &isize);
+   if (!index || isize < sizeof(bkindex_t)) {
+      msg("backup failed: list index does not exist !!\n");
+      delete [] index;
+      return false;
+   }
+
+   hdr = (const bkindex_t *)index;
+   chunks = (const bkchunk_t *)(index + sizeof(bkindex_t));
+
+   i = k = 0;
+   if (isize == sizeof(bkindex_t) + (size_t)hdr->nchunks * sizeof(bkchunk_t) + (size_t)hdr->num * sizeof(uint32_t)) {
+      for (i = 0; i < hdr->nchunks && chunks[i].first == k && chunks[i].num; i++) {
+         k += chunks[i].num;
+      }
+   }
+   if (k != hdr->num || i != hdr->nchunks) {
+      msg("backup failed: list index is corrupted !!\n");
+      delete [] index;
+      return false;
+   }
+
+   b = new bklazy_t();
+   memset(b->raw, 0, sizeof(b->raw));
+   b->base.load = bklazy_load;
+   b->base.release = bklazy_release;
+   b->node = node;
+   b->index = index;
+   b->hdr = hdr;
+   b->chunks = chunks;
+   b->offs = (const uint32_t *)(chunks + hdr->nchunks);
+   b->type = type;
+   b->version = version;
+   b->bad = new bool[hdr->nchunks]();
+
+   sl->set_lazy(&b->base, hdr->num);
+
+   return true;
+}
+
 /*------------------------------------------------*/
 /* function : backup_free_node                    */
 /* description: Removes node from the IDB         */
 /*------------------------------------------------*/
 
-static void backup_free_node(const char *node_name, size_t size) {
+static void backup_free_node(const char *node_name) {
    netnode node;
-   size_t i;
+   nodeidx_t i;
 
    node.create(node_name);
 
-   for (i = 0; i < size; i++) {
-      nodeidx_t nidx = node.altval(i);
-      netnode n(nidx);
-      n.delblob(0, 'P');
+   // versions 1-3 entry netnodes (the blobs go away with the node)
+   for (i = node.altfirst(); i != BADNODE; i = node.altnext(i)) {
+      netnode n(node.altval(i));
       n.kill();
    }
 
@@ -393,11 +818,11 @@ static void backup_free_node(const char *node_name, size_t size) {
 /*------------------------------------------------*/
 
 static void backup_cleanup(deng_t *eng) {
-   backup_free_node("$ pdiff2_matched", eng->mlist ? eng->mlist->org_num : 0);
-   backup_free_node("$ pdiff2_identical", eng->ilist ? eng->ilist->org_num : 0);
-   backup_free_node("$ pdiff2_unmatched", eng->ulist ? eng->ulist->org_num : 0);
+   backup_free_node("$ pdiff2_matched");
+   backup_free_node("$ pdiff2_identical");
+   backup_free_node("$ pdiff2_unmatched");
 
-   backup_free_node("$ pdiff2_eng", 1);
+   backup_free_node("$ pdiff2_eng");
 }
 
 /*------------------------------------------------*/
@@ -407,7 +832,7 @@ static void backup_cleanup(deng_t *eng) {
 
 static void backup_save_eng(const char *node_name, deng_t *eng) {
    char buf[1000];
-   const char *file;
+   const char *file = "";
    size_t pos = 0;
    netnode node;
    size_t msize, isize, usize;
@@ -433,14 +858,17 @@ static void backup_save_eng(const char *node_name, deng_t *eng) {
 
    msize = isize = usize = 0;
    if (eng->mlist) {
+      eng->mlist->pack();
       file = eng->mlist->file;
       msize = eng->mlist->num;
    }
    if (eng->ilist) {
+      eng->ilist->pack();
       file = eng->ilist->file;
       isize = eng->ilist->num;
    }
    if (eng->ulist) {
+      eng->ulist->pack();
       file = eng->ulist->file;
       usize = eng->ulist->num;
    }
@@ -514,6 +942,17 @@ static deng_t *backup_load_eng(const char *node_name, options_t *opt, int *versi
 /*------------------------------------------------*/
 
 void backup_save_results(deng_t *eng) {
+   // the lists may still read their entries from the nodes replaced here
+   if (eng->mlist) {
+      eng->mlist->load_all();
+   }
+   if (eng->ilist) {
+      eng->ilist->load_all();
+   }
+   if (eng->ulist) {
+      eng->ulist->load_all();
+   }
+
    backup_save_eng("$ pdiff2_eng", eng);
 
    backup_save_list("$ pdiff2_matched", eng->mlist);
@@ -527,6 +966,7 @@ void backup_save_results(deng_t *eng) {
 /*------------------------------------------------*/
 
 int backup_load_results(deng_t **eng, options_t *opt) {
+   bool (*load)(const char *, slist_t *, int, int);
    int ret;
    int version;
 
@@ -553,13 +993,14 @@ int backup_load_results(deng_t **eng, options_t *opt) {
       goto error;
    }
    msg("Loading backup results... ");
-   if (!backup_load_list("$ pdiff2_matched", (*eng)->mlist, 1, version)) {
+   load = version >= 4 ? backup_load_list4 : backup_load_list;
+   if (!load("$ pdiff2_matched", (*eng)->mlist, 1, version)) {
       goto error;
    }
-   if (!backup_load_list("$ pdiff2_identical", (*eng)->ilist, 1, version)) {
+   if (!load("$ pdiff2_identical", (*eng)->ilist, 1, version)) {
       goto error;
    }
-   if (!backup_load_list("$ pdiff2_unmatched", (*eng)->ulist, 0, version)) {
+   if (!load("$ pdiff2_unmatched", (*eng)->ulist, 0, version)) {
       goto error;
    }
    msg("done.\n");
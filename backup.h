@@ -24,7 +24,39 @@
 
 // 1: first format
 // 2: adds str hash
-#define PDIFF_BACKUP_VERSION 3
+// 3: adds flag
+// 4: one index blob and a few compressed blobs per list (see below)
+#define PDIFF_BACKUP_VERSION 4
+
+// Version 4 list netnode:
+//
+//    blob (0, 'I')                   bkindex_t
+//                                    bkchunk_t[nchunks]
+//                                    uint32_t[num] entry offsets
+//    blob (i << BACKUP_CHUNK_SHIFT, 'C')   chunk i
+//
+// A chunk holds the serialized entries first..first+num-1 (same entry
+// layout as version 3). Each entry offset is relative to the start of the
+// raw chunk data. A chunk whose packed_size equals raw_size is not
+// compressed.
+//
+// Versions 1-3 store one netnode per entry (altval i of the list node).
+
+#define BACKUP_CHUNK_SIZE  (1024 * 1024)   // raw chunk size
+#define BACKUP_CHUNK_SHIFT 12              // supval slots between chunks
+#define BACKUP_ENTRY_SIZE  0x10000         // largest serialized entry
+
+struct bkindex_t {
+   uint32_t num;        // number of entries
+   uint32_t nchunks;
+};
+
+struct bkchunk_t {
+   uint32_t first;      // first entry
+   uint32_t num;        // number of entries
+   uint32_t raw_size;
+   uint32_t packed_size;
+};
 
 void backup_save_results(deng_t *);
 int backup_load_results(deng_t **, options_t *);
@@ -0,0 +1,288 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "precomp.h"
+
+#include "bdiff.h"
+#include "parser.h"
+#include "system.h"
+#include "options.h"
+
+#ifdef PDIFF_THREADS
+#include <atomic>
+#include <thread>
+#include <vector>
+#endif
+
+/*------------------------------------------------*/
+/* function : bdiff_pair                          */
+/* description: Diffs the blocks of a function    */
+/*              pair and counts the changes       */
+/*------------------------------------------------*/
+
+static void bdiff_pair(bdres_t *res) {
+   slist_t *sl1 = res->sl1;
+   slist_t *sl2 = res->sl2;
+   sig_t *sig;
+   uint32_t i;
+
+   if (!sl1 || !sl2) {
+      return;
+   }
+
+   sl1->sigs[0]->nfile = 1;
+   sl2->sigs[0]->nfile = 2;
+
+   generate_diff(NULL, sl1, sl2, NULL, NULL);
+
+   // same classification as the graph colors
+   for (i = 0; i < sl1->num; i++) {
+      sig = sl1->sigs[i];
+      if (sig->mtype == DIFF_UNMATCHED) {
+         res->removed++;
+      }
+      else if (sig->sig != sig->msig->sig || sig->id_crc) {
+         res->changed++;
+      }
+   }
+
+   for (i = 0; i < sl2->num; i++) {
+      if (sl2->sigs[i]->mtype == DIFF_UNMATCHED) {
+         res->added++;
+      }
+   }
+}
+
+#ifdef PDIFF_THREADS
+/*------------------------------------------------*/
+/* function : bdiff_worker                        */
+/* description: Diffs the pairs left until none   */
+/*              remains                           */
+/*------------------------------------------------*/
+
+static void bdiff_worker(bdres_t *res, size_t num, std::atomic<size_t> *next) {
+   size_t i;
+
+   // pairs are handed one by one: their sizes vary a lot
+   while ((i = (*next)++) < num) {
+      bdiff_pair(&res[i]);
+   }
+}
+#endif
+
+/*------------------------------------------------*/
+/* function : bdiff_compare                       */
+/* description: Sorts the pairs by decreasing     */
+/*              number of block changes           */
+/*------------------------------------------------*/
+
+static int OS_CDECL bdiff_compare(const void *arg1, const void *arg2) {
+   const bdres_t *r1 = (const bdres_t *)arg1;
+   const bdres_t *r2 = (const bdres_t *)arg2;
+   uint32_t v1, v2;
+
+   v1 = r1->added + r1->removed + r1->changed;
+   v2 = r2->added + r2->removed + r2->changed;
+
+   if (v1 != v2) {
+      return v1 > v2 ? -1 : 1;
+   }
+   if (r1->sig->startEA != r2->sig->startEA) {
+      return r1->sig->startEA < r2->sig->startEA ? -1 : 1;
+   }
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : bdiff_save                          */
+/* description: Writes the pairs ranked by block  */
+/*              changes                           */
+/*------------------------------------------------*/
+
+static int bdiff_save(const char *file, bdres_t *res, size_t num) {
+   FILE *fp;
+   size_t i;
+
+   fp = qfopen(file, "w");
+   if (!fp) {
+      return -1;
+   }
+
+   qfprintf(fp, "# score added removed changed blocks1 blocks2 address1 address2 function1 function2\n");
+
+   for (i = 0; i < num; i++) {
+      if (!res[i].sl1 || !res[i].sl2) {
+         continue;
+      }
+
+      qfprintf(fp, "%u %u %u %u %u %u %a %a %s %s\n",
+               res[i].added + res[i].removed + res[i].changed,
+               res[i].added,
+               res[i].removed,
+               res[i].changed,
+               res[i].sl1->num,
+               res[i].sl2->num,
+               res[i].sig->startEA,
+               res[i].sig->msig->startEA,
+               res[i].sig->name.c_str(),
+               res[i].sig->msig->name.c_str());
+   }
+
+   qfclose(fp);
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : bdiff_matched                       */
+/* description: Diffs the blocks of all the       */
+/*              matched functions and saves the   */
+/*              ranked results into file          */
+/*------------------------------------------------*/
+
+int bdiff_matched(deng_t *eng, const char *file) {
+   slist_t *ml = eng->mlist;
+   slist_t **lists1 = NULL, **lists2 = NULL;
+   bdres_t *res;
+   ea_t *eas1, *eas2;
+   size_t num, i, failed;
+   char options;
+   int ret;
+
+   ml->load_all();
+   ml->pack();
+   num = ml->num;
+   if (!num) {
+      return 0;
+   }
+
+   eas1 = new ea_t[num];
+   eas2 = new ea_t[num];
+   for (i = 0; i < num; i++) {
+      eas1[i] = ml->sigs[i]->startEA;
+      eas2[i] = ml->sigs[i]->msig->startEA;
+   }
+
+#if !defined(PDIFF_STANDALONE) && IDA_SDK_VERSION < 700
+   options = dto.graph.s_showpref;
+#else
+   options = 0;  // dto went away in 7.0, not clear how to replicate above
+#endif
+
+   // one request for all the functions of the second idb
+   msg("parsing %u second functions...\n", (uint32_t)num);
+   lists2 = system_parse_fcts(eas2, (uint32_t)num, ml->file, eng->opt);
+   if (!lists2) {
+      msg("Error: FCT2 parsing failed.\n");
+      delete [] eas1;
+      delete [] eas2;
+      return -1;
+   }
+
+   msg("parsing %u first functions...\n", (uint32_t)num);
+   lists1 = parse_fcts(eas1, num, options, eng->opt);
+   if (!lists1) {
+      msg("Error: FCT1 parsing failed.\n");
+      for (i = 0; i < num; i++) {
+         if (lists2[i]) {
+            lists2[i]->free_sigs();
+            delete lists2[i];
+         }
+      }
+      delete [] lists2;
+      delete [] eas1;
+      delete [] eas2;
+      return -1;
+   }
+
+   res = new bdres_t[num];
+   for (i = 0; i < num; i++) {
+      memset(&res[i], 0, sizeof(res[i]));
+      res[i].sig = ml->sigs[i];
+      res[i].sl1 = lists1[i];
+      res[i].sl2 = lists2[i];
+
+      // a function without blocks is handled as a parsing failure
+      if (res[i].sl1 && !res[i].sl1->num) {
+         delete res[i].sl1;
+         res[i].sl1 = NULL;
+      }
+      if (res[i].sl2 && !res[i].sl2->num) {
+         delete res[i].sl2;
+         res[i].sl2 = NULL;
+      }
+   }
+
+   msg("diffing blocks...\n");
+#ifdef PDIFF_THREADS
+   // pairs are independent: unlike the function matching, the results do
+   // not depend on the number of threads. As every parallel path, the
+   // workers are enabled by the diff threads option.
+   size_t nthreads = qmin((size_t)qmax(eng->opt ? eng->opt->options_diff_threads() : 1, 1), num);
+   if (nthreads > 1) {
+      std::vector<std::thread> workers;
+      std::atomic<size_t> next(0);
+
+      for (i = 0; i < nthreads; i++) {
+         workers.push_back(std::thread(bdiff_worker, res, num, &next));
+      }
+      for (i = 0; i < nthreads; i++) {
+         workers[i].join();
+      }
+   }
+   else
+#endif
+   {
+      for (i = 0; i < num; i++) {
+         bdiff_pair(&res[i]);
+      }
+   }
+
+   qsort(res, num, sizeof(*res), bdiff_compare);
+
+   ret = bdiff_save(file, res, num);
+   if (ret) {
+      msg("Error: failed to write %s.\n", file);
+   }
+
+   failed = 0;
+   for (i = 0; i < num; i++) {
+      if (!res[i].sl1 || !res[i].sl2) {
+         failed++;
+      }
+      if (res[i].sl1) {
+         res[i].sl1->free_sigs();
+         delete res[i].sl1;
+      }
+      if (res[i].sl2) {
+         res[i].sl2->free_sigs();
+         delete res[i].sl2;
+      }
+   }
+   if (failed) {
+      msg("%u functions could not be parsed.\n", (uint32_t)failed);
+   }
+
+   delete [] res;
+   delete [] lists1;
+   delete [] lists2;
+   delete [] eas1;
+   delete [] eas2;
+
+   return ret;
+}
@@ -0,0 +1,38 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BDIFF_H__
+#define __BDIFF_H__
+
+#include "precomp.h"
+#include "sig.h"
+#include "diff.h"
+
+// block level diff of a matched function pair
+struct bdres_t {
+   sig_t *sig;          // function of the first idb
+   slist_t *sl1;        // block lists (NULL if the parsing failed)
+   slist_t *sl2;
+   uint32_t added;      // blocks only in the second function
+   uint32_t removed;    // blocks only in the first function
+   uint32_t changed;    // matched blocks with a different signature or crc
+};
+
+int bdiff_matched(deng_t *, const char *);
+
+#endif
@@ -20,6 +20,344 @@
 
 #include "sig.h"
 #include "hash.h"
+#include "diff.h"
+#include "clist.h"
+#include "pool.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct ckey_t {
+   uint32_t v[4];
+
+   bool operator==(const ckey_t &k) const {
+      return !memcmp(v, k.v, sizeof(v));
+   }
+};
+
+struct ckey_hash_t {
+   size_t operator()(const ckey_t &k) const {
+      uint64_t h = ((uint64_t)k.v[0] << 32 | k.v[1]) * 0x9e3779b97f4a7c15ULL;
+
+      h ^= ((uint64_t)k.v[2] << 32 | k.v[3]) + (h >> 29);
+      h *= 0xbf58476d1ce4e5b9ULL;
+
+      return (size_t)(h ^ (h >> 32));
+   }
+};
+
+// elements sharing a key, in list order. Removed elements (moved to
+// msigs) are skipped lazily so the slots never need to be updated.
+struct cslot_t {
+   std::vector<dpsig_t *> nodes;
+   size_t head;   // first possibly live element
+   size_t tail;   // one past the last possibly live element
+   size_t live;   // elements still in the list (str index only)
+
+   cslot_t() : head(0), tail(0), live(0) {}
+};
+
+typedef std::unordered_map<ckey_t, cslot_t, ckey_hash_t> ckmap_t;
+typedef std::unordered_map<std::string, cslot_t> cnmap_t;
+
+struct cindex_t {
+   ckmap_t *keys[DIFF_NEQUAL_STR + 1];
+   cnmap_t *names;
+};
+
+/*------------------------------------------------*/
+/* function : ckey_make                           */
+/* description: Builds the lookup key of sig for  */
+/*              a match type                      */
+/*------------------------------------------------*/
+
+static bool ckey_make(sig_t *sig, int type, ckey_t *k) {
+   memset(k, 0, sizeof(*k));
+
+   // same fields as sig_equal
+   switch (type) {
+      case DIFF_EQUAL_SIG_HASH_CRC:
+         k->v[2] = sig->crc_hash;
+         // fall through
+      case DIFF_EQUAL_SIG_HASH:
+         k->v[0] = sig->sig;
+         k->v[1] = sig->hash;
+         return true;
+      case DIFF_EQUAL_SIG_HASH_CRC_STR:
+         k->v[0] = sig->sig;
+         k->v[1] = sig->hash;
+         k->v[3] = sig->str_hash;
+         return true;
+      case DIFF_NEQUAL_STR:
+         k->v[0] = sig->str_hash;
+         return true;
+   }
+
+   return false;
+}
+
+/*------------------------------------------------*/
+/* function : cindex_reset                        */
+/* description: Drops the lookup tables           */
+/*------------------------------------------------*/
+
+static void cindex_reset(cindex_t *idx) {
+   int i;
+
+   for (i = 0; i <= DIFF_NEQUAL_STR; i++) {
+      delete idx->keys[i];
+      idx->keys[i] = NULL;
+   }
+   delete idx->names;
+   idx->names = NULL;
+}
+
+/*------------------------------------------------*/
+/* function : cindex_free                         */
+/* description: Frees the lookup tables (pool     */
+/*              cleanup callback)                 */
+/*------------------------------------------------*/
+
+static void cindex_free(void *data) {
+   cindex_t *idx = (cindex_t *)data;
+
+   cindex_reset(idx);
+   delete idx;
+}
+
+/*------------------------------------------------*/
+/* function : cslot_first                         */
+/* description: Returns first live element of a   */
+/*              slot                              */
+/*------------------------------------------------*/
+
+static dpsig_t *cslot_first(cslot_t *slot) {
+   while (slot->head < slot->tail && slot->nodes[slot->head]->removed) {
+      slot->head++;
+   }
+   return slot->head < slot->tail ? slot->nodes[slot->head] : NULL;
+}
+
+/*------------------------------------------------*/
+/* function : cslot_last                          */
+/* description: Returns last live element of a    */
+/*              slot                              */
+/*------------------------------------------------*/
+
+static dpsig_t *cslot_last(cslot_t *slot) {
+   while (slot->tail > slot->head && slot->nodes[slot->tail - 1]->removed) {
+      slot->tail--;
+   }
+   return slot->tail > slot->head ? slot->nodes[slot->tail - 1] : NULL;
+}
+
+/*------------------------------------------------*/
+/* function : cindex_slot                         */
+/* description: Returns the slot of sig for type, */
+/*              building the table on first use   */
+/*------------------------------------------------*/
+
+static cslot_t *cindex_slot(clist_t *cl, sig_t *sig, int type) {
+   cindex_t *idx;
+   dpsig_t *ds;
+   cslot_t *slot;
+   ckey_t k;
+
+   if (!cl->idx) {
+      idx = new cindex_t();
+      memset(idx, 0, sizeof(*idx));
+      if (cl->pool) {
+         cl->pool->add_cleanup(cindex_free, idx);
+      }
+      cl->idx = idx;
+   }
+   idx = cl->idx;
+
+   if (type == DIFF_EQUAL_NAME) {
+      if (!idx->names) {
+         idx->names = new cnmap_t();
+         for (ds = cl->sigs; ds; ds = ds->next) {
+            slot = &(*idx->names)[ds->sig->name.c_str()];
+            slot->nodes.push_back(ds);
+            slot->tail = slot->nodes.size();
+         }
+      }
+
+      cnmap_t::iterator it = idx->names->find(sig->name.c_str());
+      return it == idx->names->end() ? NULL : &it->second;
+   }
+
+   if (!ckey_make(sig, type, &k)) {
+      return NULL;
+   }
+
+   if (!idx->keys[type]) {
+      ckey_t dk;
+      uint32_t ord = 0;
+
+      idx->keys[type] = new ckmap_t();
+      for (ds = cl->sigs; ds; ds = ds->next) {
+         ckey_make(ds->sig, type, &dk);
+         slot = &(*idx->keys[type])[dk];
+         slot->nodes.push_back(ds);
+         slot->tail = slot->nodes.size();
+         slot->live++;
+         ds->ord = ord++;
+      }
+   }
+
+   ckmap_t::iterator it = idx->keys[type]->find(k);
+   return it == idx->keys[type]->end() ? NULL : &it->second;
+}
+
+/*------------------------------------------------*/
+/* function : clist_t::index_first                */
+/* description: Returns the first element of the  */
+/*              list with the same type key as sig*/
+/*------------------------------------------------*/
+
+dpsig_t *clist_t::index_first(sig_t *sig, int type) {
+   cslot_t *slot = cindex_slot(this, sig, type);
+
+   return slot ? cslot_first(slot) : NULL;
+}
+
+/*------------------------------------------------*/
+/* function : clist_t::index_last                 */
+/* description: Returns the last element of the   */
+/*              list with the same type key as sig*/
+/*------------------------------------------------*/
+
+dpsig_t *clist_t::index_last(sig_t *sig, int type) {
+   cslot_t *slot = cindex_slot(this, sig, type);
+
+   return slot ? cslot_last(slot) : NULL;
+}
+
+/*------------------------------------------------*/
+/* function : clist_t::index_str_unique           */
+/* description: Returns true if no other element  */
+/*              from position 'from' to the end   */
+/*              of the list has the str_hash of ds*/
+/* note: ds and from must be in the list, ds at   */
+/*       or after from                            */
+/*------------------------------------------------*/
+
+bool clist_t::index_str_unique(dpsig_t *ds, dpsig_t *from) {
+   cslot_t *slot;
+   dpsig_t *ptr;
+   size_t i;
+
+   slot = cindex_slot(this, ds->sig, DIFF_NEQUAL_STR);
+   if (!slot || slot->live <= 1) {
+      return true;
+   }
+
+   // an element after ds is after from
+   if (cslot_last(slot) != ds) {
+      return false;
+   }
+
+   // otherwise look at the closest element before ds
+   for (i = slot->tail - 1; i > slot->head; i--) {
+      ptr = slot->nodes[i - 1];
+      if (!ptr->removed) {
+         return ptr->ord < from->ord;
+      }
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : cindex_remove                       */
+/* description: Updates the str occurrence counts */
+/*              when an element leaves the list   */
+/*------------------------------------------------*/
+
+static void cindex_remove(cindex_t *idx, dpsig_t *ds) {
+   ckmap_t::iterator it;
+   ckey_t k;
+
+   if (!idx->keys[DIFF_NEQUAL_STR]) {
+      return;
+   }
+
+   ckey_make(ds->sig, DIFF_NEQUAL_STR, &k);
+   it = idx->keys[DIFF_NEQUAL_STR]->find(k);
+   if (it != idx->keys[DIFF_NEQUAL_STR]->end() && it->second.live > 0) {
+      it->second.live--;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : clist_mark_matched                  */
+/* description: Accounts the elements of a newly  */
+/*              matched signature as stale in the */
+/*              lists still holding them          */
+/*------------------------------------------------*/
+
+void clist_mark_matched(sig_t *sig) {
+   dpsig_t *ds;
+
+   for (ds = sig->nodes; ds; ds = ds->snext) {
+      if (!ds->removed && !ds->cl->shared) {
+         ds->cl->nstale++;
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : clist_count_stale                   */
+/* description: Recomputes the number of matched  */
+/*              elements still in the list        */
+/*------------------------------------------------*/
+
+void clist_count_stale(clist_t *cl) {
+   dpsig_t *ds;
+
+   cl->nstale = 0;
+   for (ds = cl->sigs; ds; ds = ds->next) {
+      if (ds->sig->get_matched_type() != DIFF_UNMATCHED) {
+         cl->nstale++;
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : clist_t::new_dsig                   */
+/* description: Allocates a list element from the */
+/*              diff session pool (or the heap)   */
+/*------------------------------------------------*/
+
+dpsig_t *clist_t::new_dsig(sig_t *s) {
+   dpsig_t *ds;
+
+   if (pool) {
+      ds = new (pool) dpsig_t();
+   }
+   else {
+      ds = new dpsig_t();
+   }
+   if (!ds) {
+      return NULL;
+   }
+
+   ds->sig = s;
+   ds->prev = NULL;
+   ds->next = NULL;
+   ds->removed = false;
+   ds->cl = this;
+   ds->snext = s->nodes;
+   s->nodes = ds;
+
+   if (s->get_matched_type() != DIFF_UNMATCHED) {
+      nstale++;
+   }
+
+   return ds;
+}
 
 /*------------------------------------------------*/
 /* function : clist_t::clist_t                    */
@@ -27,24 +365,28 @@
 /*              signatures                        */
 /*------------------------------------------------*/
 
-clist_t::clist_t(slist_t *l) {
+clist_t::clist_t(slist_t *l, pool_t *p) {
    dpsig_t *ds;
    dpsig_t *prev;
    size_t i;
 
+   pool = p;
+   nstale = 0;
+   idx = NULL;
+   cref_mark = false;
+   shared = false;
    num = l->num;
    sigs = NULL;
    nmatch = 0;
    msigs = NULL;
+   mpend = NULL;
+   npend = 0;
 
    prev = NULL;
 
    for (i = 0; i < l->num; i++) {
-      ds = new dpsig_t();
+      ds = new_dsig(l->sigs[i]);
       ds->prev = prev;
-      ds->next = NULL;
-      ds->removed = false;
-      ds->sig = l->sigs[i];
 
       if (prev) {
          prev->next = ds;
@@ -70,15 +412,6 @@ int clist_t::insert(sig_t *s) {
    dpsig_t *cur;
    int ret;
 
-   ds = new dpsig_t();
-   if (!ds) {
-      return -1;
-   }
-   ds->sig = s;
-   ds->prev = NULL;
-   ds->next = NULL;
-   ds->removed = false;
-
    prev = NULL;
    cur = sigs;
    while (cur) {
@@ -94,6 +427,13 @@ int clist_t::insert(sig_t *s) {
       cur = cur->next;
    }
 
+   ds = new_dsig(s);
+   if (!ds) {
+      return -1;
+   }
+   if (idx) {
+      cindex_reset(idx);
+   }
    ds->prev = prev;
    ds->next = cur;
 
@@ -113,49 +453,110 @@ int clist_t::insert(sig_t *s) {
 
 /*------------------------------------------------*/
 /* function : clist_t_::insert_dsig               */
-/* description: Inserts dsig in matched list      */
+/* description: Adds element to matched list     */
+/* note: the element is only queued, msigs is     */
+/*       kept sorted by merge_matched             */
 /*------------------------------------------------*/
 
 int clist_t::insert_dsig(dpsig_t *ds) {
-   dpsig_t *prev;
-   dpsig_t *cur;
-   int ret;
-
-   ds->prev = NULL;
-   ds->next = NULL;
    ds->removed = true;
+   ds->prev = NULL;
+   ds->next = mpend;
+   mpend = ds;
+   npend++;
+   nmatch++;
 
-   prev = NULL;
-   cur = msigs;
-   while (cur) {
-      // sig_compare is reversed
-      ret = sig_compare(&ds->sig, &cur->sig) ;
-      if (!ret && cur->sig->startEA == ds->sig->startEA) {
-         return -1;
-      }
+   return 0;
+}
 
-      if (ret <= 0) {
-         break;
+/*------------------------------------------------*/
+/* function : dsig_sort                           */
+/* description: Stable merge sort of n elements   */
+/*              of a chained list                 */
+/*------------------------------------------------*/
+
+static dpsig_t *dsig_sort(dpsig_t *ds, size_t n) {
+   dpsig_t *l, *r;
+   dpsig_t *head;
+   dpsig_t **tail;
+   size_t i;
+
+   if (n <= 1) {
+      if (ds) {
+         ds->next = NULL;
       }
-      prev = cur;
-      cur = cur->next;
+      return ds;
    }
 
-   ds->prev = prev;
-   ds->next = cur;
+   r = ds;
+   for (i = 0; i < n / 2; i++) {
+      r = r->next;
+   }
 
-   if (!prev) {
-      msigs= ds;
+   l = dsig_sort(ds, n / 2);
+   r = dsig_sort(r, n - n / 2);
+
+   tail = &head;
+   while (l && r) {
+      // sig_compare is reversed
+      if (sig_compare(&l->sig, &r->sig) <= 0) {
+         *tail = l;
+         l = l->next;
+      }
+      else {
+         *tail = r;
+         r = r->next;
+      }
+      tail = &(*tail)->next;
    }
-   else {
-      prev->next = ds;
+   *tail = l ? l : r;
+
+   return head;
+}
+
+/*------------------------------------------------*/
+/* function : clist_t::merge_matched              */
+/* description: Merges the queued elements into   */
+/*              the sorted matched list           */
+/* note: a queued element goes before the         */
+/*       elements with the same key, exactly as if*/
+/*       it had been inserted on removal          */
+/*------------------------------------------------*/
+
+void clist_t::merge_matched() {
+   dpsig_t *p, *m;
+   dpsig_t *head;
+   dpsig_t *prev;
+   dpsig_t **tail;
+
+   if (!mpend) {
+      return;
    }
-   if (cur) {
-      cur->prev = ds;
+
+   p = dsig_sort(mpend, npend);
+   m = msigs;
+
+   prev = NULL;
+   tail = &head;
+   while (p || m) {
+      // sig_compare is reversed
+      if (p && (!m || sig_compare(&p->sig, &m->sig) <= 0)) {
+         *tail = p;
+         p = p->next;
+      }
+      else {
+         *tail = m;
+         m = m->next;
+      }
+      (*tail)->prev = prev;
+      prev = *tail;
+      tail = &(*tail)->next;
    }
-   nmatch++;
+   *tail = NULL;
 
-   return 0;
+   msigs = head;
+   mpend = NULL;
+   npend = 0;
 }
 
 /*------------------------------------------------*/
@@ -164,15 +565,22 @@ int clist_t::insert_dsig(dpsig_t *ds) {
 /*              signatures with a list of xrefs   */
 /*------------------------------------------------*/
 
-clist_t::clist_t(hpsig_t *hsig, frefs_t *refs) {
+clist_t::clist_t(hpsig_t *hsig, frefs_t *refs, pool_t *p) {
    fref_t *fl;
    sig_t *sig;
 
+   pool = p;
+   nstale = 0;
+   idx = NULL;
+   cref_mark = false;
+   shared = false;
    num = 0;
    nmatch = 0;
    sigs = NULL;
    pos = NULL;
    msigs = NULL;
+   mpend = NULL;
+   npend = 0;
 
    if (!refs) {
       return;
@@ -199,6 +607,13 @@ void clist_t::remove(dpsig_t *ds) {
    if (ds->removed == true)
       return;
 
+   if (nstale > 0 && ds->sig->get_matched_type() != DIFF_UNMATCHED) {
+      nstale--;
+   }
+   if (idx) {
+      cindex_remove(idx, ds);
+   }
+
    if (ds->prev == NULL) {
       sigs = ds->next;
    }
@@ -220,16 +635,40 @@ void clist_t::reset() {
    pos = sigs;
 }
 
+/*------------------------------------------------*/
+/* function : dsig_free                           */
+/* description: Frees a heap allocated chained    */
+/*              list (iterative)                  */
+/*------------------------------------------------*/
+
+static void dsig_free(dpsig_t *ds) {
+   dpsig_t *next;
+
+   while (ds) {
+      next = ds->next;
+      delete ds;
+      ds = next;
+   }
+}
+
 /*------------------------------------------------*/
 /* function : clist_t::~clist_t                   */
-/* description: Frees clist_t structure           */
+/* description: Frees clist_t structure (pooled   */
+/*              elements go away with the pool)   */
 /*------------------------------------------------*/
 
 clist_t::~clist_t() {
-   delete sigs;
+   if (!pool) {
+      dsig_free(sigs);
+      dsig_free(msigs);
+      dsig_free(mpend);
+      if (idx) {
+         cindex_free(idx);
+      }
+   }
    sigs = NULL;
-   delete msigs;
    msigs = NULL;
+   mpend = NULL;
 }
 
 /*------------------------------------------------*/
@@ -237,7 +676,7 @@ clist_t::~clist_t() {
 /* description: Checks if all the elements of a   */
 /*              clist match                       */
 /*------------------------------------------------*/
-bool clist_t::equal_match(const clist_t &cl2) {
+bool clist_t::equal_match(clist_t &cl2) {
    dpsig_t *s1, *s2;
    size_t i;
 
@@ -247,6 +686,8 @@ bool clist_t::equal_match(const clist_t &cl2) {
    if (nmatch != cl2.nmatch) {
       return false;
    }
+   merge_matched();
+   cl2.merge_matched();
    s1 = msigs;
    s2 = cl2.msigs;
 
@@ -266,7 +707,7 @@ bool clist_t::equal_match(const clist_t &cl2) {
 /* description: Checks if at lest one element of a*/
 /*              clist match                       */
 /*------------------------------------------------*/
-bool clist_t::almost_equal_match(const clist_t &cl2) {
+bool clist_t::almost_equal_match(clist_t &cl2) {
    dpsig_t *s1, *s2;
    size_t i, k;
 
@@ -276,6 +717,8 @@ bool clist_t::almost_equal_match(const clist_t &cl2) {
    if (nmatch != cl2.nmatch) {
       return false;
    }
+   merge_matched();
+   cl2.merge_matched();
    s1 = msigs;
 
    for (i = 0; i < nmatch; i++) {
@@ -22,10 +22,15 @@
 #include "sig.h"
 #include "hash.h"
 
+// lists smaller than this are scanned, not indexed (see get_eq_sig)
+#define CLIST_INDEX_MIN 16
+
 clist_t * clist_init(slist_t *);
 int clist_insert(clist_t *, sig_t *);
 clist_t * clist_init_from_refs(hpsig_t *, frefs_t *);
 void clist_remove(clist_t *, dpsig_t *);
 void clist_reset(clist_t *);
+void clist_mark_matched(sig_t *);
+void clist_count_stale(clist_t *);
 
 #endif
@@ -22,10 +22,16 @@
 #include "sig.h"
 #include "diff.h"
 #include "clist.h"
-#include "display.h"
-#include "backup.h"
 #include "options.h"
-#include "plugin.h"
+#include "pool.h"
+
+#ifdef PDIFF_THREADS
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#endif
 
 /*------------------------------------------------*/
 /* function : diff_init_hash                      */
@@ -80,31 +86,161 @@ static hpsig_t *diff_init_hash(slist_t *sl) {
    return h;
 }
 
+static const char *diff_type_names[DIFF_MANUAL] = {
+   "name",
+   "sig/hash/crc",
+   "sig/hash/crc/str",
+   "sig/hash",
+   "preds",
+   "succs",
+   "str"
+};
+
 /*------------------------------------------------*/
 /* function : slist_init_crefs                    */
 /* description: Initializes slist crefs           */
 /*------------------------------------------------*/
 
-static int slist_init_crefs(slist_t *l) {
+static int slist_init_crefs(slist_t *l, pool_t *pool) {
    hpsig_t *h = NULL;
    clist_t *cl1;
    clist_t *cl2;
    size_t i;
 
+   for (i = 0; i < l->num; i++) {
+      l->sigs[i]->nodes = NULL;
+   }
+
    h = diff_init_hash(l);
    if (!h) {
       return -1;
    }
    for (i = 0; i < l->num; i++) {
-      cl1 = new clist_t(h, l->sigs[i]->get_preds());
-      cl2 = new clist_t(h, l->sigs[i]->get_succs());
+      cl1 = new (pool) clist_t(h, l->sigs[i]->get_preds(), pool);
+      cl2 = new (pool) clist_t(h, l->sigs[i]->get_succs(), pool);
       l->sigs[i]->set_crefs(SIG_PRED, cl1);
       l->sigs[i]->set_crefs(SIG_SUCC, cl2);
    }
 
+   hash_free(h);
+
    return 0;
 }
 
+/*------------------------------------------------*/
+/* function : slist_reset_crefs                   */
+/* description: Detaches slist crefs before the   */
+/*              diff session pool is released     */
+/*------------------------------------------------*/
+
+static void slist_reset_crefs(slist_t *l) {
+   size_t i;
+
+   for (i = 0; i < l->num; i++) {
+      l->sigs[i]->set_crefs(SIG_PRED, NULL);
+      l->sigs[i]->set_crefs(SIG_SUCC, NULL);
+      l->sigs[i]->nodes = NULL;
+   }
+}
+
+// manual match propagation session: the pred/succ lists of the functions
+// are only built when a propagation reaches them
+struct dprop_t {
+   pool_t *pool;
+   hpsig_t *h1;                 // functions of file 1
+   hpsig_t *h2;                 // functions of file 2
+   qvector<sig_t *> touched;    // functions whose lists were built
+   qvector<sig_t *> *found;     // new matches of the current propagation
+};
+
+/*------------------------------------------------*/
+/* function : diff_prop_free                      */
+/* description: Releases a propagation session    */
+/*------------------------------------------------*/
+
+static void diff_prop_free(dprop_t *p) {
+   if (!p) {
+      return;
+   }
+
+   if (p->h1) {
+      hash_free(p->h1);
+   }
+   if (p->h2) {
+      hash_free(p->h2);
+   }
+   delete p->pool;
+   delete p;
+}
+
+/*------------------------------------------------*/
+/* function : diff_prop_clist                     */
+/* description: Initializes a chained list with a */
+/*              list of xrefs, the functions that */
+/*              are already matched go to the     */
+/*              matched elements                  */
+/*------------------------------------------------*/
+
+static clist_t *diff_prop_clist(dprop_t *p, hpsig_t *h, frefs_t *refs) {
+   clist_t *cl;
+   fref_t *fl;
+   sig_t *sig;
+
+   cl = new (p->pool) clist_t(h, NULL, p->pool);
+   if (!refs) {
+      return cl;
+   }
+
+   for (fl = refs->list; fl; fl = fl->next) {
+      sig = hash_find_ea(h, fl->ea);
+      if (!sig || cl->insert(sig) != 0) {
+         continue;
+      }
+      if (sig->get_matched_type() != DIFF_UNMATCHED) {
+         cl->remove(sig->nodes);
+      }
+   }
+   cl->pos = cl->sigs;
+
+   return cl;
+}
+
+/*------------------------------------------------*/
+/* function : diff_prop_crefs                     */
+/* description: Builds the pred/succ lists of a   */
+/*              function the first time a         */
+/*              propagation reaches it            */
+/*------------------------------------------------*/
+
+static void diff_prop_crefs(dprop_t *p, sig_t *sig) {
+   hpsig_t *h;
+
+   if (sig->cp) {
+      return;
+   }
+
+   h = sig->nfile == 1 ? p->h1 : p->h2;
+
+   sig->set_crefs(SIG_PRED, diff_prop_clist(p, h, sig->get_preds()));
+   sig->set_crefs(SIG_SUCC, diff_prop_clist(p, h, sig->get_succs()));
+   p->touched.push_back(sig);
+}
+
+/*------------------------------------------------*/
+/* function : diff_prop_list                      */
+/* description: Builds the lists of the elements  */
+/*              of cl (the pred/succ matching     */
+/*              compares them)                    */
+/*------------------------------------------------*/
+
+static void diff_prop_list(dprop_t *p, clist_t *cl) {
+   dpsig_t *ds;
+
+   for (ds = cl->sigs; ds; ds = ds->next) {
+      diff_prop_crefs(p, ds->sig);
+   }
+}
+
 /*------------------------------------------------*/
 /* function : deng_t constructor                  */
 /* description: Initializes engine structures     */
@@ -125,10 +261,15 @@ deng_t::deng_t(slist_t *l1, slist_t *l2, options_t *opt) {
 
    this->opt = opt;
 
-   if (slist_init_crefs(l1) != 0) {
+   pool = new pool_t();
+   if (!pool) {
       return;
    }
-   if (slist_init_crefs(l2) != 0) {
+
+   if (slist_init_crefs(l1, pool) != 0) {
+      return;
+   }
+   if (slist_init_crefs(l2, pool) != 0) {
       return;
    }
 
@@ -146,9 +287,16 @@ void deng_t::init(options_t *opt) {
    mlist = NULL;
    ulist = NULL;
    ilist = NULL;
+   pool = NULL;
+   prop = NULL;
    identical = 0;
    matched = 0;
    unmatched = 0;
+   memset(ncand, 0, sizeof(ncand));
+   memset(nfound, 0, sizeof(nfound));
+   nskip = 0;
+   ngroups = 0;
+   ndepth = 0;
 }
 
 /*------------------------------------------------*/
@@ -168,6 +316,26 @@ deng_t::~deng_t() {
       ulist->free_sigs();
       delete ulist;
    }
+
+   diff_prop_free(prop);
+
+   // releases every clist/dpsig_t of the diff session at once
+   delete pool;
+}
+
+/*------------------------------------------------*/
+/* function : deng_t::print_stats                 */
+/* description: Prints diff_run statistics        */
+/*------------------------------------------------*/
+void deng_t::print_stats() {
+   int i;
+
+   for (i = 0; i < DIFF_MANUAL; i++) {
+      msg("Candidates (%s): %u examined, %u matched\n", diff_type_names[i], ncand[i], nfound[i]);
+   }
+   msg("Anchor groups:          %u\n", ngroups);
+   msg("Skipped neighbourhoods: %u\n", nskip);
+   msg("Work stack size:        %u\n", (uint32_t)ndepth);
 }
 
 /*------------------------------------------------*/
@@ -266,14 +434,18 @@ dpsig_t *clist_t::get_unique_sig(dpsig_t **ds, int type) {
             tmp = *ds;
 
             if (ptr->sig->str_hash != 0) {
-               // slow: need to improve
-               while (tmp) {
-                  if (tmp->sig->startEA != ptr->sig->startEA && tmp->sig->str_hash == ptr->sig->str_hash) {
-                     b = true;
-                     break;
+               if (num >= CLIST_INDEX_MIN) {
+                  b = !index_str_unique(ptr, *ds);
+               }
+               else {
+                  while (tmp) {
+                     if (tmp->sig->startEA != ptr->sig->startEA && tmp->sig->str_hash == ptr->sig->str_hash) {
+                        b = true;
+                        break;
+                     }
+
+                     tmp = tmp->next;
                   }
-
-                  tmp = tmp->next;
                }
 
                if (!b) {
@@ -304,20 +476,91 @@ dpsig_t *clist_t::get_unique_sig(dpsig_t **ds, int type) {
 dpsig_t *clist_t::get_best_sig(int type) {
    dpsig_t *best, *ptr;
 
-   best = pos;
+   while (1) {
+      best = pos;
+
+      ptr = get_unique_sig(&best, type);
+
+      // no more signature
+      if (!best) return NULL;
+
+      if (ptr == best) {
+         pos = best->next;
+         return best;
+      }
+
+      pos = ptr;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : clist_t::get_indexed_sig            */
+/* description: get_eq_sig through the lookup     */
+/*              tables. Sets *done to a non NULL  */
+/*              value if the result is valid,     */
+/*              otherwise the list must be walked */
+/* note: gives the same result as the list walk:  */
+/*       - hash types: the walk does nothing      */
+/*         before the first element with the same */
+/*         key                                    */
+/*       - name/str: only when no already matched */
+/*         element is left in the list (the walk  */
+/*         would remove them)                     */
+/*------------------------------------------------*/
+
+dpsig_t *clist_t::get_indexed_sig(dpsig_t *dsig, int type, dpsig_t **done) {
+   dpsig_t *ds, *ptr;
+
+   *done = NULL;
 
-   ptr = get_unique_sig(&best, type);
+   switch (type) {
+      case DIFF_EQUAL_SIG_HASH_CRC:
+      case DIFF_EQUAL_SIG_HASH_CRC_STR:
+      case DIFF_EQUAL_SIG_HASH:
+         *done = dsig;
+         ds = index_first(dsig->sig, type);
+         if (!ds) {
+            return NULL;
+         }
+         ptr = get_unique_sig(&ds, type);
+         if (!ds || ptr != ds || !sig_equal(ds->sig, dsig->sig, type)) {
+            return NULL;
+         }
+         return ds;
 
-   // no more signature
-   if (!best) return NULL;
+      case DIFF_EQUAL_NAME:
+         if (nstale) {
+            return NULL;
+         }
+         *done = dsig;
+         if (!strncmp(dsig->sig->name.c_str(), "sub_", 4)) {
+            return NULL;
+         }
+         ds = index_first(dsig->sig, type);
+         if (!ds) {
+            return NULL;
+         }
+         // end of the run of identical elements with the same name
+         ptr = ds;
+         while (ptr->next && sig_equal(ptr->next->sig, ds->sig, type) && sig_name_equal(ds->sig, ptr->next->sig)) {
+            ptr = ptr->next;
+         }
+         return ptr;
 
-   if (ptr == best) {
-      pos = best->next;
-      return best;
+      case DIFF_NEQUAL_STR:
+         if (nstale) {
+            return NULL;
+         }
+         *done = dsig;
+         if (dsig->sig->str_hash == 0) {
+            return NULL;
+         }
+         // only the last element with this string hash is unique
+         // from its position
+         return index_last(dsig->sig, type);
    }
 
-   pos = ptr;
-   return get_best_sig(type);
+   return NULL;
 }
 
 /*------------------------------------------------*/
@@ -330,6 +573,13 @@ dpsig_t *clist_t::get_eq_sig(dpsig_t *dsig, int type) {
    dpsig_t * ds, * ptr;
    bool b2, b1 = dsig->sig->is_class();
 
+   if (num >= CLIST_INDEX_MIN) {
+      ptr = get_indexed_sig(dsig, type, &ds);
+      if (ds) {
+         return ptr;
+      }
+   }
+
    ds = sigs;
    while (ds) {
       if (type == DIFF_NEQUAL_SUCC) {
@@ -408,34 +658,52 @@ dpsig_t *clist_t::get_eq_sig(dpsig_t *dsig, int type) {
    return NULL;
 }
 
+/*------------------------------------------------*/
+/* function : clist_t::update_crefs               */
+/* description: Removes ds from the opposite      */
+/*              direction lists of the elements   */
+/*              of the list                       */
+/* note: walks the list elements of ds->sig       */
+/*       (sig->nodes) instead of searching every  */
+/*       neighbour list                           */
+/*------------------------------------------------*/
+
 void clist_t::update_crefs(dpsig_t *ds, int type) {
    dpsig_t *tmp;
    dpsig_t *next;
-   dpsig_t *tmp2;
-   dpsig_t *next2;
-   clist_t *tcl;
-
-   tmp = sigs;
-   while (tmp) {
-      next = tmp->next;
 
+   // propagation sessions build the lists on demand: a neighbour without
+   // lists holds no element of ds
+   for (tmp = sigs; tmp; tmp = tmp->next) {
+      if (!tmp->sig->cp) {
+         continue;
+      }
       if (type == SIG_SUCC) {
-         tcl = tmp->sig->cs;
+         tmp->sig->cs->cref_mark = true;
       }
       else {
-         tcl = tmp->sig->cp;
+         tmp->sig->cp->cref_mark = true;
       }
-      tmp2 = tcl->sigs;
-      while (tmp2) {
-         next2 = tmp2->next;
+   }
 
-         if (tmp2->sig->startEA == ds->sig->startEA) {
-            tcl->remove(tmp2);
-         }
-         tmp2 = next2;
+   for (tmp = ds->sig->nodes; tmp; tmp = next) {
+      next = tmp->snext;
+
+      if (tmp->cl->cref_mark && !tmp->removed) {
+         tmp->cl->remove(tmp);
       }
+   }
 
-      tmp = next;
+   for (tmp = sigs; tmp; tmp = tmp->next) {
+      if (!tmp->sig->cp) {
+         continue;
+      }
+      if (type == SIG_SUCC) {
+         tmp->sig->cs->cref_mark = false;
+      }
+      else {
+         tmp->sig->cp->cref_mark = false;
+      }
    }
 }
 
@@ -449,70 +717,430 @@ void clist_t::update_and_remove(dpsig_t *ds) {
    remove(ds);
 }
 
+// diff_run work item: one pair of lists (neighbourhood of a match)
+struct dframe_t {
+   clist_t *cl1;
+   clist_t *cl2;
+   int type;       // current match type
+   int mtype;      // last match type
+   bool changed;   // a match was found in the current pass
+   bool start;     // a new pass must be started
+};
+
+// top level match whose neighbourhood is matched by a diff worker
+struct danchor_t {
+   sig_t *s1;
+   sig_t *s2;
+   int mtype;     // mtype of the serial frame of the match
+};
+
+#ifdef PDIFF_THREADS
+typedef std::unordered_map<sig_t *, uint32_t> dsmap_t;
+
+// diff worker state
+struct dwork_t {
+   deng_t *eng;   // private counters
+   std::vector< qvector<danchor_t> > *groups;
+   std::atomic<size_t> *next;   // next group to process
+   int min_type;
+   int max_type;
+};
+#endif
+
 /*------------------------------------------------*/
-/* function : diff_run                            */
-/* description: Runs binary analysis              */
+/* function : diff_push                           */
+/* description: Queues a pair of lists            */
 /*------------------------------------------------*/
 
-static int diff_run(deng_t *eng, clist_t *cl1, clist_t *cl2, int min_type, int max_type, bool pclass) {
+static void diff_push(qvector<dframe_t> &stack, clist_t *cl1, clist_t *cl2, int min_type, int max_type, bool pclass) {
+   dframe_t f;
+
+   f.cl1 = cl1;
+   f.cl2 = cl2;
+   f.type = min_type;
+   f.mtype = max_type;
+   f.changed = false;
+   f.start = true;
+
+   if (pclass && max_type > DIFF_EQUAL_SIG_HASH) {
+      f.mtype = DIFF_EQUAL_SIG_HASH;
+   }
+
+   stack.push_back(f);
+}
+
+/*------------------------------------------------*/
+/* function : diff_process                        */
+/* description: Matches the queued pairs of lists */
+/*              until the stack is empty          */
+/* note: the neighbourhoods of new matches are    */
+/*       processed from an explicit stack in the  */
+/*       order the former recursion used (preds   */
+/*       then succs, depth first) so the results  */
+/*       do not change                            */
+/*       if anchors is set, matches are recorded  */
+/*       there instead of being propagated        */
+/*------------------------------------------------*/
+
+static void diff_process(deng_t *eng, qvector<dframe_t> &stack, int min_type, int max_type, qvector<danchor_t> *anchors) {
+   dframe_t *f;
    dpsig_t *dsig, *dsig2;
-   int changed = 0;
-   int type = min_type;
-   int mtype = max_type;
+   danchor_t a;
+   int mtype;
    bool b;
 
-   if (pclass && max_type > DIFF_EQUAL_SIG_HASH) {
-      mtype = DIFF_EQUAL_SIG_HASH;
-   }
-   do {
-      cl1->reset();
-      cl2->reset();
-
-      changed = 0;
-      while ((dsig = cl1->get_best_sig(type)) != NULL) {
-         cl2->reset();
-         dsig2 = cl2->get_eq_sig(dsig, type);
-         if (dsig2) {
-            dsig->sig->set_matched_sig(dsig2->sig, type);
-
-            eng->unmatched -= 2;
-            if (dsig->sig->hash2 == dsig2->sig->hash2 || sig_equal(dsig->sig, dsig2->sig, DIFF_EQUAL_SIG_HASH)) {
-               eng->identical++;
-            }
-            else {
-               eng->matched++;
-            }
-            changed = 1;
+   while (!stack.empty()) {
+      f = &stack.back();
 
-            cl1->update_and_remove(dsig);
-            cl2->update_and_remove(dsig2);
+      if (f->start) {
+         f->cl1->reset();
+         f->cl2->reset();
+         f->changed = false;
+         f->start = false;
 
-            b = dsig->sig->is_class();
+         // nothing left to match on this side
+         if (!f->cl1->sigs) {
+            eng->nskip++;
+            stack.pop_back();
+            continue;
+         }
 
-            // string matching is not 100% reliable so we only match on crc/hash
-            if (mtype == DIFF_NEQUAL_STR) {
-               b = true;
-            }
-            diff_run(eng, dsig->sig->get_crefs(SIG_PRED), dsig2->sig->get_crefs(SIG_PRED), min_type, max_type, b);
-            diff_run(eng, dsig->sig->get_crefs(SIG_SUCC), dsig2->sig->get_crefs(SIG_SUCC), min_type, max_type, b);
+         if (eng->prop) {
+            diff_prop_list(eng->prop, f->cl1);
+            diff_prop_list(eng->prop, f->cl2);
+         }
+      }
 
+      dsig = f->cl1->get_best_sig(f->type);
+      if (!dsig) {
+         if (!f->changed) {
+            f->type++;
+         }
+         if (f->type > f->mtype) {
+            stack.pop_back();
          }
+         else {
+            f->start = true;
+         }
+         continue;
       }
 
-      if (changed == 0) {
-         type++;
+      eng->ncand[f->type]++;
+
+      f->cl2->reset();
+      dsig2 = f->cl2->get_eq_sig(dsig, f->type);
+      if (!dsig2) {
+         continue;
+      }
+
+      dsig->sig->set_matched_sig(dsig2->sig, f->type);
+      clist_mark_matched(dsig->sig);
+      clist_mark_matched(dsig2->sig);
+
+      eng->nfound[f->type]++;
+      eng->unmatched -= 2;
+      if (dsig->sig->hash2 == dsig2->sig->hash2 || sig_equal(dsig->sig, dsig2->sig, DIFF_EQUAL_SIG_HASH)) {
+         eng->identical++;
+      }
+      else {
+         eng->matched++;
+      }
+      f->changed = true;
+
+      if (eng->prop) {
+         diff_prop_crefs(eng->prop, dsig->sig);
+         diff_prop_crefs(eng->prop, dsig2->sig);
+         eng->prop->found->push_back(dsig->sig);
+         eng->prop->found->push_back(dsig2->sig);
+      }
+
+      f->cl1->update_and_remove(dsig);
+      f->cl2->update_and_remove(dsig2);
+
+      if (anchors) {
+         a.s1 = dsig->sig;
+         a.s2 = dsig2->sig;
+         // the anchor frame stops early, a serial run would have made
+         // this match in a top level frame going up to max_type
+         a.mtype = max_type;
+         anchors->push_back(a);
+         continue;
+      }
+
+      b = dsig->sig->is_class();
+      mtype = f->mtype;
+
+      // string matching is not 100% reliable so we only match on crc/hash
+      if (mtype == DIFF_NEQUAL_STR) {
+         b = true;
       }
-   } while(type <= mtype);
+
+      // f is invalid after the first push
+      diff_push(stack, dsig->sig->get_crefs(SIG_SUCC), dsig2->sig->get_crefs(SIG_SUCC), min_type, max_type, b);
+      diff_push(stack, dsig->sig->get_crefs(SIG_PRED), dsig2->sig->get_crefs(SIG_PRED), min_type, max_type, b);
+
+      if (stack.size() > eng->ndepth) {
+         eng->ndepth = stack.size();
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : diff_run                            */
+/* description: Runs binary analysis              */
+/*------------------------------------------------*/
+
+static int diff_run(deng_t *eng, clist_t *cl1, clist_t *cl2, int min_type, int max_type, bool pclass) {
+   qvector<dframe_t> stack;
+
+   diff_push(stack, cl1, cl2, min_type, max_type, pclass);
+   diff_process(eng, stack, min_type, max_type, NULL);
 
    return 0;
 }
 
+#ifdef PDIFF_THREADS
+
 /*------------------------------------------------*/
-/* function : generate_diff                       */
+/* function : uf_find                             */
+/* description: Union-find root lookup (with path */
+/*              halving)                          */
+/*------------------------------------------------*/
+
+static uint32_t uf_find(std::vector<uint32_t> &uf, uint32_t i) {
+   while (uf[i] != i) {
+      uf[i] = uf[uf[i]];
+      i = uf[i];
+   }
+
+   return i;
+}
+
+/*------------------------------------------------*/
+/* function : uf_union                            */
+/* description: Merges two union-find sets        */
+/*------------------------------------------------*/
+
+static void uf_union(std::vector<uint32_t> &uf, uint32_t i, uint32_t j) {
+   i = uf_find(uf, i);
+   j = uf_find(uf, j);
+
+   if (i != j) {
+      uf[qmax(i, j)] = qmin(i, j);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : uf_union_list                       */
+/* description: Merges a signature with every     */
+/*              element (past or present) of one  */
+/*              of its cross reference lists      */
+/*------------------------------------------------*/
+
+static void uf_union_list(std::vector<uint32_t> &uf, dsmap_t &ids, uint32_t i, clist_t *cl) {
+   dpsig_t *chains[3];
+   dpsig_t *ds;
+   dsmap_t::iterator it;
+   int k;
+
+   chains[0] = cl->sigs;
+   chains[1] = cl->msigs;
+   chains[2] = cl->mpend;
+
+   for (k = 0; k < 3; k++) {
+      for (ds = chains[k]; ds; ds = ds->next) {
+         it = ids.find(ds->sig);
+         if (it != ids.end()) {
+            uf_union(uf, i, it->second);
+         }
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : diff_group_anchors                  */
+/* description: Splits the anchors into groups    */
+/*              that share no signature: the call */
+/*              graph components of both lists    */
+/*              joined by the anchor pairs        */
+/*------------------------------------------------*/
+
+static void diff_group_anchors(slist_t *l1, slist_t *l2, qvector<danchor_t> &anchors, std::vector< qvector<danchor_t> > &groups) {
+   std::vector<uint32_t> uf;
+   std::unordered_map<uint32_t, size_t> gids;
+   std::unordered_map<uint32_t, size_t>::iterator it;
+   dsmap_t ids;
+   uint32_t n, i, root;
+   sig_t *sig;
+
+   n = (uint32_t)(l1->num + l2->num);
+   uf.resize(n);
+   ids.reserve(n);
+
+   for (i = 0; i < n; i++) {
+      uf[i] = i;
+      ids[i < l1->num ? l1->sigs[i] : l2->sigs[i - l1->num]] = i;
+   }
+
+   for (i = 0; i < n; i++) {
+      sig = i < l1->num ? l1->sigs[i] : l2->sigs[i - l1->num];
+      if (sig->cp) {
+         uf_union_list(uf, ids, i, sig->cp);
+      }
+      if (sig->cs) {
+         uf_union_list(uf, ids, i, sig->cs);
+      }
+   }
+
+   for (i = 0; i < anchors.size(); i++) {
+      uf_union(uf, ids[anchors[i].s1], ids[anchors[i].s2]);
+   }
+
+   // groups keep the anchors in match order
+   for (i = 0; i < anchors.size(); i++) {
+      root = uf_find(uf, ids[anchors[i].s1]);
+      it = gids.find(root);
+      if (it == gids.end()) {
+         it = gids.insert(std::make_pair(root, groups.size())).first;
+         groups.resize(groups.size() + 1);
+      }
+      groups[it->second].push_back(anchors[i]);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : diff_work                           */
+/* description: Propagates the matches of the     */
+/*              anchor groups (worker thread)     */
+/*------------------------------------------------*/
+
+static void diff_work(dwork_t *w) {
+   qvector<dframe_t> stack;
+   qvector<danchor_t> *group;
+   size_t g, i;
+   bool b;
+
+   while ((g = w->next->fetch_add(1)) < w->groups->size()) {
+      group = &(*w->groups)[g];
+
+      for (i = 0; i < group->size(); i++) {
+         danchor_t &a = (*group)[i];
+
+         // same rule as diff_process: string matching is not 100% reliable
+         b = a.s1->is_class() || a.mtype == DIFF_NEQUAL_STR;
+         diff_push(stack, a.s1->get_crefs(SIG_SUCC), a.s2->get_crefs(SIG_SUCC), w->min_type, w->max_type, b);
+         diff_push(stack, a.s1->get_crefs(SIG_PRED), a.s2->get_crefs(SIG_PRED), w->min_type, w->max_type, b);
+         diff_process(w->eng, stack, w->min_type, w->max_type, NULL);
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : dgroup_larger                       */
+/* description: Orders anchor groups by size      */
+/*------------------------------------------------*/
+
+static bool dgroup_larger(const qvector<danchor_t> &g1, const qvector<danchor_t> &g2) {
+   return g1.size() > g2.size();
+}
+
+/*------------------------------------------------*/
+/* function : diff_run_parallel                   */
+/* description: Runs binary analysis with several */
+/*              workers                           */
+/* note: the exact matches of the top level lists */
+/*       are found first (anchors), their         */
+/*       neighbourhoods are then matched          */
+/*       concurrently, one worker per group of    */
+/*       connected anchors, and a last serial run */
+/*       matches what is left. Groups share no    */
+/*       signature so the results do not depend on*/
+/*       the scheduling, but they can differ from */
+/*       the serial order.                        */
+/*------------------------------------------------*/
+
+static int diff_run_parallel(deng_t *eng, slist_t *l1, slist_t *l2, clist_t *cl1, clist_t *cl2, int min_type, int max_type, int nthreads) {
+   qvector<dframe_t> stack;
+   qvector<danchor_t> anchors;
+   std::vector< qvector<danchor_t> > groups;
+   std::vector<deng_t *> engs;
+   std::atomic<size_t> next(0);
+   std::vector<dwork_t> works;
+   int i, k;
+
+   diff_push(stack, cl1, cl2, min_type, qmin(max_type, DIFF_EQUAL_SIG_HASH_CRC), false);
+   diff_process(eng, stack, min_type, max_type, &anchors);
+
+   diff_group_anchors(l1, l2, anchors, groups);
+
+   // larger groups first
+   std::stable_sort(groups.begin(), groups.end(), dgroup_larger);
+   eng->ngroups = (uint32_t)groups.size();
+
+   nthreads = qmin(nthreads, (int)groups.size());
+   if (nthreads < 1) {
+      nthreads = 1;
+   }
+
+   cl1->shared = true;
+   cl2->shared = true;
+
+   works.resize(nthreads);
+   for (i = 0; i < nthreads; i++) {
+      works[i].eng = new deng_t((options_t *)NULL);
+      works[i].groups = &groups;
+      works[i].next = &next;
+      works[i].min_type = min_type;
+      works[i].max_type = max_type;
+   }
+
+   {
+      std::vector<std::thread> threads;
+
+      for (i = 1; i < nthreads; i++) {
+         threads.push_back(std::thread(diff_work, &works[i]));
+      }
+      diff_work(&works[0]);
+
+      for (i = 0; i < (int)threads.size(); i++) {
+         threads[i].join();
+      }
+   }
+
+   for (i = 0; i < nthreads; i++) {
+      deng_t *w = works[i].eng;
+
+      eng->matched += w->matched;
+      eng->identical += w->identical;
+      eng->unmatched += w->unmatched;
+      eng->nskip += w->nskip;
+      eng->ndepth = qmax(eng->ndepth, w->ndepth);
+      for (k = 0; k < DIFF_MANUAL; k++) {
+         eng->ncand[k] += w->ncand[k];
+         eng->nfound[k] += w->nfound[k];
+      }
+      delete w;
+   }
+
+   cl1->shared = false;
+   cl2->shared = false;
+   clist_count_stale(cl1);
+   clist_count_stale(cl2);
+
+   return diff_run(eng, cl1, cl2, min_type, max_type, false);
+}
+
+#endif
+
+/*------------------------------------------------*/
+/* function : generate_diff_mt                    */
 /* description: Generates binary diff             */
+/* note: nthreads > 1 runs the parallel matching  */
+/*       (file diff only), 1 keeps the serial and */
+/*       reproducible order                       */
 /*------------------------------------------------*/
 
-int generate_diff(deng_t **d, slist_t *l1, slist_t *l2, const char *file, options_t *opt) {
+int generate_diff_mt(deng_t **d, slist_t *l1, slist_t *l2, const char *file, options_t *opt, int nthreads) {
    int ret;
    clist_t *cl1, *cl2;
 
@@ -521,74 +1149,211 @@ int generate_diff(deng_t **d, slist_t *l1, slist_t *l2, const char *file, option
       delete eng;
       return -1;
    }
-   cl1 = new clist_t(l1);
-   cl2 = new clist_t(l2);
+   cl1 = new (eng->pool) clist_t(l1, eng->pool);
+   cl2 = new (eng->pool) clist_t(l2, eng->pool);
 
+#ifdef PDIFF_THREADS
+   if (file && nthreads > 1) {
+      ret = diff_run_parallel(eng, l1, l2, cl1, cl2, DIFF_EQUAL_NAME, DIFF_NEQUAL_STR, nthreads);
+   }
+   else
+#endif
    if (file) {
       ret = diff_run(eng, cl1, cl2, DIFF_EQUAL_NAME, DIFF_NEQUAL_STR, false);
    }
    else {
       ret = diff_run(eng, cl1, cl2, DIFF_EQUAL_SIG_HASH_CRC, DIFF_EQUAL_SIG_HASH, false);
-      ret = diff_run(eng, cl1, cl2, DIFF_NEQUAL_PRED, DIFF_NEQUAL_STR, false);
+      if (!ret) {
+         ret = diff_run(eng, cl1, cl2, DIFF_NEQUAL_PRED, DIFF_NEQUAL_STR, false);
+      }
    }
 
-   if (d) {
+   if (d && !ret) {
       *d = eng;
    }
    else {
+      slist_reset_crefs(l1);
+      slist_reset_crefs(l2);
       delete eng;  // what else could be using eng at this point? nothing?
    }
-   return 0;
+   return ret;
 }
 
-void deng_t::display(pd_plugmod_t *plugin, slist_t *l1, slist_t *l2, const char *file) {
-   int un1, un2, idf, mf;
+/*------------------------------------------------*/
+/* function : generate_diff                       */
+/* description: Generates binary diff             */
+/*------------------------------------------------*/
 
-   mlist = new slist_t(matched, file);
-   ulist = new slist_t(unmatched, file);
-   ilist = new slist_t(identical, file);
+int generate_diff(deng_t **d, slist_t *l1, slist_t *l2, const char *file, options_t *opt) {
+   return generate_diff_mt(d, l1, l2, file, opt, opt ? opt->diff_threads : 1);
+}
 
-   un1 = un2 = idf = mf = 0;
+/*------------------------------------------------*/
+/* function : diff_prop_detach                    */
+/* description: Detaches the pred/succ lists of a */
+/*              function and adds it to l         */
+/*------------------------------------------------*/
 
-   for (size_t i = 0; i < l1->num; i++) {
-      if (l1->sigs[i]->is_class()) {
-         delete l1->sigs[i];
-         continue;
-      }
+static void diff_prop_detach(sig_t *sig, slist_t *l) {
+   sig->set_crefs(SIG_PRED, NULL);
+   sig->set_crefs(SIG_SUCC, NULL);
+   sig->nodes = NULL;
 
-      if (l1->sigs[i]->get_matched_type() == DIFF_UNMATCHED) {
-         l1->sigs[i]->set_nfile(1);
-         ulist->add(l1->sigs[i]);
-         un1++;
-      }
-      else {
-         if (l1->sigs[i]->hash2 == l1->sigs[i]->msig->hash2 || sig_equal(l1->sigs[i], l1->sigs[i]->msig, DIFF_EQUAL_SIG_HASH)) {
-            ilist->add(l1->sigs[i]);
-            idf++;
+   // not add(): node is the index of sig in its result list
+   if (l) {
+      l->sigs[l->num++] = sig;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : diff_prop_lists                     */
+/* description: Splits the result lists of eng by */
+/*              file and detaches their pred/succ */
+/*              lists                             */
+/*------------------------------------------------*/
+
+static void diff_prop_lists(deng_t *eng, slist_t *l1, slist_t *l2) {
+   slist_t *rl[3] = {eng->ulist, eng->mlist, eng->ilist};
+   sig_t *sig;
+   size_t i, j;
+
+   for (j = 0; j < 3; j++) {
+      for (i = 0; rl[j] && i < rl[j]->num; i++) {
+         sig = rl[j]->sigs[i];
+         if (!sig) {
+            continue;
          }
-         else {
-            mlist->add(l1->sigs[i]);
-            mf++;
+
+         // the matched/identical lists only hold the file 1 sigs
+         if (j > 0) {
+            sig->set_nfile(1);
+            sig->msig->set_nfile(2);
+            diff_prop_detach(sig->msig, l2);
          }
+         diff_prop_detach(sig, sig->nfile == 1 ? l1 : l2);
       }
    }
+}
 
-   for (size_t i = 0; i < l2->num; i++) {
-      if (l2->sigs[i]->is_class()) {
-         delete l2->sigs[i];
-         continue;
-      }
+/*------------------------------------------------*/
+/* function : diff_prop_init                      */
+/* description: Starts a propagation session on  */
+/*              the result lists of eng           */
+/*------------------------------------------------*/
+
+static dprop_t *diff_prop_init(deng_t *eng) {
+   dprop_t *p;
+   slist_t *l1, *l2;
+   uint32_t num;
 
-      if (l2->sigs[i]->get_matched_type() == DIFF_UNMATCHED) {
-         l2->sigs[i]->set_nfile(2);
-         ulist->add(l2->sigs[i]);
-         un2++;
+   p = new dprop_t();
+   p->pool = new pool_t();
+   p->found = NULL;
+   p->h1 = p->h2 = NULL;
+
+   // the sessions walk whole lists
+   eng->ulist->load_all();
+   if (eng->mlist) {
+      eng->mlist->load_all();
+   }
+   if (eng->ilist) {
+      eng->ilist->load_all();
+   }
+
+   num = eng->ulist->num;
+   if (eng->mlist) {
+      num += eng->mlist->num;
+   }
+   if (eng->ilist) {
+      num += eng->ilist->num;
+   }
+
+   l1 = new slist_t(num, eng->ulist->file);
+   l2 = new slist_t(num, eng->ulist->file);
+
+   // the lists of the diff session (or of a previous propagation session)
+   // are stale
+   diff_prop_lists(eng, l1, l2);
+
+   p->h1 = diff_init_hash(l1);
+   p->h2 = diff_init_hash(l2);
+
+   delete l1;
+   delete l2;
+
+   if (!p->h1 || !p->h2) {
+      diff_prop_free(p);
+      return NULL;
+   }
+
+   return p;
+}
+
+/*------------------------------------------------*/
+/* function : diff_propagate                      */
+/* description: Matches the neighbourhood of a    */
+/*              manual match (s1, s2)             */
+/* note: only the lists reached from the new      */
+/*       anchor are built, new matches are        */
+/*       appended to found (both sigs)            */
+/*------------------------------------------------*/
+
+int diff_propagate(deng_t *eng, sig_t *s1, sig_t *s2, qvector<sig_t *> *found) {
+   qvector<dframe_t> stack;
+   dprop_t *p;
+   dpsig_t *ds;
+   bool b;
+
+   if (!eng->ulist) {
+      return -1;
+   }
+
+   if (!eng->prop) {
+      eng->prop = diff_prop_init(eng);
+      if (!eng->prop) {
+         return -1;
       }
    }
+   p = eng->prop;
+
+   diff_prop_crefs(p, s1);
+   diff_prop_crefs(p, s2);
+
+   // the anchor leaves the lists of the previous propagations
+   clist_mark_matched(s1);
+   clist_mark_matched(s2);
+   for (ds = s1->nodes; ds; ds = ds->snext) {
+      ds->cl->remove(ds);
+   }
+   for (ds = s2->nodes; ds; ds = ds->snext) {
+      ds->cl->remove(ds);
+   }
+
+   p->found = found;
+
+   b = s1->is_class();
+   diff_push(stack, s1->get_crefs(SIG_SUCC), s2->get_crefs(SIG_SUCC), DIFF_EQUAL_NAME, DIFF_NEQUAL_STR, b);
+   diff_push(stack, s1->get_crefs(SIG_PRED), s2->get_crefs(SIG_PRED), DIFF_EQUAL_NAME, DIFF_NEQUAL_STR, b);
+   diff_process(eng, stack, DIFF_EQUAL_NAME, DIFF_NEQUAL_STR, NULL);
+
+   p->found = NULL;
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : diff_propagate_reset                */
+/* description: Ends the propagation session of   */
+/*              eng (the unmatched list changed)  */
+/*------------------------------------------------*/
+
+void diff_propagate_reset(deng_t *eng) {
+   if (!eng->prop) {
+      return;
+   }
+
+   diff_prop_lists(eng, NULL, NULL);
 
-   msg("Identical functions:   %d\n", idf);
-   msg("Matched functions:     %d\n", mf);
-   msg("Unmatched functions 1: %d\n", un1);
-   msg("Unmatched functions 2: %d\n", un2);
-   display_results(plugin);
+   diff_prop_free(eng->prop);
+   eng->prop = NULL;
 }
@@ -33,6 +33,8 @@
 #define DIFF_MANUAL                  7
 
 struct pd_plugmod_t;
+struct pool_t;
+struct dprop_t;
 
 struct deng_t {
    int magic;
@@ -44,6 +46,15 @@ struct deng_t {
    slist_t *ilist;
    options_t *opt;
    int wnum;
+   pool_t *pool;   // diff session allocations (clist_t/dpsig_t)
+   dprop_t *prop;  // manual match propagation session (or NULL)
+
+   // diff_run statistics
+   uint32_t ncand[DIFF_MANUAL];   // candidates examined per match type
+   uint32_t nfound[DIFF_MANUAL];  // matches found per match type
+   uint32_t nskip;                // neighbourhoods skipped (nothing to match)
+   uint32_t ngroups;              // anchor groups (parallel matching)
+   size_t ndepth;                 // largest work stack size
 
    deng_t(slist_t *l1, slist_t *l2, options_t *opt);
    deng_t(options_t *opt);
@@ -54,9 +65,14 @@ struct deng_t {
    bool is_valid() {return magic == 0x0BADF00D;};
 
    void display(pd_plugmod_t *plugin, slist_t *l1, slist_t *l2, const char *file);
+   void print_stats();
 };
 
 int generate_diff(deng_t **, slist_t *, slist_t *, const char *, options_t *);
+int generate_diff_mt(deng_t **, slist_t *, slist_t *, const char *, options_t *, int);
+
+int diff_propagate(deng_t *, sig_t *, sig_t *, qvector<sig_t *> *);
+void diff_propagate_reset(deng_t *);
 
 bool sig_equal(sig_t *, sig_t *, int);
 
@@ -29,9 +29,14 @@
 #include "system.h"
 #include "actions.h"
 #include "plugin.h"
+#include "gcache.h"
+#include "ncache.h"
+#include "bdiff.h"
 
 static uint32 idaapi sizer_dlist(slist_t *sl) {
    if (sl) {
+      // the rows removed since the last refresh go away here
+      sl->pack();
       return sl->num;
    }
    return 0;
@@ -69,7 +74,8 @@ static void idaapi close_window(void *obj) {
 /* function : ui_access_sig                       */
 /* description: Compensates for the zero index    */
 /*         indicating the header row and performs */
-/*         bounds checking in debug               */
+/*         bounds checking in debug (NULL if the  */
+/*         row could not be loaded)               */
 /*------------------------------------------------*/
 
 static sig_t *ui_access_sig(slist_t *sl, uint32 n) {
@@ -79,9 +85,14 @@ static sig_t *ui_access_sig(slist_t *sl, uint32 n) {
       return NULL;
    }
 #endif
-   return sl->sigs[n - 1];
+   // backed up lists are loaded one row at a time
+   return sl->get(n - 1);
 }
 
+// name of the rows which could not be loaded from the backup (they are
+// dropped when the list is refreshed)
+#define UI_UNREADABLE "<unreadable entry>"
+
 #if IDA_SDK_VERSION <= 695
 static void idaapi desc_dlist(slist_t *sl, uint32 n, char *const *arrptr) {
    int i;
@@ -94,6 +105,12 @@ static void idaapi desc_dlist(slist_t *sl, uint32 n, char *const *arrptr) {
    }
    else {
       sig_t *sig = ui_access_sig(sl, n);
+      if (!sig) {
+         for (i = 0; i < qnumber (header_match); i++) {
+            qsnprintf(arrptr[i], MAXSTR, "%s", i == 1 ? UI_UNREADABLE : "");
+         }
+         return;
+      }
       qsnprintf(arrptr[0], MAXSTR, "%u", sig->mtype);
       qsnprintf(arrptr[1], MAXSTR, "%s", sig->name.c_str());
       qsnprintf(arrptr[2], MAXSTR, "%s", sig->msig->name.c_str());
@@ -143,6 +160,12 @@ static void idaapi desc_unmatch(void *obj, uint32 n, char *const *arrptr) {
    }
    else {
       sig_t *sig = ui_access_sig(((deng_t *)obj)->ulist, n);
+      if (!sig) {
+         for (i = 0; i < qnumber (header_unmatch); i++) {
+            qsnprintf(arrptr[i], MAXSTR, "%s", i == 1 ? UI_UNREADABLE : "");
+         }
+         return;
+      }
       qsnprintf(arrptr[0], MAXSTR, "%u", sig->nfile);
       qsnprintf(arrptr[1], MAXSTR, "%s", sig->name.c_str());
       qsnprintf(arrptr[2], MAXSTR, "%a", sig->startEA);
@@ -154,7 +177,13 @@ static void idaapi desc_unmatch(void *obj, uint32 n, char *const *arrptr) {
 #endif
 
 static void idaapi enter_list(slist_t *sl, uint32 n) {
-   jumpto(ui_access_sig(sl, n)->startEA);
+   sig_t *sig = ui_access_sig(sl, n);
+
+   if (!sig) {
+      return;
+   }
+
+   jumpto(sig->startEA);
    os_copy_to_clipboard(NULL);
 }
 
@@ -187,6 +216,10 @@ static void idaapi enter_identical(void *obj, uint32 n) {
 static void idaapi enter_unmatch(void *obj, uint32 n) {
    sig_t *sig = ui_access_sig(((deng_t *)obj)->ulist, n);
 
+   if (!sig) {
+      return;
+   }
+
    if (sig->nfile == 1) {
       jumpto(sig->startEA);
    }
@@ -195,12 +228,80 @@ static void idaapi enter_unmatch(void *obj, uint32 n) {
    }
 }
 
+/*------------------------------------------------*/
+/* function : prefetch_row                        */
+/* description: Prefetches the second function of */
+/*              element n (see system_prefetch_fct*/
+/*              for the return value)             */
+/*------------------------------------------------*/
+
+static int prefetch_row(slist_t *sl, uint32 n, options_t *opt) {
+   sig_t *sig;
+
+   if (!sl || !sl->file || !opt || n < 1 || n > sl->num) {
+      return 0;
+   }
+
+   sig = ui_access_sig(sl, n);
+   if (!sig || !sig->msig) {
+      return 0;
+   }
+
+   return system_prefetch_fct(sig->msig->startEA, sl->file, opt);
+}
+
+/*------------------------------------------------*/
+/* function : prefetch_list                       */
+/* description: Prefetches the second functions of*/
+/*              the rows next to element n        */
+/*------------------------------------------------*/
+
+static void prefetch_list(slist_t *sl, uint32 n, options_t *opt) {
+   // the worker parses one function at a time
+   if (prefetch_row(sl, n + 1, opt) != 0) {
+      return;
+   }
+   prefetch_row(sl, n - 1, opt);
+}
+
+/*------------------------------------------------*/
+/* function : graph_cache_msg                     */
+/* description: Prints the graph cache counters   */
+/*------------------------------------------------*/
+
+static void graph_cache_msg() {
+   gcstats_t st;
+
+   gcache_get_stats(&st);
+   msg("graph cache: %u hits, %u misses, %u entries (%u KB)\n",
+       (uint32)st.hits, (uint32)st.misses, st.num, (uint32)(st.size / 1024));
+}
+
 static uint32 idaapi graph_list(slist_t *sl, uint32 n, options_t *opt) {
    slist_t *sl1 = NULL;
    slist_t *sl2 = NULL;
+   sig_t *sig;
+   ea_t ea1, ea2;
+   size_t budget;
+
+   sig = ui_access_sig(sl, n);
+   if (!sig) {
+      return 0;
+   }
+
+   ea1 = sig->startEA;
+   ea2 = sig->msig->startEA;
+   budget = opt ? opt->options_graph_cache() : 0;
+
+   if (budget && gcache_get(sl->file, ea1, ea2, &sl1, &sl2)) {
+      pgraph_display(sl1, sl2);
+      prefetch_list(sl, n, opt);
+      graph_cache_msg();
+      return 1;
+   }
 
    msg ("parsing second function...\n");
-   sl2 = parse_second_fct(ui_access_sig(sl, n)->msig->startEA, sl->file, opt);
+   sl2 = parse_second_fct(ea2, sl->file, opt);
    if (!sl2) {
       msg("Error: FCT2 parsing failed.\n");
       return 0;
@@ -208,10 +309,10 @@ static uint32 idaapi graph_list(slist_t *sl, uint32 n, options_t *opt) {
 
    msg ("parsing first function...\n");
 #if IDA_SDK_VERSION < 700
-   sl1 = parse_fct(ui_access_sig(sl, n)->startEA, dto.graph.s_showpref);
+   sl1 = parse_fct(ea1, dto.graph.s_showpref);
 #else
    // dto went away in 7.0, not clear how to replicate above
-   sl1 = parse_fct(ui_access_sig(sl, n)->startEA, 0);
+   sl1 = parse_fct(ea1, 0);
 #endif
    if (!sl1) {
       msg("Error: FCT1 parsing failed.\n");
@@ -228,6 +329,13 @@ static uint32 idaapi graph_list(slist_t *sl, uint32 n, options_t *opt) {
 
    pgraph_display(sl1, sl2);
 
+   if (budget) {
+      gcache_add(sl->file, ea1, ea2, sl1, sl2, budget);
+      graph_cache_msg();
+   }
+
+   prefetch_list(sl, n, opt);
+
    msg ("done!\n");
    return 1;
 }
@@ -270,11 +378,35 @@ static void idaapi graph_identical(void *obj, uint32 n) {
 
 static void idaapi graph_unmatch(void *obj, uint32 n) {
    slist_t *sl = NULL;
+   slist_t *sl2 = NULL;
    slist_t *tmp = ((deng_t *)obj)->ulist;
+   options_t *opt = ((deng_t *)obj)->opt;
+   ea_t ea1 = BADADDR, ea2 = BADADDR;
+   sig_t *sig;
+   size_t budget;
+
+   sig = ui_access_sig(tmp, n);
+   if (!sig) {
+      return;
+   }
+
+   if (sig->nfile == 2) {
+      ea2 = sig->startEA;
+   }
+   else {
+      ea1 = sig->startEA;
+   }
+   budget = opt ? opt->options_graph_cache() : 0;
+
+   if (budget && gcache_get(tmp->file, ea1, ea2, &sl, &sl2)) {
+      pgraph_display_one(sl ? sl : sl2);
+      graph_cache_msg();
+      return;
+   }
 
-   if (ui_access_sig(tmp, n)->nfile == 2) {
+   if (ea2 != BADADDR) {
       msg ("parsing second function...\n");
-      sl = parse_second_fct(ui_access_sig(tmp, n)->startEA, tmp->file, ((deng_t *)obj)->opt);
+      sl = parse_second_fct(ea2, tmp->file, opt);
       if (!sl) {
          msg("Error: FCT2 parsing failed.\n");
          return;
@@ -285,10 +417,10 @@ static void idaapi graph_unmatch(void *obj, uint32 n) {
    else {
       msg ("parsing first function...\n");
 #if IDA_SDK_VERSION < 700
-      sl = parse_fct(ui_access_sig(tmp, n)->startEA, dto.graph.s_showpref);
+      sl = parse_fct(ea1, dto.graph.s_showpref);
 #else
       // dto went away in 7.0, not clear how to replicate above
-      sl = parse_fct(ui_access_sig(tmp, n)->startEA, 0);
+      sl = parse_fct(ea1, 0);
 #endif
       if (!sl) {
          msg("Error: FCT1 parsing failed.\n");
@@ -300,12 +432,33 @@ static void idaapi graph_unmatch(void *obj, uint32 n) {
 
    pgraph_display_one(sl);
 
+   if (budget) {
+      if (ea2 != BADADDR) {
+         gcache_add(tmp->file, ea1, ea2, NULL, sl, budget);
+      }
+      else {
+         gcache_add(tmp->file, ea1, ea2, sl, NULL, budget);
+      }
+      graph_cache_msg();
+   }
+
    msg ("done!\n");
    return;
 }
 
-static uint32 idaapi res_unmatch(deng_t *d, uint32 n, int type) {
+/*------------------------------------------------*/
+/* function : res_unmatch_rows                    */
+/* description: Unmatches the rows of the matched */
+/*              or identical list                 */
+/* note: rows are the chooser indexes before the  */
+/*       change (removed entries keep their slot  */
+/*       until the next refresh)                  */
+/*------------------------------------------------*/
+
+static uint32 res_unmatch_rows(deng_t *d, const uint32 *rows, uint32 num, int type) {
    slist_t *sl;
+   sig_t *sig;
+   uint32 i;
 
    if (type == 0) {
       sl = d->ilist;
@@ -314,23 +467,33 @@ static uint32 idaapi res_unmatch(deng_t *d, uint32 n, int type) {
       sl = d->mlist;
    }
 
-   sig_t *sig = ui_access_sig(sl, n);
-   
-   sig->nfile = 1;
-   sig->msig->nfile = 2;
+   for (i = 0; i < num; i++) {
+      sig = ui_access_sig(sl, rows[i]);
+      if (!sig) {
+         continue;
+      }
 
-   d->ulist->add(sig);
-   d->ulist->add(sig->msig);
+      sig->nfile = 1;
+      sig->msig->nfile = 2;
 
-   sig->msig->msig = NULL;
-   sig->msig = NULL;
+      d->ulist->add(sig);
+      d->ulist->add(sig->msig);
 
-   sl->remove(n - 1);
+      sig->msig->mtype = DIFF_UNMATCHED;
+      sig->mtype = DIFF_UNMATCHED;
+      sig->msig->msig = NULL;
+      sig->msig = NULL;
+
+      sl->remove(rows[i] - 1);
+   }
+
+   // the propagation lists do not know the pairs
+   diff_propagate_reset(d);
 
    // added entries to the unmatched list
    refresh_chooser(title_unmatch);
 
-   // removed an entry from one of the following lists
+   // removed entries from one of the following lists
    if (type == 0) {
       refresh_chooser(title_identical);
    }
@@ -341,6 +504,10 @@ static uint32 idaapi res_unmatch(deng_t *d, uint32 n, int type) {
    return 1;
 }
 
+static uint32 idaapi res_unmatch(deng_t *d, uint32 n, int type) {
+   return res_unmatch_rows(d, &n, 1, type);
+}
+
 /*------------------------------------------------*/
 /* function : res_iunmatch                        */
 /* description: Unmatches element n from identical*/
@@ -365,54 +532,41 @@ static uint32 idaapi res_munmatch(void *obj, uint32 n) {
 /* function : propagate_match                     */
 /* description: Propagates new matched result if  */
 /*              option is set in dialog box       */
+/* note: only the neighbourhood of the new match  */
+/*       is diffed (see diff_propagate)           */
 /*------------------------------------------------*/
 
 void propagate_match(deng_t *eng, sig_t *s1, sig_t *s2, int options) {
-   size_t i;
+   qvector<sig_t *> found;
+   size_t i, j;
+
+   found.push_back(s1);
+   found.push_back(s2);
 
    if (options) {
       show_wait_box ("PatchDiff is in progress ...");
-
-      slist_t *l1 = new slist_t(eng->ulist->num, eng->ulist->file);
-      slist_t *l2 = new slist_t(eng->ulist->num, eng->ulist->file);
-
-      for (i = 0; i < eng->ulist->num; i++) {
-         if (!eng->ulist->sigs[i]->msig) {
-            if (eng->ulist->sigs[i]->nfile == 1) {
-               l1->add(eng->ulist->sigs[i]);
-            }
-            else {
-               l2->add(eng->ulist->sigs[i]);
-            }
-         }
-      }
-      generate_diff(NULL, l1, l2, eng->ulist->file, NULL);
-
-      delete l1;
-      delete l2;
-
+      diff_propagate(eng, s1, s2, &found);
       hide_wait_box();
    }
 
-   i = 0;
-   while (i < eng->ulist->num) {
-      s1 = eng->ulist->sigs[i];
+   // files the new matches and drops them from the unmatched list
+   for (i = 0; i < found.size(); i++) {
+      s1 = found[i];
       s2 = s1->msig;
 
-      if (!s2) {
-         i++;
+      // node is the index of the sig in the unmatched list
+      j = s1->node;
+      if (j < eng->ulist->num && eng->ulist->sigs[j] == s1) {
+         eng->ulist->remove(j);
       }
-      else {
-         if (s1->nfile == 1) {
-            if (sig_equal(s1, s2, DIFF_EQUAL_SIG_HASH)) {
-               eng->ilist->add(s1);
-            }
-            else {
-               eng->mlist->add(s1);
-            }
-         }
 
-         eng->ulist->remove(i);
+      if (s1->nfile == 1) {
+         if (sig_equal(s1, s2, DIFF_EQUAL_SIG_HASH)) {
+            eng->ilist->add(s1);
+         }
+         else {
+            eng->mlist->add(s1);
+         }
       }
    }
 }
@@ -444,11 +598,14 @@ static uint32 idaapi res_match(void *obj, uint32 n) {
    option = 1;
    if (AskUsingForm_c(format, &ea, &option)) {
       s1 = ui_access_sig(eng->ulist, n);
+      if (!s1) {
+         return 0;
+      }
 
       for (i = 0; i < eng->ulist->num; i++) {
-         s2 = eng->ulist->sigs[i];
+         s2 = eng->ulist->get(i);
 
-         if (s2->startEA != ea || (s2->nfile == s1->nfile)) {
+         if (!s2 || s2->startEA != ea || (s2->nfile == s1->nfile)) {
             continue;
          }
          s1->set_matched_sig(s2, DIFF_MANUAL);
@@ -470,28 +627,45 @@ static uint32 idaapi res_match(void *obj, uint32 n) {
 }
 
 /*------------------------------------------------*/
-/* function : res_mtoi                            */
-/* description: Switches element n from matched   */
-/*              to identical list                 */
+/* function : res_move_rows                       */
+/* description: Switches rows between the matched */
+/*              and identical lists               */
 /*------------------------------------------------*/
 
-static uint32 idaapi res_mtoi(void *obj, uint32 n) {
-   deng_t *d = (deng_t *)obj;
-   sig_t *sig = ui_access_sig(d->mlist, n);
+static uint32 res_move_rows(slist_t *src, slist_t *dst, const uint32 *rows, uint32 num) {
+   qvector<uint32_t> idx;
+   sig_t *sig;
+   uint32 i;
 
-   sig->mtype = sig->msig->mtype = DIFF_MANUAL;
+   for (i = 0; i < num; i++) {
+      sig = ui_access_sig(src, rows[i]);
+      if (!sig) {
+         continue;
+      }
+      sig->mtype = sig->msig->mtype = DIFF_MANUAL;
+      idx.push_back(rows[i] - 1);
+   }
 
-   d->ilist->add(sig);
-   d->mlist->remove(n - 1);
+   src->move(dst, idx.begin(), idx.size());
 
-   // adding to identical
    refresh_chooser(title_identical);
-   // removing from matched
    refresh_chooser(title_match);
 
    return 1;
 }
 
+/*------------------------------------------------*/
+/* function : res_mtoi                            */
+/* description: Switches element n from matched   */
+/*              to identical list                 */
+/*------------------------------------------------*/
+
+static uint32 idaapi res_mtoi(void *obj, uint32 n) {
+   deng_t *d = (deng_t *)obj;
+
+   return res_move_rows(d->mlist, d->ilist, &n, 1);
+}
+
 /*------------------------------------------------*/
 /* function : res_itom                            */
 /* description: Switches element n from identical */
@@ -500,19 +674,8 @@ static uint32 idaapi res_mtoi(void *obj, uint32 n) {
 
 static uint32 idaapi res_itom(void *obj, uint32 n) {
    deng_t *d = (deng_t *)obj;
-   sig_t *sig = ui_access_sig(d->ilist, n);
-
-   sig->mtype = sig->msig->mtype = DIFF_MANUAL;
-
-   d->mlist->add(sig);
-   d->ilist->remove(n - 1);
-
-   // removing from identical
-   refresh_chooser(title_identical);
-   // adding to matched
-   refresh_chooser(title_match);
 
-   return 1;
+   return res_move_rows(d->ilist, d->mlist, &n, 1);
 }
 
 /*------------------------------------------------*/
@@ -523,6 +686,10 @@ static uint32 idaapi res_itom(void *obj, uint32 n) {
 static uint32 idaapi res_flagged(void *obj, uint32 n) {
    sig_t *sig = ui_access_sig(((deng_t *)obj)->mlist, n);
 
+   if (!sig) {
+      return 0;
+   }
+
    sig->flag = !sig->flag;
 
    // flagging only happens on the matched list
@@ -532,7 +699,13 @@ static uint32 idaapi res_flagged(void *obj, uint32 n) {
 }
 
 static void transfer_sym(sig_t *sig) {
-   sig_t *rhs = sig->msig;
+   sig_t *rhs;
+
+   if (!sig) {
+      return;
+   }
+
+   rhs = sig->msig;
    sig->set_name(rhs->name);
    set_name(sig->startEA, rhs->name.c_str(), SN_NOCHECK | SN_NON_AUTO);
 }
@@ -553,19 +726,60 @@ static uint32 idaapi transfer_sym_identical(void *obj, uint32 n) {
    return 1;
 }
 
+/*------------------------------------------------*/
+/* function : res_bdiff                           */
+/* description: Diffs the blocks of all the       */
+/*              matched functions into a file     */
+/*------------------------------------------------*/
+
+static uint32 idaapi res_bdiff(void *obj, uint32 n) {
+   deng_t *d = (deng_t *)obj;
+   char *file;
+
+   file = askfile_c(1, "*.txt", "Block diff results");
+   if (!file) {
+      return 0;
+   }
+
+   show_wait_box("PatchDiff is in progress ...");
+   if (bdiff_matched(d, file) == 0) {
+      msg("block diff results saved to %s\n", file);
+   }
+   hide_wait_box();
+
+   qnotused(n);
+   return 1;
+}
+
 #if IDA_SDK_VERSION >= 670
-//-------------------------------------------------------------------------
-int idaapi munmatch_action_handler_t::activate(action_activation_ctx_t *ctx) {
-   uint32 n = ctx->chooser_selection.size();
-   if (n == 1) {
-      n = ctx->chooser_selection[0];
+/*------------------------------------------------*/
+/* function : selection_rows                      */
+/* description: Gets the selected chooser rows    */
+/*              (indexed from 1)                  */
+/*------------------------------------------------*/
+
+static bool selection_rows(action_activation_ctx_t *ctx, qvector<uint32> &rows) {
+   size_t i;
+
+   for (i = 0; i < ctx->chooser_selection.size(); i++) {
 #if IDA_SDK_VERSION < 700
-      return res_munmatch(plugin->d_engine, n);
+      rows.push_back(ctx->chooser_selection[i]);
 #else
-      return res_munmatch(plugin->d_engine, n + 1);  //hack because pre-7.0 choosers index from 1
+      rows.push_back(ctx->chooser_selection[i] + 1);  //hack because pre-7.0 choosers index from 1
 #endif
    }
-   return 0;
+
+   return !rows.empty();
+}
+
+//-------------------------------------------------------------------------
+int idaapi munmatch_action_handler_t::activate(action_activation_ctx_t *ctx) {
+   qvector<uint32> rows;
+
+   if (!selection_rows(ctx, rows)) {
+      return 0;
+   }
+   return res_unmatch_rows(plugin->d_engine, rows.begin(), rows.size(), 1);
 }
    
 action_state_t idaapi munmatch_action_handler_t::update(action_update_ctx_t *ctx) {
@@ -585,16 +799,12 @@ action_state_t idaapi munmatch_action_handler_t::update(action_update_ctx_t *ctx
 
 //-------------------------------------------------------------------------
 int idaapi identical_action_handler_t::activate(action_activation_ctx_t *ctx) {
-   uint32 n = ctx->chooser_selection.size();
-   if (n == 1) {
-      n = ctx->chooser_selection[0];
-#if IDA_SDK_VERSION < 700
-      return res_mtoi(plugin->d_engine, n);
-#else
-      return res_mtoi(plugin->d_engine, n + 1);  //hack because pre-7.0 choosers index from 1
-#endif
+   qvector<uint32> rows;
+
+   if (!selection_rows(ctx, rows)) {
+      return 0;
    }
-   return 0;
+   return res_move_rows(plugin->d_engine->mlist, plugin->d_engine->ilist, rows.begin(), rows.size());
 }
 
 action_state_t idaapi identical_action_handler_t::update(action_update_ctx_t *ctx) {
@@ -671,17 +881,33 @@ action_state_t idaapi msym_action_handler_t::update(action_update_ctx_t *ctx) {
 }
 
 //-------------------------------------------------------------------------
-int idaapi iunmatch_action_handler_t::activate(action_activation_ctx_t *ctx) {
-   uint32 n = ctx->chooser_selection.size();
-   if (n == 1) {
-      n = ctx->chooser_selection[0];
+int idaapi bdiff_action_handler_t::activate(action_activation_ctx_t *ctx) {
+   return res_bdiff(plugin->d_engine, 0);
+}
+
+action_state_t idaapi bdiff_action_handler_t::update(action_update_ctx_t *ctx) {
+   bool ok = ctx->form_type == BWN_CHOOSER;
+   if (ok) {
+      //it's a chooser, now make sure it's the correct form
 #if IDA_SDK_VERSION < 700
-      return res_iunmatch(plugin->d_engine, n);
+      char name[MAXSTR];
+      ok = get_tform_title(ctx->form, name, sizeof(name)) && strneq(name, title_match, qstrlen(title_match));
 #else
-      return res_iunmatch(plugin->d_engine, n + 1);  //hack because pre-7.0 choosers index from 1
+      qstring title;
+      ok = get_widget_title(&title, ctx->widget) && title == title_match;
 #endif
    }
-   return 0;
+   return ok ? AST_ENABLE_FOR_FORM : AST_DISABLE_FOR_FORM;
+}
+
+//-------------------------------------------------------------------------
+int idaapi iunmatch_action_handler_t::activate(action_activation_ctx_t *ctx) {
+   qvector<uint32> rows;
+
+   if (!selection_rows(ctx, rows)) {
+      return 0;
+   }
+   return res_unmatch_rows(plugin->d_engine, rows.begin(), rows.size(), 0);
 }
 
 action_state_t idaapi iunmatch_action_handler_t::update(action_update_ctx_t *ctx) {
@@ -700,16 +926,12 @@ action_state_t idaapi iunmatch_action_handler_t::update(action_update_ctx_t *ctx
 
 //-------------------------------------------------------------------------
 int idaapi itom_action_handler_t::activate(action_activation_ctx_t *ctx) {
-   uint32 n = ctx->chooser_selection.size();
-   if (n == 1) {
-      n = ctx->chooser_selection[0];
-#if IDA_SDK_VERSION < 700
-      return res_itom(plugin->d_engine, n);
-#else
-      return res_itom(plugin->d_engine, n + 1);  //hack because pre-7.0 choosers index from 1
-#endif
+   qvector<uint32> rows;
+
+   if (!selection_rows(ctx, rows)) {
+      return 0;
    }
-   return 0;
+   return res_move_rows(plugin->d_engine->ilist, plugin->d_engine->mlist, rows.begin(), rows.size());
 }
 
 action_state_t idaapi itom_action_handler_t::update(action_update_ctx_t *ctx) {
@@ -787,11 +1009,25 @@ action_state_t idaapi match_action_handler_t::update(action_update_ctx_t *ctx) {
 
 #endif
 
+// the matched and identical lists allow several rows to be selected: their
+// actions (unmatch, set identical/matched) work on all the selected rows
+#if IDA_SDK_VERSION >= 670
+#define CH_RESULTS CH_MULTI
+#else
+#define CH_RESULTS 0
+#endif
+
 #if IDA_SDK_VERSION >= 700
 
 static void idaapi desc_dlist(slist_t *sl, uint32 n, qstrvec_t *cols_) {
    qstrvec_t &cols = *cols_;
    sig_t *sig = ui_access_sig(sl, n + 1); //hack because pre-7.0 choosers index from 1
+   if (!sig) {
+      for (size_t i = 0; i < cols.size(); i++) {
+         cols[i] = i == 1 ? UI_UNREADABLE : "";
+      }
+      return;
+   }
    cols[0].sprnt("%u", sig->mtype);
    cols[1].sprnt("%s", sig->name.c_str());
    cols[2].sprnt("%s", sig->msig->name.c_str());
@@ -803,7 +1039,7 @@ static void idaapi desc_dlist(slist_t *sl, uint32 n, qstrvec_t *cols_) {
 }
 
 //-------------------------------------------------------------------------
-struct matched_chooser_t : public chooser_t {
+struct matched_chooser_t : public chooser_multi_t {
 private:
    deng_t *eng;
 public:
@@ -826,15 +1062,29 @@ public:
    // function that generates the list line
    virtual void idaapi get_row(qstrvec_t *cols, int *icon_, chooser_item_attrs_t *attrs, size_t n) const;
 
-   // function that is called when the user hits Enter
-   virtual cbret_t idaapi enter(size_t n) {
-      enter_list(eng->mlist, n + 1);  //hack because pre-7.0 choosers index from 1
-      return cbret_t(); // nothing changed
+   // function that is called when the user hits Enter (on the first
+   // selected row)
+   virtual cbres_t idaapi enter(sizevec_t *sel) {
+      if (!sel->empty()) {
+         enter_list(eng->mlist, sel->front() + 1);  //hack because pre-7.0 choosers index from 1
+      }
+      return NOTHING_CHANGED;
    }
    
-   virtual cbret_t idaapi edit(size_t n) {
-      graph_match(eng, n + 1); //hack because pre-7.0 choosers index from 1
-      return cbret_t(); // nothing changed
+   // function that is called when the selection changes: the graph of
+   // the first selected row (then of its neighbours) is prepared by the
+   // second instance
+   virtual void idaapi select(const sizevec_t &sel) const {
+      if (!sel.empty() && prefetch_row(eng->mlist, sel.front() + 1, eng->opt) == 0) {
+         prefetch_list(eng->mlist, sel.front() + 1, eng->opt);
+      }
+   }
+
+   virtual cbres_t idaapi edit(sizevec_t *sel) {
+      if (!sel->empty()) {
+         graph_match(eng, sel->front() + 1); //hack because pre-7.0 choosers index from 1
+      }
+      return NOTHING_CHANGED;
    }
 
    virtual void idaapi closed();
@@ -842,7 +1092,7 @@ public:
 };
 
 inline matched_chooser_t::matched_chooser_t(deng_t *eng_) :
-      chooser_t(CH_ATTRS | CH_CAN_EDIT, qnumber(widths_match), widths_match, header_match, title_match) {
+      chooser_multi_t(CH_ATTRS | CH_RESULTS | CH_CAN_EDIT, qnumber(widths_match), widths_match, header_match, title_match) {
    eng = eng_;  
    popup_names[POPUP_EDIT] = "Display Graphs";
 }
@@ -858,7 +1108,7 @@ void idaapi matched_chooser_t::closed() {
 static matched_chooser_t *matched_chooser;
 
 //-------------------------------------------------------------------------
-struct identical_chooser_t : public chooser_t {
+struct identical_chooser_t : public chooser_multi_t {
 private:
    deng_t *eng;
 public:
@@ -881,15 +1131,29 @@ public:
    // function that generates the list line
    virtual void idaapi get_row(qstrvec_t *cols, int *icon_, chooser_item_attrs_t *attrs, size_t n) const;
 
-   // function that is called when the user hits Enter
-   virtual cbret_t idaapi enter(size_t n) {
-      enter_list(eng->ilist, n + 1); //hack because pre-7.0 choosers index from 1
-      return cbret_t(); // nothing changed
+   // function that is called when the user hits Enter (on the first
+   // selected row)
+   virtual cbres_t idaapi enter(sizevec_t *sel) {
+      if (!sel->empty()) {
+         enter_list(eng->ilist, sel->front() + 1); //hack because pre-7.0 choosers index from 1
+      }
+      return NOTHING_CHANGED;
    }
 
-   virtual cbret_t idaapi edit(size_t n) {
-      graph_identical(eng, n + 1);  //hack because pre-7.0 choosers index from 1
-      return cbret_t(); // nothing changed
+   // function that is called when the selection changes: the graph of
+   // the first selected row (then of its neighbours) is prepared by the
+   // second instance
+   virtual void idaapi select(const sizevec_t &sel) const {
+      if (!sel.empty() && prefetch_row(eng->ilist, sel.front() + 1, eng->opt) == 0) {
+         prefetch_list(eng->ilist, sel.front() + 1, eng->opt);
+      }
+   }
+
+   virtual cbres_t idaapi edit(sizevec_t *sel) {
+      if (!sel->empty()) {
+         graph_identical(eng, sel->front() + 1);  //hack because pre-7.0 choosers index from 1
+      }
+      return NOTHING_CHANGED;
    }
 
    virtual void idaapi closed() {
@@ -898,7 +1162,7 @@ public:
 };
 
 inline identical_chooser_t::identical_chooser_t(deng_t *eng_) :
-      chooser_t(CH_ATTRS | CH_CAN_EDIT, qnumber(widths_match), widths_match, header_match, title_identical) {
+      chooser_multi_t(CH_ATTRS | CH_RESULTS | CH_CAN_EDIT, qnumber(widths_match), widths_match, header_match, title_identical) {
    eng = eng_;  
    popup_names[POPUP_EDIT] = "Display Graphs";
 }
@@ -937,6 +1201,9 @@ public:
    virtual cbret_t idaapi enter(size_t n) {
       sig_t *sig = ui_access_sig(eng->ulist, n + 1);  //hack because pre-7.0 choosers index from 1
       
+      if (!sig) {
+         return cbret_t();
+      }
       if (sig->nfile == 1) {
          jumpto(sig->startEA);
       }
@@ -966,6 +1233,12 @@ inline unmatched_chooser_t::unmatched_chooser_t(deng_t *eng_) :
 void idaapi unmatched_chooser_t::get_row(qstrvec_t *cols_, int *, chooser_item_attrs_t *, size_t n) const {
    qstrvec_t &cols = *cols_;
    sig_t *sig = ui_access_sig(eng->ulist, n + 1);  //hack because pre-7.0 choosers index from 1
+   if (!sig) {
+      for (size_t i = 0; i < cols.size(); i++) {
+         cols[i] = i == 1 ? UI_UNREADABLE : "";
+      }
+      return;
+   }
    cols[0].sprnt("%u", sig->nfile);
    cols[1].sprnt("%s", sig->name.c_str());
    cols[2].sprnt("%a", sig->startEA);
@@ -985,7 +1258,7 @@ static unmatched_chooser_t *unmatched_chooser;
 
 static void display_matched(deng_t *eng) {
 #if IDA_SDK_VERSION <= 695
-   choose2(CH_ATTRS,
+   choose2(CH_ATTRS | CH_RESULTS,
       -1, -1, -1, -1,       // position is determined by Windows
       eng,                  // pass the created function list to the window
       qnumber(header_match),// number of columns
@@ -1006,7 +1279,7 @@ static void display_matched(deng_t *eng) {
 #else
    if (matched_chooser == NULL) {
       matched_chooser = new matched_chooser_t(eng);
-      matched_chooser->choose(chooser_t::NO_SELECTION);
+      matched_chooser->choose(sizevec_t());
    }
 #endif
 
@@ -1017,6 +1290,7 @@ static void display_matched(deng_t *eng) {
    add_chooser_command(title_match, "Set as identical", res_mtoi, 0, -1, CHOOSER_POPUP_MENU | CHOOSER_MENU_EDIT);
    add_chooser_command(title_match, "Flag/unflag", res_flagged, 0, -1, CHOOSER_POPUP_MENU | CHOOSER_MENU_EDIT);
    add_chooser_command(title_match, "Import Symbol", transfer_sym_match, 0, -1, CHOOSER_POPUP_MENU | CHOOSER_MENU_EDIT);
+   add_chooser_command(title_match, "Diff all blocks", res_bdiff, 0, -1, CHOOSER_POPUP_MENU | CHOOSER_MENU_EDIT);
 #else
    auto_wait();
 #if IDA_SDK_VERSION <= 695
@@ -1030,6 +1304,7 @@ static void display_matched(deng_t *eng) {
       attach_action_to_popup(form, NULL, IDENTICAL_NAME);
       attach_action_to_popup(form, NULL, FLAGUNFLAG_NAME);
       attach_action_to_popup(form, NULL, MSYM_NAME);
+      attach_action_to_popup(form, NULL, BDIFF_NAME);
    }
    else {
       msg("Failed to lookup form %s\n", title_match);
@@ -1044,7 +1319,7 @@ static void display_matched(deng_t *eng) {
 
 static void display_identical(deng_t *eng) {
 #if IDA_SDK_VERSION <= 695
-   choose2(0,
+   choose2(CH_RESULTS,
       -1, -1, -1, -1,       // position is determined by Windows
       eng,                  // pass the created function list to the window
       qnumber(header_match),// number of columns
@@ -1065,7 +1340,7 @@ static void display_identical(deng_t *eng) {
 #else
    if (identical_chooser == NULL) {
       identical_chooser = new identical_chooser_t(eng);
-      identical_chooser->choose(chooser_t::NO_SELECTION);
+      identical_chooser->choose(sizevec_t());
    }
 #endif
 
@@ -1165,7 +1440,8 @@ ssize_t idaapi ui_callback(void *data, int event_id, va_list va) {
       if (attrs != NULL) {
          deng_t *d = (deng_t *)co;
          if (d && d->magic == 0x0BADF00D && n > 0) {
-            if (ui_access_sig(d->mlist, n)->flag == 1) {
+            sig_t *sig = ui_access_sig(d->mlist, n);
+            if (sig && sig->flag == 1) {
                attrs->color = 0x908070;
             }
          }
@@ -1175,6 +1451,60 @@ ssize_t idaapi ui_callback(void *data, int event_id, va_list va) {
    return 0;
 }
 
+/*------------------------------------------------*/
+/* function : idb_callback                        */
+/* description: Invalidates the cached graphs and */
+/*              function names of the current IDB */
+/*              when it changes                   */
+/*------------------------------------------------*/
+
+#if IDA_SDK_VERSION < 700
+int idaapi idb_callback(void *data, int event_id, va_list va) {
+#else
+ssize_t idaapi idb_callback(void *data, int event_id, va_list va) {
+#endif
+#if IDA_SDK_VERSION >= 700
+   func_t *pfn;
+
+   // the graphs only depend on the bytes, the flow and the names
+   switch (event_id) {
+   case idb_event::renamed:
+      gcache_touch();
+      ncache_forget(va_arg(va, ea_t));
+      break;
+   case idb_event::func_added:
+   case idb_event::deleting_func:
+      gcache_touch();
+      pfn = va_arg(va, func_t *);
+      ncache_forget(pfn->startEA);
+      break;
+   case idb_event::set_func_start:
+      gcache_touch();
+      pfn = va_arg(va, func_t *);
+      ncache_forget(pfn->startEA);
+      ncache_forget(va_arg(va, ea_t));
+      break;
+   case idb_event::byte_patched:
+   case idb_event::make_code:
+   case idb_event::make_data:
+   case idb_event::destroyed_items:
+   case idb_event::func_updated:
+   case idb_event::set_func_end:
+   case idb_event::func_tail_appended:
+   case idb_event::func_tail_deleted:
+   case idb_event::tail_owner_changed:
+      gcache_touch();
+      break;
+   }
+#else
+   // older SDKs do not pass the renamed address
+   gcache_touch();
+   ncache_clear();
+#endif
+
+   return 0;
+}
+
 /*------------------------------------------------*/
 /* function : display_results                     */
 /* description: Displays diff results             */
@@ -1187,6 +1517,7 @@ void display_results(pd_plugmod_t *plugin) {
    register_action(plugin->identical_action);
    register_action(plugin->flagunflag_action);
    register_action(plugin->msym_action);
+   register_action(plugin->bdiff_action);
    register_action(plugin->iunmatch_action);
    register_action(plugin->itom_action);
    register_action(plugin->isym_action);
@@ -1199,3 +1530,62 @@ void display_results(pd_plugmod_t *plugin) {
    display_unmatched(plugin->d_engine);
    display_identical(plugin->d_engine);
 }
+
+/*------------------------------------------------*/
+/* function : deng_t::display                     */
+/* description: Splits the diff results into the  */
+/*              matched/identical/unmatched lists */
+/*              and displays them                 */
+/*------------------------------------------------*/
+
+void deng_t::display(pd_plugmod_t *plugin, slist_t *l1, slist_t *l2, const char *file) {
+   int un1, un2, idf, mf;
+
+   mlist = new slist_t(matched, file);
+   ulist = new slist_t(unmatched, file);
+   ilist = new slist_t(identical, file);
+
+   un1 = un2 = idf = mf = 0;
+
+   for (size_t i = 0; i < l1->num; i++) {
+      if (l1->sigs[i]->is_class()) {
+         delete l1->sigs[i];
+         continue;
+      }
+
+      if (l1->sigs[i]->get_matched_type() == DIFF_UNMATCHED) {
+         l1->sigs[i]->set_nfile(1);
+         ulist->add(l1->sigs[i]);
+         un1++;
+      }
+      else {
+         if (l1->sigs[i]->hash2 == l1->sigs[i]->msig->hash2 || sig_equal(l1->sigs[i], l1->sigs[i]->msig, DIFF_EQUAL_SIG_HASH)) {
+            ilist->add(l1->sigs[i]);
+            idf++;
+         }
+         else {
+            mlist->add(l1->sigs[i]);
+            mf++;
+         }
+      }
+   }
+
+   for (size_t i = 0; i < l2->num; i++) {
+      if (l2->sigs[i]->is_class()) {
+         delete l2->sigs[i];
+         continue;
+      }
+
+      if (l2->sigs[i]->get_matched_type() == DIFF_UNMATCHED) {
+         l2->sigs[i]->set_nfile(2);
+         ulist->add(l2->sigs[i]);
+         un2++;
+      }
+   }
+
+   msg("Identical functions:   %d\n", idf);
+   msg("Matched functions:     %d\n", mf);
+   msg("Unmatched functions 1: %d\n", un1);
+   msg("Unmatched functions 2: %d\n", un2);
+   display_results(plugin);
+}
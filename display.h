@@ -75,4 +75,10 @@ int idaapi ui_callback(void *data, int event_id, va_list va);
 ssize_t idaapi ui_callback(void *data, int event_id, va_list va);
 #endif
 
+#if IDA_SDK_VERSION < 700
+int idaapi idb_callback(void *data, int event_id, va_list va);
+#else
+ssize_t idaapi idb_callback(void *data, int event_id, va_list va);
+#endif
+
 #endif
@@ -0,0 +1,283 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "precomp.h"
+
+#include "gcache.h"
+#include "os.h"
+
+static gentry_t *gc_head = NULL;
+static gentry_t *gc_tail = NULL;
+static gcstats_t gc_stats = { 0, 0, 0, 0, 0 };
+
+// modification counter of the current IDB (see gcache_touch)
+static uint64_t gc_stamp = 1;
+
+/*------------------------------------------------*/
+/* function : gcache_list_size                    */
+/* description: Estimates the memory used by a    */
+/*              signature list                    */
+/*------------------------------------------------*/
+
+static size_t gcache_list_size(slist_t *sl) {
+   size_t size;
+   sig_t *sig;
+
+   if (!sl) {
+      return 0;
+   }
+
+   size = sizeof(slist_t) + sl->num * sizeof(sig_t *);
+   for (uint32_t i = 0; i < sl->num; i++) {
+      sig = sl->sigs[i];
+      size += sizeof(sig_t) + sig->name.length() + sig->dl.available;
+      if (sig->prefs) {
+         size += sizeof(frefs_t) + sig->prefs->num * sizeof(fref_t);
+      }
+      if (sig->srefs) {
+         size += sizeof(frefs_t) + sig->srefs->num * sizeof(fref_t);
+      }
+   }
+
+   return size;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_in_use                       */
+/* description: Checks if the entry lists are     */
+/*              displayed in a graph              */
+/*------------------------------------------------*/
+
+static bool gcache_in_use(gentry_t *e) {
+   return (e->sl1 && e->sl1->gv) || (e->sl2 && e->sl2->gv);
+}
+
+/*------------------------------------------------*/
+/* function : gcache_unlink                       */
+/* description: Removes an entry from the LRU     */
+/*              chain                             */
+/*------------------------------------------------*/
+
+static void gcache_unlink(gentry_t *e) {
+   if (e->prev) {
+      e->prev->next = e->next;
+   }
+   else {
+      gc_head = e->next;
+   }
+
+   if (e->next) {
+      e->next->prev = e->prev;
+   }
+   else {
+      gc_tail = e->prev;
+   }
+
+   e->prev = e->next = NULL;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_push                         */
+/* description: Inserts an entry at the head of   */
+/*              the LRU chain                     */
+/*------------------------------------------------*/
+
+static void gcache_push(gentry_t *e) {
+   e->prev = NULL;
+   e->next = gc_head;
+   if (gc_head) {
+      gc_head->prev = e;
+   }
+   else {
+      gc_tail = e;
+   }
+   gc_head = e;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_free_list                    */
+/* description: Frees a cached signature list     */
+/*------------------------------------------------*/
+
+static void gcache_free_list(slist_t *sl) {
+   if (sl) {
+      sl->free_sigs();
+      delete sl;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : gcache_release                      */
+/* description: Removes an entry from the cache   */
+/*              (lists still displayed are left   */
+/*              to their graph)                   */
+/*------------------------------------------------*/
+
+static void gcache_release(gentry_t *e) {
+   gcache_unlink(e);
+
+   gc_stats.num--;
+   gc_stats.size -= e->size;
+
+   if (!gcache_in_use(e)) {
+      gcache_free_list(e->sl1);
+      gcache_free_list(e->sl2);
+   }
+
+   qfree(e->file);
+   delete e;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_file_stamp                   */
+/* description: Returns the stamp of the second   */
+/*              IDB (0 if unused or unknown)      */
+/*------------------------------------------------*/
+
+static uint64_t gcache_file_stamp(const char *file, ea_t ea2) {
+   uint64_t stamp;
+
+   if (ea2 == BADADDR || !file || !os_file_stamp(file, &stamp)) {
+      return 0;
+   }
+
+   return stamp;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_find                         */
+/* description: Looks for an entry               */
+/*------------------------------------------------*/
+
+static gentry_t *gcache_find(const char *file, ea_t ea1, ea_t ea2) {
+   gentry_t *e;
+
+   for (e = gc_head; e; e = e->next) {
+      if (e->ea1 == ea1 && e->ea2 == ea2 && !strcmp(e->file, file ? file : "")) {
+         return e;
+      }
+   }
+
+   return NULL;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_get                          */
+/* description: Returns the cached lists of a     */
+/*              function pair if both IDBs are    */
+/*              unchanged                         */
+/*------------------------------------------------*/
+
+bool gcache_get(const char *file, ea_t ea1, ea_t ea2, slist_t **sl1, slist_t **sl2) {
+   gentry_t *e;
+
+   e = gcache_find(file, ea1, ea2);
+   if (!e) {
+      gc_stats.misses++;
+      return false;
+   }
+
+   if (e->stamp1 != gc_stamp || e->stamp2 != gcache_file_stamp(file, ea2)) {
+      gcache_release(e);
+      gc_stats.misses++;
+      return false;
+   }
+
+   gcache_unlink(e);
+   gcache_push(e);
+   gc_stats.hits++;
+
+   *sl1 = e->sl1;
+   *sl2 = e->sl2;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_add                          */
+/* description: Caches the lists of a function    */
+/*              pair, evicting the least recently */
+/*              used entries above budget bytes   */
+/*------------------------------------------------*/
+
+void gcache_add(const char *file, ea_t ea1, ea_t ea2, slist_t *sl1, slist_t *sl2, size_t budget) {
+   gentry_t *e, *prev;
+   size_t size;
+
+   size = gcache_list_size(sl1) + gcache_list_size(sl2);
+   if (size > budget) {
+      return;
+   }
+
+   e = gcache_find(file, ea1, ea2);
+   if (e) {
+      gcache_release(e);
+   }
+
+   for (e = gc_tail; e && gc_stats.size + size > budget; e = prev) {
+      prev = e->prev;
+      if (!gcache_in_use(e)) {
+         gcache_release(e);
+         gc_stats.evictions++;
+      }
+   }
+
+   e = new gentry_t;
+   e->file = qstrdup(file ? file : "");
+   e->ea1 = ea1;
+   e->ea2 = ea2;
+   e->stamp1 = gc_stamp;
+   e->stamp2 = gcache_file_stamp(file, ea2);
+   e->sl1 = sl1;
+   e->sl2 = sl2;
+   e->size = size;
+
+   gcache_push(e);
+   gc_stats.num++;
+   gc_stats.size += size;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_touch                        */
+/* description: Invalidates the entries built     */
+/*              from the current IDB              */
+/*------------------------------------------------*/
+
+void gcache_touch() {
+   gc_stamp++;
+}
+
+/*------------------------------------------------*/
+/* function : gcache_clear                        */
+/* description: Empties the cache                 */
+/*------------------------------------------------*/
+
+void gcache_clear() {
+   while (gc_head) {
+      gcache_release(gc_head);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : gcache_get_stats                    */
+/* description: Returns the cache counters        */
+/*------------------------------------------------*/
+
+void gcache_get_stats(gcstats_t *st) {
+   *st = gc_stats;
+}
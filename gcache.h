@@ -0,0 +1,57 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __GCACHE_H__
+#define __GCACHE_H__
+
+#include "precomp.h"
+#include "sig.h"
+
+// Graph cache: function lists parsed and diffed for the graph views, keyed
+// by (second IDB, first function, second function) and by the modification
+// stamps of both IDBs. A missing function is BADADDR (unmatched graphs).
+// Lists still displayed in a graph are never freed by the cache.
+
+struct gentry_t {
+   gentry_t *prev;      // LRU chain, most recently used first
+   gentry_t *next;
+   char *file;
+   ea_t ea1;
+   ea_t ea2;
+   uint64_t stamp1;
+   uint64_t stamp2;
+   slist_t *sl1;
+   slist_t *sl2;
+   size_t size;
+};
+
+struct gcstats_t {
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+   uint32_t num;        // cached entries
+   size_t size;         // estimated size of the cached lists
+};
+
+bool gcache_get(const char *, ea_t, ea_t, slist_t **, slist_t **);
+void gcache_add(const char *, ea_t, ea_t, slist_t *, slist_t *, size_t);
+void gcache_touch();
+void gcache_clear();
+void gcache_get_stats(gcstats_t *);
+
+#endif
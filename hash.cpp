@@ -21,61 +21,135 @@
 #include "hash.h"
 #include "sig.h"
 
+/*------------------------------------------------*/
+/* function : hash_alloc_table                    */
+/* description: Allocates an empty table of size  */
+/*              elements (power of two)           */
+/*------------------------------------------------*/
+
+static bool hash_alloc_table(hpsig_t *hsig, uint32_t size) {
+   hsig->table = new hsignature_t[size];
+   if (!hsig->table) {
+      return false;
+   }
+   memset(hsig->table, 0, size * sizeof(hsignature_t));
+   hsig->mask = size - 1;
+   hsig->num = 0;
+
+   return true;
+}
+
 /*------------------------------------------------*/
 /* function : hash_init                           */
-/* description: Initializes hash table to NULL    */
+/* description: Initializes an empty hash table   */
+/*              sized for num elements            */
 /*------------------------------------------------*/
 
 hpsig_t *hash_init(size_t num) {
-   unsigned int i;
+   uint32_t size = 64;
    hpsig_t *hsig;
-   static unsigned int primes[] = { 67, 251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521, 131071, 262139, 524287, 1048573, 2097143 };
 
-   for (i = 0; i < ((sizeof(primes) / sizeof(unsigned int)) - 1); i++) {
-      if (primes[i] > (num/3)) {
-         break;
-      }
+   // keeps the load factor under 1/2
+   while (size < num * 2 && size < 0x80000000) {
+      size <<= 1;
    }
+
    hsig = new hpsig_t();
    if (!hsig) {
       return NULL;
    }
-   hsig->max_hash = primes[i];
-   hsig->table = new hsignature_t *[hsig->max_hash];
-   if (!hsig->table) {
+   if (!hash_alloc_table(hsig, size)) {
       delete hsig;
       return NULL;
    }
 
-   for (i = 0; i < hsig->max_hash; i++) {
-      hsig->table[i] = NULL;
-   }
    return hsig;
 }
 
 /*------------------------------------------------*/
 /* function : hash_mk_ea                          */
-/* description: Creates hash value                */
+/* description: Creates hash value (slot index)   */
 /*------------------------------------------------*/
 
 unsigned int hash_mk_ea(hpsig_t *htable, ea_t val) {
-   char *ptr;
-   unsigned int h = 0;
-   int i;
+   uint64_t h = (uint64_t)val;
+
+   // murmur3 64-bit finalizer
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+
+   return (unsigned int)h & htable->mask;
+}
+
+/*------------------------------------------------*/
+/* function : hash_insert                         */
+/* description: Inserts an element (robin hood    */
+/*              displacement). An element with    */
+/*              the same address is replaced      */
+/*------------------------------------------------*/
+
+static void hash_insert(hpsig_t *htable, ea_t ea, sig_t *sig) {
+   hsignature_t cur, tmp, *slot;
+   unsigned int id = hash_mk_ea(htable, ea);
+   bool displaced = false;
+
+   cur.ea = ea;
+   cur.sig = sig;
+   cur.dist = 1;
+
+   while (1) {
+      slot = &htable->table[id];
+
+      if (slot->dist == 0) {
+         *slot = cur;
+         htable->num++;
+         return;
+      }
+
+      // only the element being added can already be in the table
+      if (!displaced && slot->ea == cur.ea) {
+         slot->sig = cur.sig;
+         return;
+      }
 
-   ptr = (char *) &val;
+      if (slot->dist < cur.dist) {
+         tmp = *slot;
+         *slot = cur;
+         cur = tmp;
+         displaced = true;
+      }
 
-   for (i = 0; i < sizeof(val); i++) {
-      h += ptr[i];
-      h += ( h << 10 );
-      h ^= ( h >> 6 );
+      id = (id + 1) & htable->mask;
+      cur.dist++;
    }
+}
 
-   h += ( h << 3);
-   h ^= ( h >> 11 );
-   h += ( h >> 15 );
+/*------------------------------------------------*/
+/* function : hash_grow                           */
+/* description: Doubles the table size            */
+/*------------------------------------------------*/
+
+static bool hash_grow(hpsig_t *htable) {
+   hsignature_t *old = htable->table;
+   uint32_t i, size = htable->mask + 1;
+
+   if (size >= 0x80000000 || !hash_alloc_table(htable, size * 2)) {
+      htable->table = old;
+      return false;
+   }
 
-   return h % htable->max_hash;
+   for (i = 0; i < size; i++) {
+      if (old[i].dist) {
+         hash_insert(htable, old[i].ea, old[i].sig);
+      }
+   }
+
+   delete [] old;
+
+   return true;
 }
 
 /*------------------------------------------------*/
@@ -84,16 +158,13 @@ unsigned int hash_mk_ea(hpsig_t *htable, ea_t val) {
 /*------------------------------------------------*/
 
 int hash_add_ea (hpsig_t *htable, sig_t *sig) {
-   int id = hash_mk_ea(htable, sig->startEA);
-   hsignature_t *hsig = NULL;
-
-   hsig = new hsignature_t();
-   if (!hsig) {
-      return -1;
+   if ((htable->num + 1) * 8 > (htable->mask + 1) * 7) {
+      if (!hash_grow(htable)) {
+         return -1;
+      }
    }
-   hsig->sig = sig;
-   hsig->next = htable->table[id];
-   htable->table[id] = hsig;
+
+   hash_insert(htable, sig->startEA, sig);
 
    return 0;
 }
@@ -104,22 +175,27 @@ int hash_add_ea (hpsig_t *htable, sig_t *sig) {
 /*------------------------------------------------*/
 
 sig_t *hash_find_ea (hpsig_t *htable, ea_t ea) {
+   hsignature_t *slot;
+   unsigned int id;
+   uint32_t dist;
+
    if (ea == BADADDR) {
       return NULL;
    }
-   int id = hash_mk_ea(htable, ea);
-   hsignature_t *hsig;
 
-   hsig = htable->table[id];
+   id = hash_mk_ea(htable, ea);
 
-   while (hsig != NULL) {
-      if (hsig->sig->startEA == ea) {
-         return hsig->sig;
+   // stops as soon as the probed element is closer to its home slot
+   for (dist = 1; ; dist++) {
+      slot = &htable->table[id];
+      if (slot->dist < dist) {
+         return NULL;
       }
-      hsig = hsig->next;
+      if (slot->ea == ea) {
+         return slot->sig;
+      }
+      id = (id + 1) & htable->mask;
    }
-
-   return NULL;
 }
 
 /*------------------------------------------------*/
@@ -128,20 +204,6 @@ sig_t *hash_find_ea (hpsig_t *htable, ea_t ea) {
 /*------------------------------------------------*/
 
 void hash_free (hpsig_t *htable) {
-   unsigned int i;
-   hsignature_t *hsig, *tmp;
-
-   for (i = 0; i < htable->max_hash; i++) {
-      hsig = htable->table[i];
-
-      while (hsig != NULL) {
-         tmp = hsig->next;
-         delete hsig;
-
-         hsig = tmp;
-      }
-   }
-
-   delete [] htable;
+   delete [] htable->table;
+   delete htable;
 }
-
@@ -21,14 +21,18 @@
 
 #include "sig.h"
 
+// open addressing (robin hood) slot, dist is the probe distance + 1
+// (0 means empty)
 struct hsignature_t {
+   ea_t ea;
    sig_t *sig;
-   hsignature_t *next;
+   uint32_t dist;
 };
 
 struct hpsig_t {
-   unsigned int max_hash;
-   hsignature_t **table ;
+   uint32_t mask;          // table size - 1 (power of two)
+   uint32_t num;           // number of elements
+   hsignature_t *table;
 };
 
 hpsig_t * hash_init(size_t);
@@ -0,0 +1,424 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "precomp.h"
+
+#include "ncache.h"
+
+#ifdef PDIFF_THREADS
+#include <mutex>
+#endif
+
+static nslot_t *nc_table = NULL;
+static uint32_t nc_mask = 0;         // table size - 1 (power of two)
+static char *nc_pool = NULL;
+static size_t nc_alloc = 0;          // allocated pool size
+static size_t nc_garbage = 0;        // bytes of the forgotten names
+static uint32_t nc_long = 0;         // demangling options of the cached names
+static uint32_t nc_short = 0;
+static ncstats_t nc_stats = { 0, 0, 0, 0, 0 };
+
+#ifdef PDIFF_THREADS
+// parse_idb workers name their functions concurrently
+static std::mutex nc_lock;
+#endif
+
+/*------------------------------------------------*/
+/* function : ncache_hash                         */
+/* description: Returns the home slot of an      */
+/*              address                           */
+/*------------------------------------------------*/
+
+static uint32_t ncache_hash(ea_t ea) {
+   uint64_t h = (uint64_t)ea;
+
+   // murmur3 64-bit finalizer
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+
+   return (uint32_t)h & nc_mask;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_find                         */
+/* description: Returns the slot of an address    */
+/*              (NULL if not cached)              */
+/*------------------------------------------------*/
+
+static nslot_t *ncache_find(ea_t ea) {
+   nslot_t *slot;
+   uint32_t id, dist;
+
+   if (!nc_table) {
+      return NULL;
+   }
+
+   id = ncache_hash(ea);
+
+   // stops as soon as the probed element is closer to its home slot
+   for (dist = 1; ; dist++) {
+      slot = &nc_table[id];
+      if (slot->dist < dist) {
+         return NULL;
+      }
+      if (slot->ea == ea) {
+         return slot;
+      }
+      id = (id + 1) & nc_mask;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : ncache_insert                       */
+/* description: Inserts an address missing from   */
+/*              the table (robin hood             */
+/*              displacement)                     */
+/*------------------------------------------------*/
+
+static void ncache_insert(ea_t ea, uint32_t off) {
+   nslot_t cur, tmp, *slot;
+   uint32_t id = ncache_hash(ea);
+
+   cur.ea = ea;
+   cur.off = off;
+   cur.dist = 1;
+
+   while (1) {
+      slot = &nc_table[id];
+
+      if (slot->dist == 0) {
+         *slot = cur;
+         nc_stats.num++;
+         return;
+      }
+
+      if (slot->dist < cur.dist) {
+         tmp = *slot;
+         *slot = cur;
+         cur = tmp;
+      }
+
+      id = (id + 1) & nc_mask;
+      cur.dist++;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : ncache_remove                       */
+/* description: Removes a slot, shifting back the */
+/*              elements of its probe sequence    */
+/*------------------------------------------------*/
+
+static void ncache_remove(nslot_t *slot) {
+   nslot_t *next;
+   uint32_t id = (uint32_t)(slot - nc_table);
+
+   while (1) {
+      next = &nc_table[(id + 1) & nc_mask];
+      if (next->dist <= 1) {
+         break;
+      }
+      *slot = *next;
+      slot->dist--;
+      slot = next;
+      id = (id + 1) & nc_mask;
+   }
+
+   memset(slot, 0, sizeof(*slot));
+   nc_stats.num--;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_grow                         */
+/* description: Doubles the table size            */
+/*------------------------------------------------*/
+
+static bool ncache_grow() {
+   nslot_t *old = nc_table;
+   uint32_t i, size = nc_table ? nc_mask + 1 : 0;
+   uint32_t nsize = size ? size * 2 : 1024;
+
+   if (size >= 0x80000000) {
+      return false;
+   }
+
+   nc_table = new nslot_t[nsize];
+   if (!nc_table) {
+      nc_table = old;
+      return false;
+   }
+   memset(nc_table, 0, nsize * sizeof(nslot_t));
+   nc_mask = nsize - 1;
+   nc_stats.num = 0;
+
+   for (i = 0; i < size; i++) {
+      if (old[i].dist) {
+         ncache_insert(old[i].ea, old[i].off);
+      }
+   }
+
+   delete [] old;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_compact                      */
+/* description: Rebuilds the pool without the     */
+/*              forgotten names                   */
+/*------------------------------------------------*/
+
+static void ncache_compact() {
+   char *pool;
+   size_t used, len;
+   uint32_t i;
+
+   pool = new char[nc_stats.size - nc_garbage + 1];
+   if (!pool) {
+      return;
+   }
+
+   used = 0;
+   for (i = 0; i <= nc_mask; i++) {
+      if (nc_table[i].dist && nc_table[i].off != NCACHE_NONAME) {
+         len = strlen(nc_pool + nc_table[i].off) + 1;
+         memcpy(pool + used, nc_pool + nc_table[i].off, len);
+         nc_table[i].off = (uint32_t)used;
+         used += len;
+      }
+   }
+
+   delete [] nc_pool;
+   nc_pool = pool;
+   nc_alloc = nc_stats.size - nc_garbage + 1;
+   nc_stats.size = used;
+   nc_garbage = 0;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_store                        */
+/* description: Appends a name to the pool and    */
+/*              sets its offset (NCACHE_NONAME if */
+/*              name is NULL)                     */
+/* note: returns false if the pool is full or     */
+/*       cannot be grown                          */
+/*------------------------------------------------*/
+
+static bool ncache_store(const char *name, uint32_t *off) {
+   size_t len, size;
+   char *pool;
+
+   if (!name) {
+      *off = NCACHE_NONAME;
+      return true;
+   }
+
+   len = strlen(name) + 1;
+   if (nc_stats.size + len >= NCACHE_NONAME) {
+      return false;
+   }
+
+   if (nc_stats.size + len > nc_alloc) {
+      size = nc_alloc ? nc_alloc * 2 : 0x10000;
+      while (size < nc_stats.size + len) {
+         size *= 2;
+      }
+      pool = new char[size];
+      if (!pool) {
+         return false;
+      }
+      if (nc_pool) {
+         memcpy(pool, nc_pool, nc_stats.size);
+         delete [] nc_pool;
+      }
+      nc_pool = pool;
+      nc_alloc = size;
+   }
+
+   *off = (uint32_t)nc_stats.size;
+   memcpy(nc_pool + *off, name, len);
+   nc_stats.size += len;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_drop                         */
+/* description: Accounts the name of a slot as    */
+/*              garbage                           */
+/*------------------------------------------------*/
+
+static void ncache_drop(nslot_t *slot) {
+   if (slot->off != NCACHE_NONAME) {
+      nc_garbage += strlen(nc_pool + slot->off) + 1;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : ncache_reset                        */
+/* description: Frees the table and the pool      */
+/*------------------------------------------------*/
+
+static void ncache_reset() {
+   delete [] nc_table;
+   delete [] nc_pool;
+
+   nc_table = NULL;
+   nc_pool = NULL;
+   nc_mask = 0;
+   nc_alloc = 0;
+   nc_garbage = 0;
+   nc_stats.num = 0;
+   nc_stats.size = 0;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_get                          */
+/* description: Copies the cached name of a      */
+/*              function demangled with the given */
+/*              long/short options                */
+/* note: returns 1 if found, 0 if the function    */
+/*       has no usable name and -1 if not cached  */
+/*------------------------------------------------*/
+
+int ncache_get(ea_t ea, uint32_t long_demnames, uint32_t short_demnames, char *buffer, size_t blen) {
+   nslot_t *slot;
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(nc_lock);
+#endif
+
+   if (long_demnames != nc_long || short_demnames != nc_short) {
+      ncache_reset();
+      nc_long = long_demnames;
+      nc_short = short_demnames;
+   }
+
+   slot = ncache_find(ea);
+   if (!slot) {
+      nc_stats.misses++;
+      return -1;
+   }
+
+   nc_stats.hits++;
+
+   if (slot->off == NCACHE_NONAME) {
+      return 0;
+   }
+
+   qstrncpy(buffer, nc_pool + slot->off, blen);
+
+   return 1;
+}
+
+/*------------------------------------------------*/
+/* function : ncache_add                          */
+/* description: Caches the name of a function     */
+/*              (NULL if it has no usable name)   */
+/*              which took time ns to compute     */
+/*------------------------------------------------*/
+
+void ncache_add(ea_t ea, const char *name, uint64_t time) {
+   nslot_t *slot;
+   uint32_t off;
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(nc_lock);
+#endif
+
+   nc_stats.time += time;
+
+   slot = ncache_find(ea);
+   if (!slot && (!nc_table || (nc_stats.num + 1) * 8 > (nc_mask + 1) * 7)) {
+      if (!ncache_grow()) {
+         return;
+      }
+   }
+
+   // a name that cannot be stored is not cached (NCACHE_NONAME would drop
+   // the function), it is demangled again on the next lookup
+   if (!ncache_store(name, &off)) {
+      if (slot) {
+         ncache_drop(slot);
+         ncache_remove(slot);
+      }
+      return;
+   }
+
+   if (slot) {
+      ncache_drop(slot);
+      slot->off = off;
+      return;
+   }
+
+   ncache_insert(ea, off);
+}
+
+/*------------------------------------------------*/
+/* function : ncache_forget                       */
+/* description: Removes the name of a function    */
+/*------------------------------------------------*/
+
+void ncache_forget(ea_t ea) {
+   nslot_t *slot;
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(nc_lock);
+#endif
+
+   slot = ncache_find(ea);
+   if (!slot) {
+      return;
+   }
+
+   ncache_drop(slot);
+   ncache_remove(slot);
+
+   if (nc_garbage > 0x10000 && nc_garbage > nc_stats.size / 2) {
+      ncache_compact();
+   }
+}
+
+/*------------------------------------------------*/
+/* function : ncache_clear                        */
+/* description: Empties the cache                 */
+/*------------------------------------------------*/
+
+void ncache_clear() {
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(nc_lock);
+#endif
+
+   ncache_reset();
+}
+
+/*------------------------------------------------*/
+/* function : ncache_get_stats                    */
+/* description: Returns the cache counters        */
+/*------------------------------------------------*/
+
+void ncache_get_stats(ncstats_t *st) {
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(nc_lock);
+#endif
+
+   *st = nc_stats;
+}
@@ -0,0 +1,54 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __NCACHE_H__
+#define __NCACHE_H__
+
+#include "precomp.h"
+
+// Name cache: function names returned by pget_func_name, keyed by function
+// address and stored in a single string pool. Functions without a usable
+// name are cached too. An entry is dropped when the IDB notifies a change
+// of its name (see idb_callback) and the whole cache when the demangling
+// options change.
+
+#define NCACHE_NONAME 0xFFFFFFFF
+
+// open addressing (robin hood) slot, dist is the probe distance + 1
+// (0 means empty)
+struct nslot_t {
+   ea_t ea;
+   uint32_t off;        // name offset in the pool (or NCACHE_NONAME)
+   uint32_t dist;
+};
+
+struct ncstats_t {
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t time;       // nanoseconds spent naming the missed functions
+   uint32_t num;        // cached entries
+   size_t size;         // string pool size
+};
+
+int ncache_get(ea_t, uint32_t, uint32_t, char *, size_t);
+void ncache_add(ea_t, const char *, uint64_t);
+void ncache_forget(ea_t);
+void ncache_clear();
+void ncache_get_stats(ncstats_t *);
+
+#endif
@@ -20,10 +20,12 @@
 
 #include "options.h"
 #include "system.h"
+#include "gcache.h"
 #include "plugin.h"
 
 static bool idaapi pdiff_menu_callback(void *ud) {
    ushort option = 0, prev = 0;
+   sval_t threads, dthreads, gcache;
    pd_plugmod_t *plugin = (pd_plugmod_t *)ud;
    options_t *opt = plugin->d_opt;
 
@@ -32,20 +34,36 @@ static bool idaapi pdiff_menu_callback(void *ud) {
 
          "PatchDiff2 options\n\n\n"
          "<#Uses 'pipe' with the second IDA instance to speed up graph display#Settings##Keep second IDB open :C>\n"
-         "<#Saves PatchDiff2 results into the current IDB#Save results to IDB :C>>\n\n"
+         "<#Saves PatchDiff2 results into the current IDB#Save results to IDB :C>\n"
+         "<#Keeps the signatures next to each IDB to only regenerate the modified functions#Cache signatures :C>>\n\n"
+         "<#Number of threads used to generate signatures#Signature threads :D:4:4::>\n"
+         "<#Number of threads used to match functions (1 keeps a reproducible order)#Diff threads :D:4:4::>\n"
+         "<#Memory used to keep the last displayed graphs (0 disables the cache)#Graph cache (MB) :D:4:4::>\n\n"
          ;
 
    option |= opt->ipc ? 1 : 0;
    option |= opt->save_db ? 2 : 0;
+   option |= opt->sig_cache ? 4 : 0;
    prev = opt->ipc;
+   threads = opt->threads;
+   dthreads = opt->diff_threads;
+   gcache = opt->graph_cache;
 
-   if (AskUsingForm_c(format, &option)) {
+   if (AskUsingForm_c(format, &option, &threads, &dthreads, &gcache)) {
       opt->ipc = (option & 1) == 1;
       opt->save_db = (option & 2) == 2;
+      opt->sig_cache = (option & 4) == 4;
+      opt->threads = threads < 1 ? 1 : (int)threads;
+      opt->diff_threads = dthreads < 1 ? 1 : (int)dthreads;
+      opt->graph_cache = gcache < 0 ? 0 : (int)gcache;
 
-      if (prev && !option) {
+      if (prev && !(option & 1)) {
          ipc_close();
       }
+
+      if (!opt->graph_cache) {
+         gcache_clear();
+      }
    }
 
    return true;
@@ -65,7 +83,7 @@ action_state_t idaapi options_action_handler_t::update(action_update_ctx_t *ctx)
 #endif
 
 options_t::options_t(pd_plugmod_t *plugin) {
-   int ipc, db;
+   int ipc, db, scache, threads, dthreads, gcache;
 
    if (system_get_pref("IPC", (void *)&ipc, SPREF_INT)) {
       this->ipc = !!ipc;
@@ -81,6 +99,38 @@ options_t::options_t(pd_plugmod_t *plugin) {
       this->save_db = true;
    }
 
+   if (system_get_pref("SIG_CACHE", (void *)&scache, SPREF_INT)) {
+      this->sig_cache = !!scache;
+   }
+   else {
+      this->sig_cache = true;
+   }
+
+   // IDA kernel calls are not guaranteed to be thread safe: parallel
+   // signature generation has to be explicitly enabled
+   if (system_get_pref("THREADS", (void *)&threads, SPREF_INT) && threads > 1) {
+      this->threads = threads;
+   }
+   else {
+      this->threads = 1;
+   }
+
+   // parallel matching does not follow the serial match order: the results
+   // can differ slightly, so it has to be explicitly enabled too
+   if (system_get_pref("DIFF_THREADS", (void *)&dthreads, SPREF_INT) && dthreads > 1) {
+      this->diff_threads = dthreads;
+   }
+   else {
+      this->diff_threads = 1;
+   }
+
+   if (system_get_pref("GRAPH_CACHE", (void *)&gcache, SPREF_INT) && gcache >= 0) {
+      this->graph_cache = gcache;
+   }
+   else {
+      this->graph_cache = 32;
+   }
+
 #if IDA_SDK_VERSION <= 660
    add_menu_item("Options/", "PatchDiff2", NULL, SETMENU_APP, pdiff_menu_callback, this);
 #elif IDA_SDK_VERSION < 750
@@ -114,3 +164,19 @@ bool options_t::options_use_ipc() {
 bool options_t::options_save_db() {
    return save_db;
 }
+
+bool options_t::options_sig_cache() {
+   return sig_cache;
+}
+
+int options_t::options_threads() {
+   return threads;
+}
+
+int options_t::options_diff_threads() {
+   return diff_threads;
+}
+
+size_t options_t::options_graph_cache() {
+   return (size_t)graph_cache * 1024 * 1024;
+}
@@ -24,12 +24,20 @@ struct pd_plugmod_t;
 struct options_t {
    bool ipc;   // inter process communication
    bool save_db;
+   bool sig_cache; // reuses the signatures of unchanged functions
+   int threads; // signature generation workers
+   int diff_threads; // diff workers (1: serial and reproducible order)
+   int graph_cache;  // graph cache budget in MB (0: disabled)
 
    options_t(pd_plugmod_t *);
    ~options_t();
 
    bool options_use_ipc();
    bool options_save_db();
+   bool options_sig_cache();
+   int options_threads();
+   int options_diff_threads();
+   size_t options_graph_cache();
 
 };
 
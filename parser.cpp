@@ -23,6 +23,66 @@
 #include "os.h"
 #include "pchart.h"
 #include "system.h"
+#include "ncache.h"
+
+/*------------------------------------------------*/
+/* function : parse_idb_shard                     */
+/* description: generates the signatures of the   */
+/*              functions [start, end[ into the   */
+/*              shard private lists               */
+/*------------------------------------------------*/
+
+static void parse_idb_shard(pshard_t *shard) {
+   const screcord_t *rec;
+   uint64_t fp, start, time;
+   sig_t *sig;
+   size_t i;
+
+   for (i = shard->start; i < shard->end; i++) {
+      rec = NULL;
+      fp = 0;
+      start = get_nsec_stamp();
+
+      if (shard->sc) {
+         fp = scache_fingerprint(getn_func(i));
+         rec = shard->sc->find(getn_func(i)->startEA, fp);
+      }
+
+      sig = sig_generate(i, shard->class_l, rec, shard->sc ? shard->sc->edges : NULL);
+
+      time = get_nsec_stamp() - start;
+      if (shard->sc) {
+         if (rec) {
+            shard->hits++;
+            shard->hit_time += time;
+         }
+         else {
+            shard->misses++;
+            shard->miss_time += time;
+         }
+      }
+      if (sig && !rec) {
+         shard->gen_time += time;
+         shard->gen_lines += sig->lines;
+      }
+
+      if (sig) {
+         // removes 1 line jump functions
+         if (sig->sig == 0 || sig->lines <= 1) {
+            delete sig;
+         }
+         else {
+            shard->sl->add(sig);
+            if (shard->sc) {
+               shard->fps.push_back(fp);
+            }
+            if (shard->sink) {
+               shard->sink(sig);
+            }
+         }
+      }
+   }
+}
 
 /*------------------------------------------------*/
 /* function : parse_idb                           */
@@ -30,42 +90,85 @@
 /*              the current idb                   */
 /*------------------------------------------------*/
 
-slist_t *parse_idb() {
+slist_t *parse_idb(options_t *opt, psink_t sink) {
    slist_t *sl;
    sig_t *sig;
-   size_t fct_num, i;
-   qvector<ea_t> class_l;
+   size_t fct_num, i, nshards;
+   pshard_t *shards, all;
+   scache_t *sc = NULL;
+   ncstats_t ns1, ns2;
+   char path[QMAXPATH];
 
    fct_num = get_func_qty();
+   ncache_get_stats(&ns1);
+
+   nshards = opt ? opt->options_threads() : 1;
+   if (nshards > fct_num) {
+      nshards = fct_num;
+   }
+   if (nshards < 1) {
+      nshards = 1;
+   }
 
    sl = new slist_t(fct_num, NULL);
    if (!sl) {
       return NULL;
    }
 
-   for (i = 0; i < fct_num; i++) {
-      sig = sig_generate(i, class_l);
-      if (sig) {
-         // removes 1 line jump functions
-         if (sig->sig == 0 || sig->lines <= 1) {
-            delete sig;
-         }
-         else {
-            sl->add(sig);
-         }
+   // the previous signatures of the unchanged functions are reused
+   if (opt && opt->options_sig_cache() && scache_get_path(path, sizeof(path))) {
+      sc = new scache_t();
+      sc->open(path);
+   }
+
+   shards = pshard_init(fct_num, nshards, sink, sc);
+   pshard_run(shards, nshards, parse_idb_shard, sink);
+
+   all.sl = sl;
+   pshard_merge(shards, nshards, &all);
+   delete [] shards;
+
+   if (sc) {
+      sc->hits += all.hits;
+      sc->misses += all.misses;
+      sc->hit_time += all.hit_time;
+      sc->miss_time += all.miss_time;
+   }
+
+   // all workers included: the time per instruction is not divided by the
+   // number of threads
+   if (all.gen_lines) {
+      msg("signatures: %u instructions hashed, %u ns per instruction\n",
+          (uint32_t)all.gen_lines, (uint32_t)(all.gen_time / all.gen_lines));
+   }
+
+   ncache_get_stats(&ns2);
+   msg("function names: %u/%u cached, %u ms spent demangling\n",
+       (uint32_t)(ns2.hits - ns1.hits), (uint32_t)(ns2.hits - ns1.hits + ns2.misses - ns1.misses),
+       (uint32_t)((ns2.time - ns1.time) / 1000000));
+
+   // the class signatures are not cached: they are added after
+   if (sc) {
+      sc->print_stats();
+      if (sc->save(sl, all.fps.begin(), sl->num) != 0) {
+         msg("signature cache: failed to write %s\n", sc->file);
       }
+      delete sc;
    }
 
-   if (!sl->realloc(class_l.size())) {
+   if (!sl->realloc(all.class_l.size())) {
       sl->free_sigs();
       delete sl;
       return NULL;
    }
 
-   for (i = 0; i < class_l.size(); i++) {
-      sig = sig_class_generate(class_l[i]);
+   for (i = 0; i < all.class_l.size(); i++) {
+      sig = sig_class_generate(all.class_l[i]);
       if (sig) {
          sl->add(sig);
+         if (sink) {
+            sink(sig);
+         }
       }
    }
 
@@ -94,7 +197,8 @@ slist_t *parse_fct(ea_t ea, char options) {
       return NULL;
    }
 
-   if (!pget_func_name(ea, buf, sizeof(buf))) {
+   // names are cached by function start
+   if (!pget_func_name(fct->startEA, buf, sizeof(buf))) {
       return NULL;
    }
 
@@ -136,12 +240,73 @@ slist_t *parse_fct(ea_t ea, char options) {
 }
 
 /*------------------------------------------------*/
-/* function : parse_second_idb                    */
-/* description: generates a list of signatures for*/
-/*              another idb                       */
+/* function : parse_fcts_shard                    */
+/* description: generates the block lists of the  */
+/*              functions [start, end[            */
+/*------------------------------------------------*/
+
+static void parse_fcts_shard(pshard_t *shard) {
+   pfargs_t *args = (pfargs_t *)shard->arg;
+   size_t i;
+
+   for (i = shard->start; i < shard->end; i++) {
+      args->lists[i] = parse_fct(args->eas[i], args->options);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : parse_fcts                          */
+/* description: generates the block lists of     */
+/*              several functions of the current  */
+/*              idb (NULL items on errors)        */
+/*------------------------------------------------*/
+
+slist_t **parse_fcts(const ea_t *eas, size_t num, char options, options_t *opt) {
+   slist_t **lists;
+   pshard_t *shards;
+   pfargs_t args;
+   size_t i, nshards;
+
+   nshards = opt ? opt->options_threads() : 1;
+   if (nshards > num) {
+      nshards = num;
+   }
+   if (nshards < 1) {
+      nshards = 1;
+   }
+
+   lists = new slist_t *[num ? num : 1];
+   if (!lists) {
+      return NULL;
+   }
+
+   args.eas = eas;
+   args.lists = lists;
+   args.options = options;
+
+   // the private signature lists of the shards are not used
+   shards = pshard_init(num, nshards, NULL, NULL);
+   for (i = 0; i < nshards; i++) {
+      shards[i].arg = &args;
+   }
+   pshard_run(shards, nshards, parse_fcts_shard, NULL);
+
+   for (i = 0; i < nshards; i++) {
+      delete shards[i].sl;
+   }
+   delete [] shards;
+
+   return lists;
+}
+
+/*------------------------------------------------*/
+/* function : parse_second_idb_start              */
+/* description: starts generating the list of     */
+/*              signatures of another idb in the  */
+/*              background                        */
 /*------------------------------------------------*/
 
-slist_t *parse_second_idb(char **file, options_t *opt) {
+sparse_t *parse_second_idb_start(char **file, options_t *opt) {
    char ext[10];
 
    qsnprintf(ext, sizeof(ext), ".%s", IDB_EXT);
@@ -152,7 +317,7 @@ slist_t *parse_second_idb(char **file, options_t *opt) {
       return NULL;
    }
 
-   return system_parse_idb(BADADDR, *file, opt);
+   return system_parse_idb_start(BADADDR, *file, opt);
 }
 
 /*------------------------------------------------*/
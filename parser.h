@@ -23,10 +23,21 @@
 
 #include "sig.h"
 #include "options.h"
+#include "system.h"
+#include "scache.h"
+#include "pshard.h"
 
-slist_t * parse_idb();
-slist_t * parse_second_idb(char **, options_t *);
+// state shared by the parse_fcts workers (pshard_t::arg)
+struct pfargs_t {
+   const ea_t *eas;           // functions of all the shards
+   slist_t **lists;           // block lists of all the shards
+   char options;
+};
+
+slist_t * parse_idb(options_t *, psink_t);
+sparse_t * parse_second_idb_start(char **, options_t *);
 slist_t * parse_fct(ea_t, char);
+slist_t ** parse_fcts(const ea_t *, size_t, char, options_t *);
 slist_t * parse_second_fct(ea_t, const char *, options_t *);
 
 #endif
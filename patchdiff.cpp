@@ -26,6 +26,9 @@
 #include "display.h"
 #include "options.h"
 #include "system.h"
+#include "sigfile.h"
+#include "gcache.h"
+#include "ncache.h"
 #include "actions.h"
 #include "plugin.h"
 
@@ -44,6 +47,7 @@ int get_proc_id() {
 
 void pd_plugmod_t::term(void) {
    unhook_from_notification_point(HT_UI, ui_callback);
+   unhook_from_notification_point(HT_IDB, idb_callback);
 
    if (d_engine) {
       if (d_opt->options_save_db()) {
@@ -53,6 +57,8 @@ void pd_plugmod_t::term(void) {
    }
 
    ipc_close();
+   gcache_clear();
+   ncache_clear();
    delete d_opt;
    d_opt = NULL;
 }
@@ -110,6 +116,9 @@ int pd_plugmod_t::init() {
       return 0;
    }
 
+   // keeps the graph and name caches in sync with the IDB
+   hook_to_notification_point(HT_IDB, idb_callback, NULL);
+
    return 1;
 }
 
@@ -117,6 +126,7 @@ void pd_plugmod_t::run_first_instance() {
    char *file;
    slist_t *sl1 = NULL;
    slist_t *sl2 = NULL;
+   sparse_t *sp2;
    int ret;
 
    msg ("\n---------------------------------------------------\n"
@@ -139,16 +149,32 @@ void pd_plugmod_t::run_first_instance() {
 
    msg("Scanning for functions ...\n");
 
+   // the second idb is parsed by another instance while this one parses
+   // the current idb
    msg("parsing second idb...\n");
-   sl2 = parse_second_idb(&file, d_opt);
-   if (!sl2) {
+   sp2 = parse_second_idb_start(&file, d_opt);
+   if (!sp2) {
       msg("Error: IDB2 parsing cancelled or failed.\n");
       hide_wait_box();
       return;
    }
 
    msg("parsing first idb...\n");
-   sl1 = parse_idb();
+   sl1 = parse_idb(d_opt, NULL);
+
+   msg("waiting for second idb...\n");
+   sl2 = system_parse_idb_finish(sp2);
+
+   if (!sl2) {
+      msg("Error: IDB2 parsing cancelled or failed.\n");
+      if (sl1) {
+         sl1->free_sigs();
+         delete sl1;
+      }
+      hide_wait_box();
+      return;
+   }
+
    if (!sl1) {
       msg("Error: IDB1 parsing failed.\n");
       sl2->free_sigs();
@@ -170,6 +196,49 @@ void pd_plugmod_t::run_first_instance() {
    delete sl2;
 }
 
+/*------------------------------------------------*/
+/* function : pd_plugmod_t::run_second_batch      */
+/* description: Streams the block lists of the    */
+/*              functions listed in file          */
+/*------------------------------------------------*/
+
+void pd_plugmod_t::run_second_batch(const char *file, unsigned char opt) {
+   qvector<ea_t> eas;
+   slist_t **lists;
+   uint64_t ea;
+   FILE *fp;
+   size_t i;
+   uint32_t j;
+
+   fp = qfopen(file, "rb");
+   if (!fp) {
+      return;
+   }
+   while (qfread(fp, &ea, sizeof(ea)) == sizeof(ea)) {
+      eas.push_back((ea_t)ea);
+   }
+   qfclose(fp);
+
+   lists = parse_fcts(eas.begin(), eas.size(), opt, d_opt);
+
+   // every function gets a separator, failures are empty lists
+   ipc_stream_begin(SFSTREAM_BATCH);
+   for (i = 0; i < eas.size(); i++) {
+      ipc_stream_fct(eas[i]);
+      if (!lists || !lists[i]) {
+         continue;
+      }
+      for (j = 0; j < lists[i]->num; j++) {
+         ipc_stream_sig(lists[i]->sigs[j]);
+      }
+      lists[i]->free_sigs();
+      delete lists[i];
+   }
+   ipc_stream_end();
+
+   delete [] lists;
+}
+
 void pd_plugmod_t::run_second_instance(const char * options) {
    slist_t * sl;
    char file[QMAXPATH];
@@ -177,7 +246,8 @@ void pd_plugmod_t::run_second_instance(const char * options) {
    unsigned char opt = 0;
    long id;
    unsigned int v;
-   bool cont;
+   bool cont, stream;
+   uint32_t i;
    char tmp[QMAXPATH*4];
 
    qsscanf(options, "%lu:%a:%u:%s", &id, &ea, &v, file);
@@ -194,19 +264,37 @@ void pd_plugmod_t::run_second_instance(const char * options) {
          } while(cont);
       }
    }
+   else if (file[0] == IPC_BATCH_PREFIX) {
+      run_second_batch(file + 1, opt);
+   }
    else {
+      stream = !strcmp(file, IPC_STREAM_FILE);
+      if (stream) {
+         // the idb list is sorted after being streamed, the fct one before
+         ipc_stream_begin(ea == BADADDR ? SFSTREAM_SORT : 0);
+      }
+
       if (ea == BADADDR) {
-         sl = parse_idb();
+         sl = parse_idb(d_opt, stream ? ipc_stream_sig : NULL);
       }
       else {
          sl = parse_fct(ea, opt);
+         for (i = 0; stream && sl && i < sl->num; i++) {
+            ipc_stream_sig(sl->sigs[i]);
+         }
+      }
+
+      if (stream) {
+         ipc_stream_end();
       }
 
       if (!sl) {
          return;
       }
 
-      sl->save(file);
+      if (!stream) {
+         sl->save(file);
+      }
 
       sl->free_sigs();
       delete sl;
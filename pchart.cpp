@@ -21,26 +21,35 @@
 #include "pchart.h"
 #include "patchdiff.h"
 #include "x86.h"
+#include "sig.h"
 
 using namespace std;
 
 extern cpu_t patchdiff_cpu;
 
 ea_t get_fake_jump(ea_t ea) {
+   unsigned char buf[X86_MAX_INSN];
+
    switch (patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      return x86_get_fake_jump(ea);
+      sig_read_bytes(ea, buf, sizeof(buf));
+      if (x86_is_fake_jump(buf, sizeof(buf))) {
+         return get_item_end(ea);
+      }
    default:
       return BADADDR;
    }
 }
 
 bool is_end_block(ea_t ea) {
+   unsigned char byte;
+
    switch (patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      return x86_is_end_block(ea);
+      byte = get_byte(ea);
+      return x86_is_end_block(&byte, 1);
    default:
       return false;
    }
@@ -49,6 +58,7 @@ bool is_end_block(ea_t ea) {
 ea_t get_direct_jump(ea_t ea) {
    xrefblk_t xb;
    cref_t cr;
+   unsigned char byte;
    flags_t f = getFlags(ea);
    bool b = xb.first_from(ea, XREF_FAR);
    if (!b) {
@@ -61,7 +71,8 @@ ea_t get_direct_jump(ea_t ea) {
    switch (patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      if (x86_is_direct_jump(ea)) {
+      byte = get_byte(ea);
+      if (x86_is_direct_jump(&byte, 1)) {
          return xb.to;
       }
    default:
@@ -76,6 +87,7 @@ bool pflow_chart_t::getJump(func_t *fct, qvector<ea_t> & list, pbasic_block_t &
    qvector<pedge_t> tmp;
    qvector<pedge_t>::iterator pos;
    ea_t tea, ea = bl.endEA, end, jaddr;
+   unsigned char buf[2];
    flags_t f;
    size_t k;
    int type = 0;
@@ -87,7 +99,8 @@ bool pflow_chart_t::getJump(func_t *fct, qvector<ea_t> & list, pbasic_block_t &
 
    b = xb.first_from(ea, XREF_ALL);
    f = getFlags(ea);
-   cond = x86_is_cond_jump_pos(ea);
+   sig_read_bytes(ea, buf, sizeof(buf));
+   cond = x86_is_cond_jump_pos(buf, sizeof(buf));
 
    while (b) {
       cr = (cref_t)xb.type;
@@ -0,0 +1,145 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// pdiff2-cli: diffs two signature files (as saved by the second IDA
+// instance) without IDA. Must be built with PDIFF_STANDALONE.
+
+#include "precomp.h"
+
+#include "sig.h"
+#include "diff.h"
+
+/*------------------------------------------------*/
+/* function : cli_print_sig                       */
+/* description: Prints one result line            */
+/*------------------------------------------------*/
+
+static void cli_print_sig(const char *type, sig_t *s1, sig_t *s2) {
+   if (s2) {
+      msg("%s\t%s\t%s\t%llx\t%llx\t%d\t%x\t%x\n", type,
+          s1->name.c_str(), s2->name.c_str(),
+          (unsigned long long)s1->startEA, (unsigned long long)s2->startEA,
+          s1->mtype, s1->crc_hash, s2->crc_hash);
+   }
+   else {
+      msg("%s\t%s\t%llx\t%x\t%x\t%x\n", type,
+          s1->name.c_str(), (unsigned long long)s1->startEA,
+          s1->sig, s1->hash, s1->crc_hash);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : cli_print_results                   */
+/* description: Prints the diff results           */
+/*------------------------------------------------*/
+
+static void cli_print_results(slist_t *l1, slist_t *l2) {
+   int un1, un2, idf, mf;
+   sig_t *sig;
+   uint32_t i;
+
+   un1 = un2 = idf = mf = 0;
+
+   for (i = 0; i < l1->num; i++) {
+      sig = l1->sigs[i];
+      if (sig->is_class()) {
+         continue;
+      }
+
+      if (sig->get_matched_type() == DIFF_UNMATCHED) {
+         cli_print_sig("unmatched1", sig, NULL);
+         un1++;
+      }
+      else if (sig->hash2 == sig->msig->hash2 || sig_equal(sig, sig->msig, DIFF_EQUAL_SIG_HASH)) {
+         cli_print_sig("identical", sig, sig->msig);
+         idf++;
+      }
+      else {
+         cli_print_sig("matched", sig, sig->msig);
+         mf++;
+      }
+   }
+
+   for (i = 0; i < l2->num; i++) {
+      sig = l2->sigs[i];
+      if (!sig->is_class() && sig->get_matched_type() == DIFF_UNMATCHED) {
+         cli_print_sig("unmatched2", sig, NULL);
+         un2++;
+      }
+   }
+
+   msg("Identical functions:   %d\n", idf);
+   msg("Matched functions:     %d\n", mf);
+   msg("Unmatched functions 1: %d\n", un1);
+   msg("Unmatched functions 2: %d\n", un2);
+}
+
+int main(int argc, char **argv) {
+   slist_t *sl1, *sl2;
+   deng_t *eng = NULL;
+   bool stats = false;
+   int nthreads = 1;
+   int ret = 1;
+
+   while (argc > 3) {
+      if (!strcmp(argv[1], "-v")) {
+         stats = true;
+      }
+      else if (!strcmp(argv[1], "-j") && argc > 4) {
+         nthreads = atoi(argv[2]);
+         argc--;
+         argv++;
+      }
+      else {
+         break;
+      }
+      argc--;
+      argv++;
+   }
+
+   if (argc != 3) {
+      fprintf(stderr, "usage: %s [-v] [-j threads] <file1.sig> <file2.sig>\n", argv[0]);
+      return 1;
+   }
+
+   sl1 = new slist_t(argv[1]);
+   sl2 = new slist_t(argv[2]);
+
+   if (!sl1->sigs || !sl2->sigs) {
+      fprintf(stderr, "Error: failed to load signature files.\n");
+   }
+   else if (generate_diff_mt(&eng, sl1, sl2, argv[2], NULL, nthreads) != 0 || !eng) {
+      fprintf(stderr, "Error: diff failed.\n");
+   }
+   else {
+      cli_print_results(sl1, sl2);
+      if (stats) {
+         eng->print_stats();
+      }
+      ret = 0;
+   }
+
+   delete eng;
+
+   sl1->free_sigs();
+   sl2->free_sigs();
+   delete sl1;
+   delete sl2;
+
+   return ret;
+}
@@ -65,6 +65,14 @@ struct pd_plugmod_t : public plugmod_t {
                                                                  this, NULL, NULL, -1);
 #endif
 
+   bdiff_action_handler_t bdiff_action_handler = bdiff_action_handler_t(this);
+#if IDA_SDK_VERSION < 750
+   const action_desc_t bdiff_action = ACTION_DESC_LITERAL(BDIFF_NAME, "Diff all blocks", &bdiff_action_handler, NULL, NULL, -1);
+#else
+   const action_desc_t bdiff_action = ACTION_DESC_LITERAL_PLUGMOD(BDIFF_NAME, "Diff all blocks", &bdiff_action_handler,
+                                                                  this, NULL, NULL, -1);
+#endif
+
    iunmatch_action_handler_t iunmatch_action_handler = iunmatch_action_handler_t(this);
 #if IDA_SDK_VERSION < 750
    const action_desc_t iunmatch_action = ACTION_DESC_LITERAL(IUNMATCH_NAME, "Unmatch", &iunmatch_action_handler, NULL, NULL, -1);
@@ -126,6 +134,7 @@ struct pd_plugmod_t : public plugmod_t {
    void run_first_instance();
 
    void run_second_instance(const char * options);
+   void run_second_batch(const char *file, unsigned char opt);
 
 };
 
@@ -0,0 +1,172 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "precomp.h"
+
+#include "pool.h"
+
+#define POOL_ALIGN 16
+
+/*------------------------------------------------*/
+/* function : pool_t::pool_t                      */
+/* description: Initializes an empty arena        */
+/*------------------------------------------------*/
+
+pool_t::pool_t() {
+   chunks = NULL;
+   cleanups = NULL;
+   pos = NULL;
+   left = 0;
+   nchunks = 0;
+   nalloc = 0;
+}
+
+/*------------------------------------------------*/
+/* function : pool_t::~pool_t                     */
+/* description: Releases all the arena chunks     */
+/*------------------------------------------------*/
+
+pool_t::~pool_t() {
+   pchunk_t *next;
+   pcleanup_t *cl;
+
+   for (cl = cleanups; cl; cl = cl->next) {
+      cl->fct(cl->data);
+   }
+
+   while (chunks) {
+      next = chunks->next;
+      free(chunks);
+      chunks = next;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : pool_t::alloc                       */
+/* description: Allocates size bytes from the     */
+/*              arena                             */
+/*------------------------------------------------*/
+
+void *pool_t::alloc(size_t size) {
+   pchunk_t *chunk;
+   size_t csize;
+   void *ptr;
+
+   size = (size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(lock);
+#endif
+
+   if (size > left) {
+      csize = qmax((size_t)POOL_CHUNK_SIZE, size + POOL_ALIGN);
+      chunk = (pchunk_t *)malloc(csize);
+      if (!chunk) {
+         return NULL;
+      }
+      chunk->next = chunks;
+      chunks = chunk;
+      nchunks++;
+
+      // the chunk header takes the first aligned slot
+      pos = (char *)chunk + POOL_ALIGN;
+      left = csize - POOL_ALIGN;
+   }
+
+   ptr = pos;
+   pos += size;
+   left -= size;
+   nalloc++;
+
+   return ptr;
+}
+
+/*------------------------------------------------*/
+/* function : pool_t::add_cleanup                 */
+/* description: Registers a callback to run when  */
+/*              the pool is released              */
+/*------------------------------------------------*/
+
+bool pool_t::add_cleanup(void (*fct)(void *), void *data) {
+   pcleanup_t *cl;
+
+   cl = (pcleanup_t *)alloc(sizeof(pcleanup_t));
+   if (!cl) {
+      return false;
+   }
+   cl->fct = fct;
+   cl->data = data;
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(lock);
+#endif
+
+   cl->next = cleanups;
+   cleanups = cl;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : fpool_t::fpool_t                    */
+/* description: Initializes a fixed size pool     */
+/*------------------------------------------------*/
+
+fpool_t::fpool_t(size_t size) {
+   esize = qmax(size, sizeof(void *));
+   free_list = NULL;
+}
+
+/*------------------------------------------------*/
+/* function : fpool_t::alloc                      */
+/* description: Gets an object from the pool      */
+/*------------------------------------------------*/
+
+void *fpool_t::alloc() {
+   void *ptr;
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(lock);
+#endif
+
+   if (free_list) {
+      ptr = free_list;
+      free_list = *(void **)ptr;
+      return ptr;
+   }
+
+   return arena.alloc(esize);
+}
+
+/*------------------------------------------------*/
+/* function : fpool_t::release                    */
+/* description: Gives an object back to the pool  */
+/*------------------------------------------------*/
+
+void fpool_t::release(void *ptr) {
+   if (!ptr) {
+      return;
+   }
+
+#ifdef PDIFF_THREADS
+   std::lock_guard<std::mutex> guard(lock);
+#endif
+
+   *(void **)ptr = free_list;
+   free_list = ptr;
+}
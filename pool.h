@@ -0,0 +1,85 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include "precomp.h"
+
+#ifdef PDIFF_THREADS
+#include <mutex>
+#endif
+
+#define POOL_CHUNK_SIZE (64 * 1024)
+
+struct pchunk_t {
+   pchunk_t *next;
+};
+
+// callback run when the pool is released
+struct pcleanup_t {
+   void (*fct)(void *);
+   void *data;
+   pcleanup_t *next;
+};
+
+// arena: objects are carved out of large chunks and are all released
+// together when the pool is deleted (no destructor is called, objects
+// owning external resources register a cleanup callback)
+struct pool_t {
+   pchunk_t *chunks;
+   pcleanup_t *cleanups;
+   char *pos;
+   size_t left;
+   size_t nchunks;
+   size_t nalloc;
+#ifdef PDIFF_THREADS
+   std::mutex lock;   // diff workers may register cleanups concurrently
+#endif
+
+   pool_t();
+   ~pool_t();
+
+   void *alloc(size_t);
+   bool add_cleanup(void (*)(void *), void *);
+};
+
+// fixed size object pool: freed objects are recycled through a free list,
+// chunks are never given back to the system
+struct fpool_t {
+   size_t esize;
+   void *free_list;
+   pool_t arena;
+#ifdef PDIFF_THREADS
+   std::mutex lock;
+#endif
+
+   fpool_t(size_t);
+
+   void *alloc();
+   void release(void *);
+};
+
+inline void *operator new(size_t size, pool_t *pool) {
+   return pool->alloc(size);
+}
+
+inline void operator delete(void *, pool_t *) {
+}
+
+#endif
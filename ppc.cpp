@@ -19,32 +19,71 @@
 #include "precomp.h"
 
 #include "ppc.h"
-#include "patchdiff.h"
 
-extern cpu_t patchdiff_cpu;
+/*------------------------------------------------*/
+/* function : ppc_byte                            */
+/* arguments: byte span, offset                   */
+/* description: Returns the byte at offset i of   */
+/*              the span (0xFF past its end)      */
+/*------------------------------------------------*/
+
+static unsigned char ppc_byte(const unsigned char *buf, size_t len, size_t i) {
+   return i < len ? buf[i] : 0xFF;
+}
+
+/*------------------------------------------------*/
+/* function : ppc_word                            */
+/* arguments: byte span, offset, byte order       */
+/* description: Returns the word at offset i of   */
+/*              the span                          */
+/*------------------------------------------------*/
+
+static unsigned short ppc_word(const unsigned char *buf, size_t len, size_t i, bool be) {
+   if (be) {
+      return (ppc_byte(buf, len, i) << 8) | ppc_byte(buf, len, i + 1);
+   }
+
+   return ppc_byte(buf, len, i) | (ppc_byte(buf, len, i + 1) << 8);
+}
+
+/*------------------------------------------------*/
+/* function : ppc_long                            */
+/* arguments: byte span, offset, byte order       */
+/* description: Returns the dword at offset i of  */
+/*              the span                          */
+/*------------------------------------------------*/
+
+static unsigned long ppc_long(const unsigned char *buf, size_t len, size_t i, bool be) {
+   if (be) {
+      return ((unsigned long)ppc_word(buf, len, i, be) << 16) | ppc_word(buf, len, i + 2, be);
+   }
+
+   return ppc_word(buf, len, i, be) | ((unsigned long)ppc_word(buf, len, i + 2, be) << 16);
+}
 
 /*------------------------------------------------*/
 /* function : ppc_is_nop                          */
-/* arguments: unsigned char _byte                 */
+/* arguments: unsigned char _byte, byte span,     */
+/*            byte order (true if big endian)     */
 /* description: detects if instruction is a nop   */
 /*              (mr rA, rA)                       */
 /*------------------------------------------------*/
 
-bool ppc_is_nop (unsigned char _byte, ea_t ea) {
+bool ppc_is_nop (unsigned char _byte, const unsigned char *buf, size_t len, bool be) {
    unsigned char s, a, b, rc;
    unsigned short v;
    unsigned long l;
 
-   _byte = get_byte(ea) >> 2;
+   _byte = ppc_byte(buf, len, 0) >> 2;
 
    // or rS, rA, rB
    if (_byte == 31) {
-      v = get_word(ea);
+      v = ppc_word(buf, len, 0, be);
       s = (v >> 5) & 0x1F;
       a = v & 0x1F;
 
       if (s == a) {
-         v = get_word(ea+2);
+         v = ppc_word(buf, len, 2, be);
 
          b = v >> 11;
          rc = v & 1;
@@ -57,7 +96,7 @@ bool ppc_is_nop (unsigned char _byte, ea_t ea) {
    }
    // nop: ori 0,0,0
    else if (_byte == 24) {
-      l = get_long(ea);
+      l = ppc_long(buf, len, 0, be);
       if (l == 0x60000000) {
          return true;
       }
@@ -68,13 +107,14 @@ bool ppc_is_nop (unsigned char _byte, ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : ppc_remove_instr                    */
-/* arguments: unsigned char byte, ea_t ea         */
+/* arguments: unsigned char byte, byte span,      */
+/*            byte order (true if big endian)     */
 /* description: Returns true is the instruction   */
 /*              must be ignored                   */
 /*------------------------------------------------*/
 
-bool ppc_remove_instr(unsigned char byte, ea_t ea) {
-   if (ppc_is_nop(byte, ea)) {
+bool ppc_remove_instr(unsigned char byte, const unsigned char *buf, size_t len, bool be) {
+   if (ppc_is_nop(byte, buf, len, be)) {
       return true;
    }
 
@@ -97,18 +137,19 @@ bool ppc_remove_instr(unsigned char byte, ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : ppc_get_byte                        */
-/* arguments: unsigned char _byte                 */
+/* arguments: byte span, byte order (true if big  */
+/*            endian)                             */
 /* description: Returns opcode                    */
 /*------------------------------------------------*/
 
-unsigned char ppc_get_byte(ea_t ea) {
+unsigned char ppc_get_byte(const unsigned char *buf, size_t len, bool be) {
    unsigned char byte;
    unsigned short v;
 
-   byte = get_byte(ea) >> 2;
+   byte = ppc_byte(buf, len, 0) >> 2;
 
    if (byte == 31) {
-      v = get_word(ea + 2);
+      v = ppc_word(buf, len, 2, be);
       v = (v >> 1) & 0xFF;
       if (v < 65) v += 65;
 
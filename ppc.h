@@ -21,7 +21,10 @@
 
 #include "precomp.h"
 
-unsigned char ppc_get_byte(ea_t);
-bool ppc_remove_instr(unsigned char, ea_t);
+// Instruction heuristics: pure functions of the instruction bytes, given as
+// a span starting at the instruction (bytes past its end read as 0xFF) and
+// the byte order of the words. Part of the standalone core.
+unsigned char ppc_get_byte(const unsigned char *, size_t, bool);
+bool ppc_remove_instr(unsigned char, const unsigned char *, size_t, bool);
 
 #endif
@@ -22,6 +22,15 @@
 #include <stdint.h>
 #include <stack>
 
+#ifdef PDIFF_STANDALONE
+
+// diffing core built outside of IDA (pdiff2-cli)
+#include "standalone.h"
+
+#define PDIFF_THREADS
+
+#else
+
 #define NO_OBSOLETE_FUNCS
 
 #include <ida.hpp>
@@ -55,6 +64,12 @@ extern plugin_t PLUGIN;
 
 static_assert(IDA_SDK_VERSION >= 650, "This plugin expects a minimum IDA SDK 6.5");
 
+#if IDA_SDK_VERSION >= 700
+#define PDIFF_THREADS
+#endif
+
+#endif
+
 #ifndef __PRECOMP_H
 #define __PRECOMP_H
 
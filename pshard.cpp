@@ -0,0 +1,129 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "precomp.h"
+
+#include "pshard.h"
+
+#ifdef PDIFF_THREADS
+#include <thread>
+#include <vector>
+#endif
+
+/*------------------------------------------------*/
+/* function : pshard_init                         */
+/* description: Splits num functions in nshards   */
+/*              contiguous shards                 */
+/*------------------------------------------------*/
+
+pshard_t *pshard_init(size_t num, size_t nshards, psink_t sink, const scache_t *sc) {
+   pshard_t *shards;
+   size_t i, step;
+
+   shards = new pshard_t[nshards];
+   step = (num + nshards - 1) / nshards;
+
+   for (i = 0; i < nshards; i++) {
+      shards[i].start = qmin(num, i * step);
+      shards[i].end = qmin(num, (i + 1) * step);
+      shards[i].sl = new slist_t(shards[i].end - shards[i].start, NULL);
+      shards[i].sink = sink;
+      shards[i].sc = sc;
+      shards[i].hits = shards[i].misses = 0;
+      shards[i].hit_time = shards[i].miss_time = 0;
+      shards[i].gen_time = shards[i].gen_lines = 0;
+      shards[i].arg = NULL;
+   }
+
+   return shards;
+}
+
+/*------------------------------------------------*/
+/* function : pshard_run                          */
+/* description: Runs the workers of the shards    */
+/* note: the sink is only called from the calling */
+/*       thread, in function order                */
+/*------------------------------------------------*/
+
+void pshard_run(pshard_t *shards, size_t nshards, pwork_t work, psink_t sink) {
+   size_t i;
+
+#ifdef PDIFF_THREADS
+   size_t j;
+
+   if (nshards > 1) {
+      std::vector<std::thread> workers;
+
+      for (i = 0; i < nshards; i++) {
+         shards[i].sink = NULL;
+         workers.push_back(std::thread(work, &shards[i]));
+      }
+      // shards are joined in order: their signatures are passed to the
+      // sink as soon as all the previous ones were
+      for (i = 0; i < nshards; i++) {
+         workers[i].join();
+         for (j = 0; sink && j < shards[i].sl->num; j++) {
+            sink(shards[i].sl->sigs[j]);
+         }
+      }
+      return;
+   }
+#endif
+
+   for (i = 0; i < nshards; i++) {
+      shards[i].sink = sink;
+      work(&shards[i]);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : pshard_merge                        */
+/* description: Merges the shards in all (its     */
+/*              list must have room for their     */
+/*              signatures) and frees their lists */
+/* note: shards are merged in function order so   */
+/*       that the resulting lists are identical   */
+/*       to a single threaded parsing             */
+/*------------------------------------------------*/
+
+void pshard_merge(pshard_t *shards, size_t nshards, pshard_t *all) {
+   size_t i, j;
+
+   all->hits = all->misses = 0;
+   all->hit_time = all->miss_time = 0;
+   all->gen_time = all->gen_lines = 0;
+
+   for (i = 0; i < nshards; i++) {
+      for (j = 0; j < shards[i].sl->num; j++) {
+         all->sl->add(shards[i].sl->sigs[j]);
+      }
+      for (j = 0; j < shards[i].class_l.size(); j++) {
+         all->class_l.add_unique(shards[i].class_l[j]);
+      }
+      for (j = 0; shards[i].sc && j < shards[i].fps.size(); j++) {
+         all->fps.push_back(shards[i].fps[j]);
+      }
+      all->hits += shards[i].hits;
+      all->misses += shards[i].misses;
+      all->hit_time += shards[i].hit_time;
+      all->miss_time += shards[i].miss_time;
+      all->gen_time += shards[i].gen_time;
+      all->gen_lines += shards[i].gen_lines;
+      delete shards[i].sl;
+      shards[i].sl = NULL;
+   }
+}
@@ -0,0 +1,61 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PSHARD_H__
+#define __PSHARD_H__
+
+#include "precomp.h"
+#include "sig.h"
+
+// Function shards of parse_idb: the functions are split in contiguous
+// ranges generated by separate workers, the shards are then merged in
+// function order so that the result does not depend on their number.
+// parse_fcts runs its workers on the same shards.
+// Does not use the IDA API (part of the standalone core).
+
+struct scache_t;
+
+// receives the signatures kept by parse_idb in function order, before the
+// list is sorted
+typedef void (*psink_t)(sig_t *);
+
+// per worker state used by parse_idb (and parse_fcts)
+struct pshard_t {
+   size_t start;              // first function index
+   size_t end;                // last function index (excluded)
+   slist_t *sl;               // private signature list
+   qvector<ea_t> class_l;     // private class list
+   psink_t sink;              // called as signatures are generated (or NULL)
+   const scache_t *sc;        // signature cache (or NULL)
+   qvector<uint64_t> fps;     // fingerprints of the signatures of sl
+   uint32_t hits;             // signature cache statistics
+   uint32_t misses;
+   uint64_t hit_time;
+   uint64_t miss_time;
+   uint64_t gen_time;         // time spent generating the uncached signatures
+   uint64_t gen_lines;        // and their number of instructions
+   void *arg;                 // state shared by the workers (or NULL)
+};
+
+// generates the signatures of the functions [start, end[ of a shard
+typedef void (*pwork_t)(pshard_t *);
+
+pshard_t *pshard_init(size_t, size_t, psink_t, const scache_t *);
+void pshard_run(pshard_t *, size_t, pwork_t, psink_t);
+void pshard_merge(pshard_t *, size_t, pshard_t *);
+
+#endif
@@ -0,0 +1,359 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "precomp.h"
+
+#include "scache.h"
+#include "sig.h"
+#include "patchdiff.h"
+
+extern cpu_t patchdiff_cpu;
+
+/*------------------------------------------------*/
+/* function : scache_get_path                     */
+/* description: Returns the cache file path of    */
+/*              the current idb                   */
+/*------------------------------------------------*/
+
+bool scache_get_path(char *path, size_t size) {
+   const char *idb;
+
+#if IDA_SDK_VERSION < 700
+   idb = database_idb;
+#else
+   idb = get_path(PATH_TYPE_IDB);
+#endif
+   if (!idb || !idb[0]) {
+      return false;
+   }
+
+   qsnprintf(path, size, "%s.%s", idb, SCACHE_EXT);
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : scache_fingerprint                  */
+/* description: Hashes the bytes and the chunk    */
+/*              bounds of a function, and the     */
+/*              data references of its code with  */
+/*              the strings they point to         */
+/* note: str_hash depends on these strings, they  */
+/*       lie outside of the function bytes        */
+/*------------------------------------------------*/
+
+uint64_t scache_fingerprint(func_t *fct) {
+   func_tail_iterator_t fti(fct);
+   uchar buf[4096];
+   uint64_t bounds[2], size = 0, dref;
+   uint32_t crc = 0;
+   ea_t ea, tea;
+   size_t n;
+   bool ok;
+
+   for (ok = fti.first(); ok; ok = fti.next()) {
+#if IDA_SDK_VERSION < 700
+      const area_t &r = fti.chunk();
+#else
+      const range_t &r = fti.chunk();
+#endif
+      bounds[0] = r.start_ea;
+      bounds[1] = r.end_ea;
+      crc = sigfile_crc32(crc, bounds, sizeof(bounds));
+
+      for (ea = r.start_ea; ea < r.end_ea; ea += n) {
+         n = (size_t)qmin((ea_t)sizeof(buf), r.end_ea - ea);
+         if (!sig_get_bytes(ea, buf, n)) {
+            memset(buf, 0, n);
+         }
+         crc = sigfile_crc32(crc, buf, n);
+      }
+
+      for (ea = r.start_ea; ea < r.end_ea && ea != BADADDR; ea = next_head(ea, r.end_ea)) {
+         if (!isCode(getFlags(ea))) {
+            continue;
+         }
+         tea = get_first_dref_from(ea);
+         if (tea == BADADDR) {
+            continue;
+         }
+         dref = tea;
+         crc = sigfile_crc32(crc, &dref, sizeof(dref));
+
+         memset(buf, 0, SIG_STR_MAX);
+         n = sig_get_str(tea, buf, SIG_STR_MAX);
+         crc = sigfile_crc32(crc, buf, n);
+      }
+      size += r.end_ea - r.start_ea;
+   }
+
+   return ((uint64_t)crc << 32) | (uint32_t)size;
+}
+
+/*------------------------------------------------*/
+/* function : scache_t::scache_t                  */
+/* description: Initializes an empty cache        */
+/*------------------------------------------------*/
+
+scache_t::scache_t() {
+   file[0] = '\0';
+   data = NULL;
+   recs = NULL;
+   edges = NULL;
+   num = 0;
+   hits = 0;
+   misses = 0;
+   hit_time = 0;
+   miss_time = 0;
+}
+
+/*------------------------------------------------*/
+/* function : scache_t::~scache_t                 */
+/* description: Frees the previous cache          */
+/*------------------------------------------------*/
+
+scache_t::~scache_t() {
+   delete [] data;
+}
+
+/*------------------------------------------------*/
+/* function : scache_t::open                      */
+/* description: Loads the previous cache of path  */
+/*              (an invalid or missing file gives */
+/*              an empty cache)                   */
+/*------------------------------------------------*/
+
+bool scache_t::open(const char *path) {
+   const scheader_t *hdr;
+   FILE *fp;
+   size_t size;
+   uint32_t i;
+
+   qstrncpy(file, path, sizeof(file));
+
+   // builds the crc table before the parsing threads use it
+   sigfile_crc32(0, NULL, 0);
+
+   fp = qfopen(path, "rb");
+   if (!fp) {
+      return false;
+   }
+   qfseek(fp, 0, SEEK_END);
+   size = (size_t)qftell(fp);
+   qfseek(fp, 0, SEEK_SET);
+
+   if (size < sizeof(scheader_t)) {
+      qfclose(fp);
+      return false;
+   }
+
+   data = new uchar[size];
+   if (!data || qfread(fp, data, size) != (ssize_t)size) {
+      qfclose(fp);
+      delete [] data;
+      data = NULL;
+      return false;
+   }
+   qfclose(fp);
+
+   hdr = (const scheader_t *)data;
+   if (memcmp(hdr->magic, SCACHE_MAGIC, sizeof(hdr->magic)) || hdr->version != SCACHE_VERSION
+       || hdr->hsize != sizeof(scheader_t) || hdr->rsize != sizeof(screcord_t)
+       || hdr->ea_size != sizeof(ea_t) || hdr->cpu != (uint32_t)patchdiff_cpu
+       || (uint64_t)hdr->num * sizeof(screcord_t) > size - sizeof(scheader_t)
+       || hdr->nedges != (size - sizeof(scheader_t) - (uint64_t)hdr->num * sizeof(screcord_t)) / sizeof(sfedge_t)
+       || sizeof(scheader_t) + hdr->num * sizeof(screcord_t) + hdr->nedges * sizeof(sfedge_t) != size
+       || sigfile_crc32(0, data + sizeof(scheader_t), size - sizeof(scheader_t)) != hdr->crc) {
+      msg("signature cache: ignoring %s (other version or corrupted)\n", path);
+      delete [] data;
+      data = NULL;
+      return false;
+   }
+
+   recs = (const screcord_t *)(data + sizeof(scheader_t));
+   edges = (const sfedge_t *)(recs + hdr->num);
+
+   for (i = 0; i < hdr->num; i++) {
+      if ((uint64_t)recs[i].sref_first + recs[i].sref_num > hdr->nedges
+          || (i && recs[i].start <= recs[i - 1].start)) {
+         msg("signature cache: ignoring %s (corrupted record %u)\n", path, i);
+         delete [] data;
+         data = NULL;
+         recs = NULL;
+         edges = NULL;
+         return false;
+      }
+   }
+   num = hdr->num;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : scache_t::find                      */
+/* description: Returns the record of a function  */
+/*              if its fingerprint did not change */
+/*------------------------------------------------*/
+
+const screcord_t *scache_t::find(ea_t start, uint64_t fp) const {
+   uint32_t lo = 0, hi = num, mid;
+
+   while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (recs[mid].start < (uint64_t)start) {
+         lo = mid + 1;
+      }
+      else {
+         hi = mid;
+      }
+   }
+
+   if (lo < num && recs[lo].start == (uint64_t)start && recs[lo].fp == fp) {
+      return &recs[lo];
+   }
+
+   return NULL;
+}
+
+/*------------------------------------------------*/
+/* function : scache_compare                      */
+/* description: Sorts the records by address      */
+/*------------------------------------------------*/
+
+static int OS_CDECL scache_compare(const void *arg1, const void *arg2) {
+   const screcord_t *r1 = (const screcord_t *)arg1;
+   const screcord_t *r2 = (const screcord_t *)arg2;
+
+   if (r1->start != r2->start) {
+      return r1->start < r2->start ? -1 : 1;
+   }
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : scache_t::save                      */
+/* description: Replaces the cache file with the  */
+/*              first n signatures of sl and      */
+/*              their fingerprints                */
+/*------------------------------------------------*/
+
+int scache_t::save(slist_t *sl, const uint64_t *fps, uint32_t n) {
+   scheader_t hdr;
+   screcord_t *nrecs;
+   sfedge_t *nedges;
+   fref_t *ref;
+   uint64_t total = 0;
+   uint32_t i, j;
+   sig_t *sig;
+   FILE *fp;
+   bool ok;
+
+   if (!file[0]) {
+      return -1;
+   }
+
+   for (i = 0; i < n; i++) {
+      total += sl->sigs[i]->srefs ? sl->sigs[i]->srefs->num : 0;
+   }
+
+   nrecs = new screcord_t[n ? n : 1];
+   nedges = new sfedge_t[total ? total : 1];
+   if (!nrecs || !nedges) {
+      delete [] nrecs;
+      delete [] nedges;
+      return -1;
+   }
+
+   total = 0;
+   for (i = 0; i < n; i++) {
+      sig = sl->sigs[i];
+
+      memset(&nrecs[i], 0, sizeof(nrecs[i]));
+      nrecs[i].start = sig->startEA;
+      nrecs[i].fp = fps[i];
+      nrecs[i].sig = sig->sig;
+      nrecs[i].hash = sig->hash;
+      nrecs[i].hash2 = sig->hash2;
+      nrecs[i].crc_hash = sig->crc_hash;
+      nrecs[i].str_hash = sig->str_hash;
+      nrecs[i].lines = sig->lines;
+      nrecs[i].sref_first = (uint32_t)total;
+
+      for (ref = sig->srefs ? sig->srefs->list : NULL, j = 0; ref; ref = ref->next, j++) {
+         memset(&nedges[total], 0, sizeof(nedges[total]));
+         nedges[total].ea = ref->ea;
+         nedges[total].type = ref->type;
+         total++;
+      }
+      nrecs[i].sref_num = j;
+   }
+
+   qsort(nrecs, n, sizeof(*nrecs), scache_compare);
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, SCACHE_MAGIC, sizeof(hdr.magic));
+   hdr.version = SCACHE_VERSION;
+   hdr.hsize = sizeof(scheader_t);
+   hdr.rsize = sizeof(screcord_t);
+   hdr.ea_size = sizeof(ea_t);
+   hdr.cpu = (uint32_t)patchdiff_cpu;
+   hdr.num = n;
+   hdr.nedges = total;
+   hdr.crc = sigfile_crc32(0, nrecs, n * sizeof(screcord_t));
+   hdr.crc = sigfile_crc32(hdr.crc, nedges, (size_t)total * sizeof(sfedge_t));
+
+   ok = false;
+   fp = qfopen(file, "wb");
+   if (fp) {
+      ok = qfwrite(fp, &hdr, sizeof(hdr)) == sizeof(hdr)
+           && qfwrite(fp, nrecs, n * sizeof(screcord_t)) == (ssize_t)(n * sizeof(screcord_t))
+           && qfwrite(fp, nedges, (size_t)total * sizeof(sfedge_t)) == (ssize_t)(total * sizeof(sfedge_t));
+      qfclose(fp);
+      if (!ok) {
+         qunlink(file);
+      }
+   }
+
+   delete [] nrecs;
+   delete [] nedges;
+
+   return ok ? 0 : -1;
+}
+
+/*------------------------------------------------*/
+/* function : scache_t::print_stats               */
+/* description: Prints the hit rate and the time  */
+/*              saved by the cache                */
+/*------------------------------------------------*/
+
+void scache_t::print_stats() {
+   uint64_t saved = 0;
+   uint32_t total = hits + misses;
+
+   if (!total) {
+      return;
+   }
+
+   // a hit would have cost the average time of a generated signature
+   if (misses && hits && miss_time / misses * hits > hit_time) {
+      saved = miss_time / misses * hits - hit_time;
+   }
+
+   msg("signature cache: %u/%u functions reused (%u%%), about %u ms saved\n",
+       hits, total, (uint32_t)((uint64_t)hits * 100 / total), (uint32_t)(saved / 1000000));
+}
@@ -0,0 +1,93 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SCACHE_H__
+#define __SCACHE_H__
+
+#include "precomp.h"
+#include "sigfile.h"
+
+// Signature cache file (<idb>.pd2c), version 2:
+//
+//    scheader_t
+//    screcord_t[num]      sorted by function start
+//    sfedge_t[nedges]     srefs of all the records (in list order)
+//
+// A record keeps the part of a function signature that sig_generate builds
+// from the function body, keyed by the function start and a fingerprint of
+// the function bytes, of the data references of its code and of the strings
+// they point to (str_hash). The name and the references to the function
+// depend on the rest of the idb: they are always regenerated. Other analysis
+// changes which keep the bytes (code undefined, code xrefs added by hand)
+// are not detected, the file has to be deleted.
+
+#define SCACHE_MAGIC   "PDSC"
+#define SCACHE_VERSION 2
+#define SCACHE_EXT     "pd2c"
+
+struct scheader_t {
+   char magic[4];
+   uint32_t version;
+   uint32_t hsize;      // sizeof(scheader_t)
+   uint32_t rsize;      // sizeof(screcord_t)
+   uint32_t ea_size;    // sizeof(ea_t) of the writer
+   uint32_t cpu;        // patchdiff_cpu of the writer
+   uint32_t num;        // number of records
+   uint32_t crc;        // crc32 of everything after the header
+   uint64_t nedges;
+};
+
+struct screcord_t {
+   uint64_t start;
+   uint64_t fp;         // scache_fingerprint
+   uint32_t sig;
+   uint32_t hash;
+   uint32_t hash2;
+   uint32_t crc_hash;
+   uint32_t str_hash;
+   uint32_t lines;
+   uint32_t sref_first; // index in the edge array
+   uint32_t sref_num;
+};
+
+struct scache_t {
+   char file[QMAXPATH];
+   uchar *data;         // previous cache (or NULL)
+   const screcord_t *recs;
+   const sfedge_t *edges;
+   uint32_t num;
+
+   // statistics of the last parsing
+   uint32_t hits;
+   uint32_t misses;
+   uint64_t hit_time;   // ns spent on the functions found in the cache
+   uint64_t miss_time;  // ns spent on the functions generated
+
+   scache_t();
+   ~scache_t();
+
+   bool open(const char *);
+   const screcord_t *find(ea_t, uint64_t) const;
+   int save(slist_t *, const uint64_t *, uint32_t);
+   void print_stats();
+};
+
+bool scache_get_path(char *, size_t);
+uint64_t scache_fingerprint(func_t *);
+
+#endif
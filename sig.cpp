@@ -24,15 +24,22 @@
 #include "patchdiff.h"
 #include "pchart.h"
 #include "os.h"
+#include "scache.h"
+#include "ncache.h"
 
 extern cpu_t patchdiff_cpu;
 
+// bytes read past the end of a block: the instruction heuristics may look
+// a few bytes after the last instruction
+#define SIG_BLOCK_PAD 16
+
 /*------------------------------------------------*/
-/* function : pget_func_name                      */
-/* description: Gets function name                */
+/* function : sig_func_name                       */
+/* description: Gets function name demangled with */
+/*              the given long/short options      */
 /*------------------------------------------------*/
 
-char *pget_func_name(ea_t ea, char * buffer, size_t blen) {
+static char *sig_func_name(ea_t ea, char * buffer, size_t blen, uint32 long_demnames, uint32 short_demnames) {
    char * pos;
 
 #if IDA_SDK_VERSION <= 670
@@ -41,12 +48,12 @@ char *pget_func_name(ea_t ea, char * buffer, size_t blen) {
       return NULL;
    }
    // make sure this is not a c++ class/struct badly defined as a function
-   demangle_name(tmp, blen, buffer, inf.long_demnames);
+   demangle_name(tmp, sizeof(tmp), buffer, long_demnames);
    if ( (strstr(tmp, "public: static") || strstr(tmp, "private: static")) &&
       (!strstr(tmp, "(") || strstr(tmp, "public: static long (__stdcall")) ) {
       return NULL;
    }
-   demangle_name(buffer, blen, buffer, inf.short_demnames);
+   demangle_name(buffer, blen, buffer, short_demnames);
 #else
    qstring name;
    qstring demangled;
@@ -55,22 +62,12 @@ char *pget_func_name(ea_t ea, char * buffer, size_t blen) {
       return NULL;
    }
    qstrncpy(buffer, name.c_str(), blen);
-#if IDA_SDK_VERSION < 730
-   uint32 long_demnames = inf.long_demnames;
-#else
-   uint32 long_demnames = inf_get_long_demnames();
-#endif
    dm_res = demangle_name2(&demangled, name.c_str(), long_demnames);
    if (dm_res >= 0) {
       if ( (demangled.find("public: static") != -1 || demangled.find("private: static") != -1) &&
          (demangled.find("(") == -1 || demangled.find("public: static long (__stdcall") == -1) ) {
           return NULL;
       }
-#if IDA_SDK_VERSION < 730
-      uint32 short_demnames = inf.short_demnames;
-#else
-      uint32 short_demnames = inf_get_short_demnames();
-#endif
       dm_res = demangle_name2(&demangled, name.c_str(), short_demnames);
       qstrncpy(buffer, demangled.c_str(), blen);
    }
@@ -85,270 +82,58 @@ char *pget_func_name(ea_t ea, char * buffer, size_t blen) {
 }
 
 /*------------------------------------------------*/
-/* function : sig_t::sig_t()                      */
-/* description: Allocates and initializes a new   */
-/*              function signature                */
-/*------------------------------------------------*/
-
-sig_t::sig_t() {
-   memset(this, 0, sizeof(sig_t));
-
-   mtype = DIFF_UNMATCHED;
-   msig = NULL;
-
-}
-
-/*------------------------------------------------*/
-/* function : frefs_free                          */
-/* description: Frees chained list                */
-/*------------------------------------------------*/
-
-void frefs_free(frefs_t *frefs) {
-   fref_t *fref;
-   fref_t *next;
-
-   fref = frefs->list;
-   while (fref) {
-      next = fref->next;
-      delete fref;
-      fref = next;
-   }
-
-   delete frefs;
-}
-
-/*------------------------------------------------*/
-/* function : ~dpsig_t                           */
-/* description: Frees chained list                */
-/*------------------------------------------------*/
-
-dpsig_t::~dpsig_t() {
-   if (next) {
-      delete next;
-   }
-}
-
-/*------------------------------------------------*/
-/* function : sig_t:~sig_t()                            */
-/* description: Frees signature                   */
-/*------------------------------------------------*/
-
-sig_t::~sig_t() {
-   if (dl.lines) {
-      delete [] dl.lines;
-   }
-
-   if (prefs) {
-      frefs_free(prefs);
-   }
-   if (srefs) {
-      frefs_free(srefs);
-   }
-   if (cp) {
-      delete cp;
-   }
-   if (cs) {
-      delete cs;
-   }
-}
-
-/*------------------------------------------------*/
-/* function : sig_set_name                        */
-/* description: Sets function signature name      */
-/*------------------------------------------------*/
-
-void sig_t::set_name(const char *_name) {
-   name = _name;
-}
-
-void sig_t::set_name(const qstring &_name) {
-   name = _name;
-}
-
-/*------------------------------------------------*/
-/* function : sig_set_start                       */
-/* description: Sets function start address       */
-/*------------------------------------------------*/
-
-void sig_t::set_start(ea_t ea) {
-   startEA = ea;
-}
-
-/*------------------------------------------------*/
-/* function : sig_get_start                       */
-/* description: Returns function start address    */
-/*------------------------------------------------*/
-
-ea_t sig_t::get_start() {
-   return startEA;
-}
-
-/*------------------------------------------------*/
-/* function : sig_get_preds                       */
-/* description: Returns signature pred xrefs      */
-/*------------------------------------------------*/
-
-frefs_t *sig_t::get_preds() {
-   return prefs;
-}
-
-/*------------------------------------------------*/
-/* function : sig_get_succs                       */
-/* description: Returns signature succ xrefs      */
-/*------------------------------------------------*/
-
-frefs_t *sig_t::get_succs() {
-   return srefs;
-}
-
-/*------------------------------------------------*/
-/* function : sig_get_crefs                       */
-/* description: Returns signature cxrefs          */
+/* function : pget_func_name                      */
+/* description: Gets function name                */
+/* note: names are kept in the name cache until   */
+/*       the function is renamed                  */
 /*------------------------------------------------*/
 
-clist_t *sig_t::get_crefs(int _type) {
-   if (_type == SIG_PRED) {
-      return cp;
-   }
-   if (_type == SIG_SUCC) {
-      return cs;
-   }
-   return NULL;
-}
+char *pget_func_name(ea_t ea, char * buffer, size_t blen) {
+   uint32 long_demnames, short_demnames;
+   uint64_t start;
+   char name[MAXSTR];
+   char *res;
 
-/*------------------------------------------------*/
-/* function : sig_set_crefs                       */
-/* description: Sets signature cxrefs             */
-/*------------------------------------------------*/
+#if IDA_SDK_VERSION < 730
+   long_demnames = inf.long_demnames;
+   short_demnames = inf.short_demnames;
+#else
+   long_demnames = inf_get_long_demnames();
+   short_demnames = inf_get_short_demnames();
+#endif
 
-void sig_t::set_crefs(int _type, clist_t *_cl) {
-   if (_type == SIG_PRED) {
-      cp = _cl;
-   }
-   else if (_type == SIG_SUCC) {
-      cs = _cl;
+   switch (ncache_get(ea, long_demnames, short_demnames, buffer, blen)) {
+   case 1:
+      return buffer;
+   case 0:
+      return NULL;
    }
-}
-
-/*------------------------------------------------*/
-/* function : sig_set_nfile                       */
-/* description: Sets file number                  */
-/*------------------------------------------------*/
-
-void sig_t::set_nfile(int _num) {
-   nfile = _num;
-}
-
-/*------------------------------------------------*/
-/* function : sig_set_matched_sig                 */
-/* description: Sets matched address              */
-/*------------------------------------------------*/
 
-void sig_t::set_matched_sig(sig_t *_sig2, int _type) {
-   msig = _sig2;
-   matchedEA = _sig2->startEA;
+   // the cached name must not depend on the caller buffer size
+   start = get_nsec_stamp();
+   res = sig_func_name(ea, name, sizeof(name), long_demnames, short_demnames);
+   ncache_add(ea, res, get_nsec_stamp() - start);
 
-   _sig2->msig = this;
-   _sig2->matchedEA = startEA;
-
-   mtype = _sig2->mtype = _type;
-
-   if (crc_hash != _sig2->crc_hash)
-      id_crc = _sig2->id_crc = 1;
-}
-
-/*------------------------------------------------*/
-/* function : sig_get_matched_sig                 */
-/* description: Returns matched address           */
-/*------------------------------------------------*/
-
-sig_t *sig_t::get_matched_sig() {
-   return msig;
-}
-
-/*------------------------------------------------*/
-/* function : sig_get_matched_type                */
-/* description: Returns matched type              */
-/*------------------------------------------------*/
-
-int sig_t::get_matched_type() {
-   return mtype;
-}
-
-/*------------------------------------------------*/
-/* function : sig_add_fref                        */
-/* description: Adds a function reference to the  */
-/*              signature                         */
-/*------------------------------------------------*/
-
-int sig_add_fref(frefs_t **frefs, ea_t ea, int type, char rtype) {
-   fref_t *ref;
-   fref_t *next;
-
-   if (!*frefs) {
-      *frefs = new frefs_t();
-      if (!*frefs) {
-         return -1;
-      }
-      memset(*frefs, 0, sizeof(**frefs));
-   }
-   else {
-      //don't add duplicates
-      next = (*frefs)->list;
-      while (next) {
-         if (next->ea == ea) {
-            return -1;
-         }
-         next = next->next;
-      }
-   }
-
-   ref = new fref_t();
-   if (!ref) {
-      return -1;
+   if (!res) {
+      return NULL;
    }
-   ref->ea = ea;
-   ref->type = type;
-   ref->rtype = rtype;
-   ref->next = (*frefs)->list;
 
-   (*frefs)->num++;
-   (*frefs)->list = ref;
+   qstrncpy(buffer, name, blen);
 
-   return 0;
-}
-
-/*------------------------------------------------*/
-/* function : sig_add_pref                        */
-/* description: Adds a function reference to the  */
-/*              signature                         */
-/*------------------------------------------------*/
-
-int sig_t::add_pref(ea_t _ea, int _type, char _rtype) {
-   return sig_add_fref(&prefs, _ea, _type, _rtype);
-}
-
-/*------------------------------------------------*/
-/* function : sig_add_sref                        */
-/* description: Adds a function reference to the  */
-/*              signature                         */
-/*------------------------------------------------*/
-
-int sig_t::add_sref(ea_t _ea, int _type, char _rtype) {
-   return sig_add_fref(&srefs, _ea, _type, _rtype);
+   return buffer;
 }
 
 /*------------------------------------------------*/
 /* function : is_fake_jump                        */
-/* description: Returns TRUE if the instruction at*/
-/*              ea is a jump                      */
+/* description: Returns TRUE if the instruction   */
+/*              is a jump                         */
 /*------------------------------------------------*/
 
-bool is_fake_jump(ea_t ea) {
+bool is_fake_jump(const sinsn_t *insn) {
    switch (patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      if (x86_get_fake_jump(ea) != BADADDR) {
+      if (x86_is_fake_jump(insn->bytes, insn->avail)) {
          return true;
       }
    default:
@@ -358,16 +143,16 @@ bool is_fake_jump(ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : ignore_jump                         */
-/* description: Returns TRUE if the instruction at*/
-/*              ea is a jump that must be ignored */
+/* description: Returns TRUE if the instruction   */
+/*              is a jump that must be ignored    */
 /*              in the signature                  */
 /*------------------------------------------------*/
 
-bool ignore_jump(ea_t ea) {
+bool ignore_jump(const sinsn_t *insn) {
    switch(patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      if (!x86_is_direct_jump(ea)) {
+      if (!x86_is_direct_jump(insn->bytes, insn->avail)) {
          return false;
       }
    default:
@@ -377,21 +162,21 @@ bool ignore_jump(ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : is_jump                             */
-/* description: Returns TRUE if the instruction at*/
-/*              ea is a jump                      */
+/* description: Returns TRUE if the instruction   */
+/*              is a jump                         */
 /*------------------------------------------------*/
 
-bool sig_t::is_jump(ea_t _ea, bool *_call, bool *_cj) {
+bool sig_t::is_jump(const sinsn_t *_insn, bool *_call, bool *_cj) {
    xrefblk_t _xb;
    cref_t _cr;
 
    *_call = false;
    *_cj = false;
 
-   if (_xb.first_from(_ea, XREF_FAR)) {
+   if (_xb.first_from(_insn->ea, XREF_FAR)) {
       _cr = (cref_t)_xb.type;
       if (_xb.iscode && (_cr == fl_JF || _cr == fl_JN)) {
-         if (ignore_jump(_ea)) {
+         if (ignore_jump(_insn)) {
             return true;
          }
          else {
@@ -407,24 +192,24 @@ bool sig_t::is_jump(ea_t _ea, bool *_call, bool *_cj) {
       }
    }
    else {
-      return is_fake_jump(_ea);
+      return is_fake_jump(_insn);
    }
    return false;
 }
 
 /*------------------------------------------------*/
 /* function : remove_instr                        */
-/* description: Returns TRUE if the instruction at*/
-/*              ea must not be added to the sig   */
+/* description: Returns TRUE if the instruction   */
+/*              must not be added to the sig      */
 /*------------------------------------------------*/
 
-bool remove_instr(unsigned char byte, ea_t ea) {
+bool remove_instr(unsigned char byte, const sinsn_t *insn) {
    switch (patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      return x86_remove_instr(byte, ea);
+      return x86_remove_instr(byte, insn->bytes, insn->avail, patchdiff_cpu == CPU_X8664);
    case CPU_PPC:
-      return ppc_remove_instr(byte, ea);
+      return ppc_remove_instr(byte, insn->bytes, insn->avail, insn->be);
    default:
       return false;
    }
@@ -432,24 +217,25 @@ bool remove_instr(unsigned char byte, ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : get_byte_with_optimization          */
-/* description: Returns byte at address ea        */
+/* description: Returns the opcode byte of the    */
+/*              instruction                       */
 /* note: Uses the processor optimized function if */
 /*       available                                */
 /*------------------------------------------------*/
 
-char get_byte_with_optimization(ea_t ea) {
+char get_byte_with_optimization(const sinsn_t *insn) {
    switch (patchdiff_cpu) {
    case CPU_X8632:
    case CPU_X8664:
-      return x86_get_byte(ea);
+      return x86_get_byte(insn->bytes, insn->avail, patchdiff_cpu == CPU_X8664);
    case CPU_PPC:
-      return ppc_get_byte(ea);
+      return ppc_get_byte(insn->bytes, insn->avail, insn->be);
    default: {
 #if IDA_SDK_VERSION >= 700
       insn_t cmd;
-      decode_insn(&cmd, ea);
+      decode_insn(&cmd, insn->ea);
 #else
-      decode_insn(ea);
+      decode_insn(insn->ea);
 #endif
       return (char)cmd.itype;
       }
@@ -585,82 +371,107 @@ int dline_add(dline_t *dl, ea_t ea, char options) {
 }
 #endif
 
+/*------------------------------------------------*/
+/* function : sig_get_str                         */
+/* description: Reads the string literal at ea,   */
+/*              returns its length (0 if ea is    */
+/*              not a string)                     */
+/* note: at most size bytes are read              */
+/*------------------------------------------------*/
+
+size_t sig_get_str(ea_t ea, unsigned char *buf, size_t size) {
+   flags_t f;
+   opinfo_t op_info;
+   size_t s;
+
+   f = getFlags(ea);
+   if (!isASCII(f)) {
+      return 0;
+   }
+
+#if IDA_SDK_VERSION < 700
+   get_opinfo(ea, 0, f, &op_info);
+#else
+   get_opinfo(&op_info, ea, 0, f);
+#endif
+   s = get_max_ascii_length(ea, op_info.strtype);
+#if IDA_SDK_VERSION < 700
+   if (!get_ascii_contents2(ea, s, op_info.strtype, (char *)buf, size) || s > size) {
+      s = size;
+   }
+#else
+   qstring strlit;
+   s = (size_t)get_strlit_contents(&strlit, ea, s, op_info.strtype);
+   if (s > size) {
+      s = size;
+   }
+   memset(buf, 0, s);
+   memcpy(buf, strlit.c_str(), qmin(s, strlit.length()));
+#endif
+
+   return s;
+}
+
 /*------------------------------------------------*/
 /* function : sig_add_address                     */
-/* description: Adds an address to the signature  */
+/* description: Adds an instruction to the        */
+/*              signature                         */
 /*------------------------------------------------*/
 
-int sig_t::add_address(short opcodes[256], ea_t _ea, bool _b, bool _line, char _options) {
+int sig_t::add_address(short opcodes[256], const sinsn_t *_insn, bool _line, char _options) {
    unsigned char _byte;
-   unsigned char _buf[200];
-   uint32_t _s, _i;
+   unsigned char _buf[SIG_STR_MAX];
+   const unsigned char *_bytes;
+   uint32_t _s, _i, _h;
    bool _call;
    bool _cj;
    ea_t _tea;
-   flags_t _f;
 
    if (_line) {
-      dline_add(&dl, _ea, _options);
+      dline_add(&dl, _insn->ea, _options);
    }
-   if (is_jump(_ea, &_call, &_cj)) {
+   if (is_jump(_insn, &_call, &_cj)) {
       return -1;
    }
-   _byte = get_byte_with_optimization(_ea);
+   _byte = get_byte_with_optimization(_insn);
 
-   if (remove_instr(_byte, _ea)) {
+   if (remove_instr(_byte, _insn)) {
       return -1;
    }
    lines++;
    opcodes[_byte]++;
 
-   if (!_b && !_call) {
+   if (!_insn->off && !_call) {
       if (_cj) {
-         _buf[0] = _byte;
+         _bytes = &_byte;
          _s = 1;
       }
       else {
-         _s = (uint32_t)get_item_size(_ea);
+         _bytes = _insn->bytes;
+         _s = qmin(_insn->size, _insn->avail);
          if (_s > sizeof(_buf)) {
             _s = sizeof(_buf);
          }
-         get_many_bytes(_ea, _buf, _s);
       }
 
+      _h = crc_hash;
       for (_i = 0; _i < _s; _i++) {
-         crc_hash += _buf[_i];
-         crc_hash += ( crc_hash << 10 );
-         crc_hash ^= ( crc_hash >> 6 );
+         _h += _bytes[_i];
+         _h += ( _h << 10 );
+         _h ^= ( _h >> 6 );
       }
+      crc_hash = _h;
    }
-   else if (_b) {
-      _tea = get_first_dref_from(_ea);
+   else if (_insn->off) {
+      _tea = _insn->dref;
       if (_tea != BADADDR) {
-         _f = getFlags(_tea);
-         if (isASCII(_f)) {
-            opinfo_t _op_info;
+         _s = (uint32_t)sig_get_str(_tea, _buf, SIG_STR_MAX);
+         for (_i = 0; _i < _s; _i++) {
 #if IDA_SDK_VERSION < 700
-            get_opinfo(_tea, 0, _f, &_op_info);
+            str_hash += _buf[_i] * _i;
 #else
-            get_opinfo(&_op_info, _tea, 0, _f);
-#endif
-            _s = get_max_ascii_length(_tea, _op_info.strtype);
-#if IDA_SDK_VERSION < 700
-            if (!get_ascii_contents2(_tea, _s, _op_info.strtype, _buf, sizeof(_buf))) {
-               _s = sizeof(_buf);
-            }
-            for (_i = 0; _i < _s; _i++) {
-               str_hash += _buf[_i] * _i;
-            }
-#else
-            qstring _strlit;
-            _s = get_strlit_contents(&_strlit, _tea, _s, _op_info.strtype);
             //the following attempts to match behavior of pre-7.0 patchdiff
-            if (_s > sizeof(_buf)) {
-               _s = sizeof(_buf);
-            }
-            for (_i = 0; _i < _s; _i++) {
-               str_hash += _strlit[_i] * _i;
-            }
+            str_hash += (char)_buf[_i] * _i;
 #endif
          }
       }
@@ -669,26 +480,115 @@ int sig_t::add_address(short opcodes[256], ea_t _ea, bool _b, bool _line, char _
    return 0;
 }
 
+/*------------------------------------------------*/
+/* function : sig_get_bytes                       */
+/* description: Reads size bytes at ea, fails if  */
+/*              one of them is missing            */
+/*------------------------------------------------*/
+
+bool sig_get_bytes(ea_t ea, unsigned char *buf, size_t size) {
+#if IDA_SDK_VERSION < 700
+   return get_many_bytes(ea, buf, size) != 0;
+#else
+   return get_many_bytes(ea, buf, size) == (ssize_t)size;
+#endif
+}
+
+/*------------------------------------------------*/
+/* function : sig_read_bytes                      */
+/* description: Reads size bytes at ea (missing   */
+/*              bytes are read as get_byte does)  */
+/*------------------------------------------------*/
+
+void sig_read_bytes(ea_t ea, unsigned char *buf, size_t size) {
+   size_t i = 0;
+
+   if (sig_get_bytes(ea, buf, size)) {
+      return;
+   }
+
+   // the padding may run past the end of the segment
+   if (size > SIG_BLOCK_PAD && sig_get_bytes(ea, buf, size - SIG_BLOCK_PAD)) {
+      i = size - SIG_BLOCK_PAD;
+   }
+
+   for (; i < size; i++) {
+      buf[i] = (unsigned char)get_byte(ea + i);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : sig_is_be                           */
+/* description: Returns true if the words of the  */
+/*              current IDB are big endian        */
+/*------------------------------------------------*/
+
+static bool sig_is_be() {
+#if IDA_SDK_VERSION < 700
+   return inf.mf != 0;
+#elif IDA_SDK_VERSION < 730
+   return inf.is_be();
+#else
+   return inf_is_be();
+#endif
+}
+
 /*------------------------------------------------*/
 /* function : sig_add_block                       */
 /* description: Adds a block to the signature     */
+/* note: the block bytes are read once, the       */
+/*       instructions are decoded from the buffer */
 /*------------------------------------------------*/
 
 int sig_t::add_block(short _opcodes[256], ea_t _startEA, ea_t _endEA, bool _line, char _options) {
-   ea_t _ea = _startEA;
-
-   while (_ea < _endEA) {
-      flags_t _flags = getFlags (_ea);
-      if (!isCode (_flags)) {
+   unsigned char _stack[1024];
+   unsigned char *_block;
+   size_t _size, _off;
+   sinsn_t _insn;
+   flags_t _flags;
+   int _ret = 0;
+
+   if (_endEA <= _startEA) {
+      return 0;
+   }
+
+   _size = (size_t)(_endEA - _startEA) + SIG_BLOCK_PAD;
+   _block = _stack;
+   if (_size > sizeof(_stack)) {
+      _block = new unsigned char[_size];
+      if (!_block) {
          return -1;
       }
-      bool _b = get_first_dref_from(_ea) != BADADDR ? true : false;
-      add_address(_opcodes, _ea, isOff(_flags, OPND_ALL) || _b, _line, _options);
+   }
+   sig_read_bytes(_startEA, _block, _size);
+
+   _insn.be = sig_is_be();
+   _insn.ea = _startEA;
+
+   while (_insn.ea < _endEA) {
+      _flags = getFlags(_insn.ea);
+      if (!isCode(_flags)) {
+         _ret = -1;
+         break;
+      }
 
-      _ea += get_item_size(_ea);
+      _off = (size_t)(_insn.ea - _startEA);
+      _insn.bytes = _block + _off;
+      _insn.avail = (uint32_t)(_size - _off);
+      _insn.size = (uint32_t)get_item_size(_insn.ea);
+      _insn.dref = get_first_dref_from(_insn.ea);
+      _insn.off = isOff(_flags, OPND_ALL) || _insn.dref != BADADDR;
+
+      add_address(_opcodes, &_insn, _line, _options);
+
+      _insn.ea += _insn.size;
    }
 
-   return 0;
+   if (_block != _stack) {
+      delete [] _block;
+   }
+
+   return _ret;
 }
 
 int OS_CDECL compare(const void *arg1, const void *arg2) {
@@ -770,19 +670,6 @@ ea_t parse_dref_list(ea_t _ea) {
    return _ea;
 }
 
-/*------------------------------------------------*/
-/* function : sig_is_class                        */
-/* description: Returns true is the signature is  */
-/*              a class                           */
-/*------------------------------------------------*/
-
-bool sig_t::is_class() {
-   if (sig == CLASS_SIG && hash == CLASS_SIG && crc_hash == CLASS_SIG) {
-      return true;
-   }
-   return false;
-}
-
 /*------------------------------------------------*/
 /* function : sig_class_generate                  */
 /* description: generates a signature for the     */
@@ -825,12 +712,13 @@ sig_t *sig_class_generate(ea_t ea) {
 /*              given function                    */
 /*------------------------------------------------*/
 
-sig_t *sig_generate(size_t fct_num, qvector<ea_t> &class_l) {
+sig_t *sig_generate(size_t fct_num, qvector<ea_t> &class_l, const screcord_t *rec, const sfedge_t *edges) {
    func_t *fct, *xfct;
    pflow_chart_t *fchart;
    sig_t *sig;
    ea_t fref, ea;
    int bnum, i;
+   uint32_t j;
    char buf[512];
    short opcodes[256];
    qvector<int> call_list;
@@ -839,10 +727,8 @@ sig_t *sig_generate(size_t fct_num, qvector<ea_t> &class_l) {
    fct = getn_func(fct_num);
 
    memset(opcodes, '\0', sizeof(opcodes));
-   fchart = new pflow_chart_t(fct);
    sig = new sig_t();
    if (!sig) {
-      delete fchart;
       return NULL;
    }
 
@@ -881,6 +767,23 @@ sig_t *sig_generate(size_t fct_num, qvector<ea_t> &class_l) {
       fref = get_next_dref_to(fct->startEA, fref);
    }
 
+   // Takes the body part from the signature cache (the function bytes did
+   // not change), srefs are added back in reverse to keep the list order
+   if (rec) {
+      sig->sig = rec->sig;
+      sig->hash = rec->hash;
+      sig->hash2 = rec->hash2;
+      sig->crc_hash = rec->crc_hash;
+      sig->str_hash = rec->str_hash;
+      sig->lines = rec->lines;
+      for (j = rec->sref_num; j > 0; j--) {
+         sig->add_sref((ea_t)edges[rec->sref_first + j - 1].ea, edges[rec->sref_first + j - 1].type, CHECK_REF);
+      }
+      return sig;
+   }
+
+   fchart = new pflow_chart_t(fct);
+
    // Adds each block to the signature
    bnum = fchart->nproper;
 
@@ -910,351 +813,3 @@ sig_t *sig_generate(size_t fct_num, qvector<ea_t> &class_l) {
 
    return sig;
 }
-
-/*------------------------------------------------*/
-/* function : sig_save                            */
-/* description: Saves signature refs to disk   */
-/*------------------------------------------------*/
-
-void sig_save_refs(FILE *fp, frefs_t *refs) {
-   uint32_t num, i;
-   fref_t *tmp;
-
-   if (refs) {
-      num = refs->num;
-      qfwrite(fp, &num, sizeof(num));
-      tmp = refs->list;
-      for (i = 0; i < num; i++) {
-         qfwrite(fp, &tmp->ea, sizeof(tmp->ea));
-         qfwrite(fp, &tmp->type, sizeof(tmp->type));
-         tmp = tmp->next;
-      }
-   }
-   else {
-      num = 0;
-      qfwrite(fp, &num, sizeof(num));
-   }
-}
-
-/*------------------------------------------------*/
-/* function : sig_t::save                         */
-/* description: Saves signature to disk           */
-/*------------------------------------------------*/
-
-int sig_t::save(FILE *_fp) {
-   uint32_t _len;
-
-   // saves function name
-   _len = name.length();
-   qfwrite(_fp, &_len, sizeof(_len));
-   qfwrite(_fp, name.c_str(), _len);
-
-   // saves function start address
-   qfwrite(_fp, &startEA, sizeof(startEA));
-
-   // saves function lines
-   qfwrite(_fp, &dl.num, sizeof(dl.num));
-   qfwrite(_fp, dl.lines, dl.num);
-
-   // saves sig/hash
-   qfwrite(_fp, &sig, sizeof(sig));
-   qfwrite(_fp, &hash, sizeof(hash));
-   qfwrite(_fp, &hash2, sizeof(hash2));
-   qfwrite(_fp, &crc_hash, sizeof(crc_hash));
-   qfwrite(_fp, &str_hash, sizeof(str_hash));
-
-   // saves function refs
-   sig_save_refs(_fp, prefs);
-   sig_save_refs(_fp, srefs);
-
-   return 0;
-}
-
-/*------------------------------------------------*/
-/* function : sig_load_prefs                      */
-/* description: Loads signature  refs from disk   */
-/*------------------------------------------------*/
-
-void sig_t::load_prefs(FILE *_fp, int _type) {
-   uint32_t _num, _i;
-   pedge_t *_eatab;
-
-   // loads function refs in reverse order
-   qfread(_fp, &_num, sizeof(_num));
-   _eatab = new pedge_t[_num];
-
-   for (_i = 0; _i < _num; _i++) {
-      qfread(_fp, &_eatab[_i].ea, sizeof(_eatab[_i].ea));
-      qfread(_fp, &_eatab[_i].type, sizeof(_eatab[_i].type));
-   }
-
-   for (_i = _num; _i > 0; _i--) {
-      if (_type == SIG_PRED) {
-         add_pref(_eatab[_i - 1].ea, _eatab[_i - 1].type, CHECK_REF);
-      }
-      else {
-         add_sref(_eatab[_i - 1].ea, _eatab[_i - 1].type, CHECK_REF);
-      }
-   }
-
-   delete [] _eatab;
-}
-
-/*------------------------------------------------*/
-/* function : sig_load                            */
-/* description: Loads signature from disk         */
-/*------------------------------------------------*/
-
-sig_t *sig_load(FILE *fp) {
-   uint32_t len;
-   sig_t * sig;
-   char buf[512];
-
-   sig = new sig_t();
-   if (!sig) {
-      return NULL;
-   }
-   // loads function name
-   qfread(fp, &len, sizeof(len));
-   qfread(fp, buf, len);
-   buf[len] = '\0';
-
-   sig->set_name(buf);
-
-   // loads function start address
-   qfread(fp, &sig->startEA, sizeof(sig->startEA));
-
-   // loads function line
-   qfread(fp, &sig->dl.num, sizeof(sig->dl.num));
-   sig->dl.lines = new char[sig->dl.num + 1];
-   if (sig->dl.lines) {
-      qfread(fp, sig->dl.lines, sig->dl.num);
-      sig->dl.lines[sig->dl.num] = '\0';
-   }
-   else {
-      sig->dl.num = 0;
-   }
-
-   // loads sig/hash
-   qfread(fp, &sig->sig, sizeof(sig->sig));
-   qfread(fp, &sig->hash, sizeof(sig->hash));
-   qfread(fp, &sig->hash2, sizeof(sig->hash2));
-   qfread(fp, &sig->crc_hash, sizeof(sig->crc_hash));
-   qfread(fp, &sig->str_hash, sizeof(sig->str_hash));
-
-   // loads sig refs
-   sig->load_prefs(fp, SIG_PRED);
-   sig->load_prefs(fp, SIG_SUCC);
-
-   return sig;
-}
-
-/*------------------------------------------------*/
-/* function : slist_t()                           */
-/* description: Initializes a new signature list  */
-/*------------------------------------------------*/
-
-bool slist_t::init(uint32_t initial_num, const char *file) {
-   this->file = file;
-   num = 0;
-   org_num = initial_num;
-   sigs = new sig_t *[initial_num];
-
-   if (!sigs && org_num != 0) {
-      return false;
-   }
-   return true;
-}
-
-slist_t::slist_t(uint32_t num, const char *file) {
-   init(num, file);
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::realloc                     */
-/* description: Realloc a signature list          */
-/*------------------------------------------------*/
-
-bool slist_t::realloc(uint32_t new_num) {
-   sig_t **new_sigs = new sig_t *[org_num + new_num];
-   if (!new_sigs) {
-      return false;
-   }
-   if (sigs) {
-      memcpy(new_sigs, sigs, org_num * sizeof(sig_t*));
-      delete sigs;
-   }
-   org_num += new_num;
-   sigs = new_sigs;
-
-   return true;
-}
-
-/*------------------------------------------------*/
-/* function : sig_compare                         */
-/* description: Compares two signature            */
-/*------------------------------------------------*/
-
-int OS_CDECL sig_compare(const void *arg1, const void *arg2) {
-   unsigned long v1, v2;
-
-   v1 = (*(sig_t **)arg1)->sig;
-   v2 = (*(sig_t **)arg2)->sig;
-
-   if (v2 > v1) {
-      return 1;
-   }
-   if (v2 < v1) {
-      return -1;
-   }
-   v1 = (*(sig_t **)arg1)->hash;
-   v2 = (*(sig_t **)arg2)->hash;
-
-   if (v2 > v1) {
-      return 1;
-   }
-   if (v2 < v1) {
-      return -1;
-   }
-   v1 = (*(sig_t **)arg1)->crc_hash;
-   v2 = (*(sig_t **)arg2)->crc_hash;
-
-   if (v2 > v1) {
-      return 1;
-   }
-   if (v2 < v1) {
-      return -1;
-   }
-   v1 = (*(sig_t **)arg1)->str_hash;
-   v2 = (*(sig_t **)arg2)->str_hash;
-
-   if (v2 > v1) {
-      return 1;
-   }
-   if (v2 < v1) {
-      return -1;
-   }
-   return 0;
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::sort                        */
-/* description: Sorts the signature to the list   */
-/*------------------------------------------------*/
-
-void slist_t::sort() {
-   qsort(sigs, num, sizeof(*sigs), sig_compare);
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::add                         */
-/* description: Adds a new signature to the list  */
-/*------------------------------------------------*/
-
-void slist_t::add(sig_t *sig) {
-   if (num >= org_num) {
-      if (!realloc(32)) {
-         return;
-      }
-   }
-
-   sig->node = num;
-   sigs[num++] = sig;
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::remove                      */
-/* description: Removes a new signature to the    */
-/*              list                              */
-/*------------------------------------------------*/
-
-void slist_t::remove(uint32_t n) {
-   if ( (n+1) < num ) {
-      memmove(&sigs[n], &sigs[n+1], ((num - 1) - n) * sizeof(*(sigs)));
-   }
-   num--;
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::~slist_t                   */
-/* description: Frees a new signature list        */
-/*------------------------------------------------*/
-
-slist_t::~slist_t() {
-   delete [] sigs;
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::free_sigs                  */
-/* description: Frees a new signature list        */
-/*------------------------------------------------*/
-
-void slist_t::free_sigs() {
-   for (uint32_t i = 0; i < num; i++) {
-      delete sigs[i];
-   }
-}
-
-/*------------------------------------------------*/
-/* function : slist_t::save                        */
-/* description: Saves signature list to disk      */
-/*------------------------------------------------*/
-
-int slist_t::save(const char *filename) {
-   FILE * fp;
-   uint32_t i;
-
-   fp = qfopen(filename, "wb+");
-   if (fp == NULL) {
-      return -1;
-   }
-   qfwrite(fp, &num, sizeof(num));
-
-   for (i = 0; i < num; i++) {
-      sigs[i]->save(fp);
-   }
-   qfclose(fp);
-
-   return 0;
-}
-
-/*------------------------------------------------*/
-/* function : slist_t()                           */
-/* description: Loads signature list from disk    */
-/*------------------------------------------------*/
-
-slist_t::slist_t(const char *filename) {
-   uint32_t init_num;
-
-   num = 0;
-   org_num = 0;
-   file = NULL;
-   dclk = false;
-   gv = NULL;
-   unique = false;
-   msl = NULL;
-   sigs = NULL;
-
-   FILE *fp = qfopen(filename, "rb");
-   if (fp == NULL) {
-      msg("slist_t::load: qfopen('%s', 'rb') failed\n", filename);
-   }
-   if (qfread(fp, &init_num, sizeof(init_num)) != sizeof(init_num)) {
-      msg("slist_t::load: qfread(...) failed\n");
-      qfclose(fp);
-      return;
-   }
-
-   if (init(init_num, NULL)) {
-
-      for (uint32_t i = 0; i < init_num; i++) {
-         add(sig_load(fp));
-      }
-
-      sort();
-   }
-
-   qfclose(fp);
-
-}
-
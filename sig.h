@@ -32,6 +32,11 @@
 #define CHECK_REF 0
 #define DO_NOT_CHECK_REF 1
 
+// string bytes hashed in str_hash
+#define SIG_STR_MAX 200
+
+#define SLIST_NOID 0xFFFFFFFF
+
 #ifdef _WINDOWS
 #define OS_CDECL __cdecl
 #else
@@ -42,14 +47,20 @@ struct sig_t;
 struct slist_t;
 struct hpsig_t;
 struct frefs_t;
+struct pool_t;
+struct clist_t;
+struct cindex_t;
+struct screcord_t;
+struct sfedge_t;
 
 struct dpsig_t {
    sig_t *sig;
    bool removed;
    dpsig_t *prev;
    dpsig_t *next;
-
-   ~dpsig_t();
+   clist_t *cl;      // owner list
+   dpsig_t *snext;   // next element of the same signature (sig->nodes)
+   uint32_t ord;     // position in the list when its str index was built
 };
 
 struct clist_t {
@@ -59,22 +70,38 @@ struct clist_t {
 
    uint32_t nmatch; // number of matched element
    dpsig_t *msigs;  // matched list
+   dpsig_t *mpend;  // matched elements not merged in msigs yet (newest first)
+   uint32_t npend;  // number of elements in mpend
 
-   clist_t(slist_t *);
-   clist_t(hpsig_t *, frefs_t *);
+   pool_t *pool;    // diff session pool owning the elements (or NULL)
+
+   uint32_t nstale; // elements in sigs whose signature is already matched
+   cindex_t *idx;   // get_eq_sig lookup tables (built on demand)
+   bool cref_mark;  // set by update_crefs on the lists it visits
+   bool shared;     // used by several diff workers (nstale is recounted)
+
+   clist_t(slist_t *, pool_t *);
+   clist_t(hpsig_t *, frefs_t *, pool_t *);
 
    ~clist_t();
 
+   dpsig_t *new_dsig(sig_t *);
+   dpsig_t *index_first(sig_t *, int);
+   dpsig_t *index_last(sig_t *, int);
+   bool index_str_unique(dpsig_t *, dpsig_t *);
+
    int insert_dsig(dpsig_t *ds);
    int insert(sig_t *);
    void remove(dpsig_t *);
    void reset();
+   void merge_matched();
 
-   bool equal_match(const clist_t &rhs);
-   bool almost_equal_match(const clist_t &rhs);
+   bool equal_match(clist_t &rhs);
+   bool almost_equal_match(clist_t &rhs);
    dpsig_t *get_unique_sig(dpsig_t **ds, int type);
    dpsig_t *get_best_sig(int type);
    dpsig_t *get_eq_sig(dpsig_t *dsig, int type);
+   dpsig_t *get_indexed_sig(dpsig_t *dsig, int type, dpsig_t **done);
    void update_crefs(dpsig_t *ds, int type);
    void update_and_remove(dpsig_t *ds);
 };
@@ -84,6 +111,10 @@ struct fref_t {
    int type;
    char rtype;
    struct fref_t *next;
+
+   // allocated from a shared fixed size pool
+   static void *operator new(size_t);
+   static void operator delete(void *);
 };
 
 struct frefs_t {
@@ -97,6 +128,17 @@ struct dline_t {
    char *lines;
 };
 
+// instruction of a block decoded by sig_t::add_block
+struct sinsn_t {
+   ea_t ea;
+   const unsigned char *bytes;   // instruction bytes, read with the block
+   uint32_t size;                // item size
+   uint32_t avail;               // bytes readable from bytes
+   ea_t dref;                    // first data reference (or BADADDR)
+   bool off;                     // an operand is an offset or a data reference
+   bool be;                      // big endian words
+};
+
 struct sig_t {
    qstring name;
    ea_t startEA;
@@ -119,6 +161,7 @@ struct sig_t {
    clist_t *cp;
    clist_t *cs;
    dline_t dl;
+   dpsig_t *nodes;   // clist elements of the current diff session
 
    sig_t();
    ~sig_t();
@@ -137,7 +180,7 @@ struct sig_t {
    int add_sref(ea_t, int, char);
    clist_t *get_crefs(int);
    void set_crefs(int, clist_t *);
-   int add_address(short opcodes[256], ea_t ea, bool b, bool line, char options);
+   int add_address(short opcodes[256], const sinsn_t *insn, bool line, char options);
    int add_block(short *, ea_t, ea_t, bool, char);
    void set_start(ea_t);
    void set_name(const char *);
@@ -145,7 +188,13 @@ struct sig_t {
    int calc_sighash(short *, int);
    bool is_class();
    void load_prefs(FILE *fp, int type);
-   bool is_jump(ea_t ea, bool *call, bool *cj);
+   bool is_jump(const sinsn_t *insn, bool *call, bool *cj);
+};
+
+// source of the entries of a list loaded on demand (see backup.h)
+struct slazy_t {
+   sig_t *(*load)(slazy_t *, uint32_t);
+   void (*release)(slazy_t *);
 };
 
 struct slist_t {
@@ -157,18 +206,28 @@ struct slist_t {
    bool unique;
    slist_t *msl;
    sig_t **sigs;
+   uint32_t holes;   // removed entries (NULL) not packed yet
+   slazy_t *lazy;    // entries are loaded by get() (or NULL)
+   uint32_t *ids;    // lazy lists: entry of each slot (SLIST_NOID if removed)
 
    slist_t(const char *file);
    slist_t(uint32_t num, const char *file);
    ~slist_t();
 
    bool init(uint32_t num, const char *file);
+   bool load_map(const uchar *, size_t);
+   bool load_legacy(const char *);
 
    void free_sigs();
    int save(const char *);
    bool realloc(uint32_t);
    void add(sig_t *);
    void remove(uint32_t);
+   uint32_t move(slist_t *, const uint32_t *, uint32_t);
+   void pack();
+   void set_lazy(slazy_t *, uint32_t);
+   sig_t *get(uint32_t);
+   void load_all();
    void sort();
    uint32_t getnum() {return num;};
 };
@@ -176,8 +235,11 @@ struct slist_t {
 int OS_CDECL sig_compare(const void *, const void *);
 
 char *pget_func_name(ea_t, char *, size_t);
+bool sig_get_bytes(ea_t, unsigned char *, size_t);
+void sig_read_bytes(ea_t, unsigned char *, size_t);
+size_t sig_get_str(ea_t, unsigned char *, size_t);
 
 sig_t *sig_class_generate(ea_t);
-sig_t *sig_generate(size_t, qvector<ea_t> &);
+sig_t *sig_generate(size_t, qvector<ea_t> &, const screcord_t *, const sfedge_t *);
 
 #endif
@@ -0,0 +1,133 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SIGFILE_H__
+#define __SIGFILE_H__
+
+#include "precomp.h"
+#include "sig.h"
+
+// Signature exchange file (.sig) layout, version 1:
+//
+//    sfheader_t
+//    sfrecord_t[num]      one fixed size record per signature
+//    sfedge_t[nedges]     preds/succs of all the records
+//    char[str_size]       names and disassembly lines (not terminated)
+//
+// All the sections are 8 bytes aligned so that the file can be mapped and
+// read in place. Files starting with a signature count instead of the magic
+// are the previous unversioned format.
+
+#define SIGFILE_MAGIC   "PDSG"
+#define SIGFILE_VERSION 1
+
+struct sfheader_t {
+   char magic[4];
+   uint32_t version;
+   uint32_t hsize;      // sizeof(sfheader_t)
+   uint32_t rsize;      // sizeof(sfrecord_t)
+   uint32_t ea_size;    // sizeof(ea_t) of the writer
+   uint32_t num;        // number of records
+   uint64_t nedges;
+   uint64_t rec_off;    // section offsets from the start of the file
+   uint64_t edge_off;
+   uint64_t str_off;
+   uint64_t str_size;
+   uint32_t crc;        // crc32 of everything after the header
+   uint32_t reserved;
+};
+
+struct sfrecord_t {
+   uint64_t start;
+   uint64_t name_off;   // offsets in the string table
+   uint64_t lines_off;
+   uint32_t name_len;
+   uint32_t lines_len;
+   uint32_t sig;
+   uint32_t hash;
+   uint32_t hash2;
+   uint32_t crc_hash;
+   uint32_t str_hash;
+   uint32_t pref_first; // indexes in the edge array
+   uint32_t pref_num;
+   uint32_t sref_first;
+   uint32_t sref_num;
+   uint32_t reserved;
+};
+
+struct sfedge_t {
+   uint64_t ea;
+   int32_t type;
+   uint32_t reserved;
+};
+
+// Signature stream (second instance -> first instance over IPC):
+//
+//    sfshdr_t
+//    for each signature, in generation order:
+//       uint32_t size      size of the rest of the entry
+//       sfrecord_t         edge and string offsets relative to this entry
+//       sfedge_t[pref_num + sref_num]
+//       char[name_len + lines_len]
+//
+// Entries are not aligned and may span several IPC messages.
+//
+// Batch streams (SFSTREAM_BATCH) carry several function lists: each one
+// starts with a separator entry whose size is 8, followed by the uint64_t
+// address of the function.
+
+#define SFSTREAM_MAGIC   "PDSS"
+#define SFSTREAM_VERSION 1
+
+#define SFSTREAM_SORT    1   // the sender sorted its list before saving it
+#define SFSTREAM_BATCH   2   // one list per function (see above)
+
+struct sfshdr_t {
+   char magic[4];
+   uint32_t version;
+   uint32_t ea_size;
+   uint32_t flags;
+};
+
+// incremental decoder of a signature stream
+struct sfstream_t {
+   uchar *buf;          // bytes not decoded yet
+   size_t len;
+   size_t size;
+   uint32_t flags;
+   bool hdr;            // stream header was read
+   bool error;
+   slist_t *sl;
+   slist_t **lists;     // batch streams: completed lists
+   ea_t *lists_ea;
+   uint32_t nlists;
+   ea_t ea;             // batch streams: function of sl
+
+   sfstream_t();
+   ~sfstream_t();
+
+   bool feed(const void *, size_t);
+   bool next_list(ea_t);
+   slist_t *finish();
+   slist_t **finish_batch(ea_t **, uint32_t *);
+};
+
+uint32_t sigfile_crc32(uint32_t, const void *, size_t);
+uchar *sigfile_pack(sig_t *, uint32_t *);
+
+#endif
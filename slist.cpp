@@ -0,0 +1,1471 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "precomp.h"
+
+#include "sig.h"
+#include "pool.h"
+#include "sigfile.h"
+
+#ifndef PDIFF_STANDALONE
+#include "os.h"
+#endif
+
+static fpool_t fref_pool(sizeof(fref_t));
+
+/*------------------------------------------------*/
+/* function : fref_t::operator new/delete         */
+/* description: fref_t are recycled through a     */
+/*              shared pool instead of the heap   */
+/*------------------------------------------------*/
+
+void *fref_t::operator new(size_t) {
+   return fref_pool.alloc();
+}
+
+void fref_t::operator delete(void *ptr) {
+   fref_pool.release(ptr);
+}
+
+/*------------------------------------------------*/
+/* function : sig_t::sig_t()                      */
+/* description: Allocates and initializes a new   */
+/*              function signature                */
+/*------------------------------------------------*/
+
+sig_t::sig_t() {
+   memset(this, 0, sizeof(sig_t));
+
+   mtype = DIFF_UNMATCHED;
+   msig = NULL;
+
+}
+
+/*------------------------------------------------*/
+/* function : frefs_free                          */
+/* description: Frees chained list                */
+/*------------------------------------------------*/
+
+void frefs_free(frefs_t *frefs) {
+   fref_t *fref;
+   fref_t *next;
+
+   fref = frefs->list;
+   while (fref) {
+      next = fref->next;
+      delete fref;
+      fref = next;
+   }
+
+   delete frefs;
+}
+
+/*------------------------------------------------*/
+/* function : sig_t:~sig_t()                            */
+/* description: Frees signature                   */
+/*------------------------------------------------*/
+
+sig_t::~sig_t() {
+   if (dl.lines) {
+      delete [] dl.lines;
+   }
+
+   if (prefs) {
+      frefs_free(prefs);
+   }
+   if (srefs) {
+      frefs_free(srefs);
+   }
+   // cp/cs belong to the diff session pool (deng_t)
+}
+
+/*------------------------------------------------*/
+/* function : sig_set_name                        */
+/* description: Sets function signature name      */
+/*------------------------------------------------*/
+
+void sig_t::set_name(const char *_name) {
+   name = _name;
+}
+
+void sig_t::set_name(const qstring &_name) {
+   name = _name;
+}
+
+/*------------------------------------------------*/
+/* function : sig_set_start                       */
+/* description: Sets function start address       */
+/*------------------------------------------------*/
+
+void sig_t::set_start(ea_t ea) {
+   startEA = ea;
+}
+
+/*------------------------------------------------*/
+/* function : sig_get_start                       */
+/* description: Returns function start address    */
+/*------------------------------------------------*/
+
+ea_t sig_t::get_start() {
+   return startEA;
+}
+
+/*------------------------------------------------*/
+/* function : sig_get_preds                       */
+/* description: Returns signature pred xrefs      */
+/*------------------------------------------------*/
+
+frefs_t *sig_t::get_preds() {
+   return prefs;
+}
+
+/*------------------------------------------------*/
+/* function : sig_get_succs                       */
+/* description: Returns signature succ xrefs      */
+/*------------------------------------------------*/
+
+frefs_t *sig_t::get_succs() {
+   return srefs;
+}
+
+/*------------------------------------------------*/
+/* function : sig_get_crefs                       */
+/* description: Returns signature cxrefs          */
+/*------------------------------------------------*/
+
+clist_t *sig_t::get_crefs(int _type) {
+   if (_type == SIG_PRED) {
+      return cp;
+   }
+   if (_type == SIG_SUCC) {
+      return cs;
+   }
+   return NULL;
+}
+
+/*------------------------------------------------*/
+/* function : sig_set_crefs                       */
+/* description: Sets signature cxrefs             */
+/*------------------------------------------------*/
+
+void sig_t::set_crefs(int _type, clist_t *_cl) {
+   if (_type == SIG_PRED) {
+      cp = _cl;
+   }
+   else if (_type == SIG_SUCC) {
+      cs = _cl;
+   }
+}
+
+/*------------------------------------------------*/
+/* function : sig_set_nfile                       */
+/* description: Sets file number                  */
+/*------------------------------------------------*/
+
+void sig_t::set_nfile(int _num) {
+   nfile = _num;
+}
+
+/*------------------------------------------------*/
+/* function : sig_set_matched_sig                 */
+/* description: Sets matched address              */
+/*------------------------------------------------*/
+
+void sig_t::set_matched_sig(sig_t *_sig2, int _type) {
+   msig = _sig2;
+   matchedEA = _sig2->startEA;
+
+   _sig2->msig = this;
+   _sig2->matchedEA = startEA;
+
+   mtype = _sig2->mtype = _type;
+
+   if (crc_hash != _sig2->crc_hash)
+      id_crc = _sig2->id_crc = 1;
+}
+
+/*------------------------------------------------*/
+/* function : sig_get_matched_sig                 */
+/* description: Returns matched address           */
+/*------------------------------------------------*/
+
+sig_t *sig_t::get_matched_sig() {
+   return msig;
+}
+
+/*------------------------------------------------*/
+/* function : sig_get_matched_type                */
+/* description: Returns matched type              */
+/*------------------------------------------------*/
+
+int sig_t::get_matched_type() {
+   return mtype;
+}
+
+/*------------------------------------------------*/
+/* function : sig_add_fref                        */
+/* description: Adds a function reference to the  */
+/*              signature                         */
+/*------------------------------------------------*/
+
+int sig_add_fref(frefs_t **frefs, ea_t ea, int type, char rtype) {
+   fref_t *ref;
+   fref_t *next;
+
+   if (!*frefs) {
+      *frefs = new frefs_t();
+      if (!*frefs) {
+         return -1;
+      }
+      memset(*frefs, 0, sizeof(**frefs));
+   }
+   else {
+      //don't add duplicates
+      next = (*frefs)->list;
+      while (next) {
+         if (next->ea == ea) {
+            return -1;
+         }
+         next = next->next;
+      }
+   }
+
+   ref = new fref_t();
+   if (!ref) {
+      return -1;
+   }
+   ref->ea = ea;
+   ref->type = type;
+   ref->rtype = rtype;
+   ref->next = (*frefs)->list;
+
+   (*frefs)->num++;
+   (*frefs)->list = ref;
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : sig_add_pref                        */
+/* description: Adds a function reference to the  */
+/*              signature                         */
+/*------------------------------------------------*/
+
+int sig_t::add_pref(ea_t _ea, int _type, char _rtype) {
+   return sig_add_fref(&prefs, _ea, _type, _rtype);
+}
+
+/*------------------------------------------------*/
+/* function : sig_add_sref                        */
+/* description: Adds a function reference to the  */
+/*              signature                         */
+/*------------------------------------------------*/
+
+int sig_t::add_sref(ea_t _ea, int _type, char _rtype) {
+   return sig_add_fref(&srefs, _ea, _type, _rtype);
+}
+
+/*------------------------------------------------*/
+/* function : sig_is_class                        */
+/* description: Returns true is the signature is  */
+/*              a class                           */
+/*------------------------------------------------*/
+
+bool sig_t::is_class() {
+   if (sig == CLASS_SIG && hash == CLASS_SIG && crc_hash == CLASS_SIG) {
+      return true;
+   }
+   return false;
+}
+
+
+/*------------------------------------------------*/
+/* function : sig_save                            */
+/* description: Saves signature refs to disk   */
+/*------------------------------------------------*/
+
+void sig_save_refs(FILE *fp, frefs_t *refs) {
+   uint32_t num, i;
+   fref_t *tmp;
+
+   if (refs) {
+      num = refs->num;
+      qfwrite(fp, &num, sizeof(num));
+      tmp = refs->list;
+      for (i = 0; i < num; i++) {
+         qfwrite(fp, &tmp->ea, sizeof(tmp->ea));
+         qfwrite(fp, &tmp->type, sizeof(tmp->type));
+         tmp = tmp->next;
+      }
+   }
+   else {
+      num = 0;
+      qfwrite(fp, &num, sizeof(num));
+   }
+}
+
+/*------------------------------------------------*/
+/* function : sig_t::save                         */
+/* description: Saves signature to disk           */
+/*------------------------------------------------*/
+
+int sig_t::save(FILE *_fp) {
+   uint32_t _len;
+
+   // saves function name
+   _len = name.length();
+   qfwrite(_fp, &_len, sizeof(_len));
+   qfwrite(_fp, name.c_str(), _len);
+
+   // saves function start address
+   qfwrite(_fp, &startEA, sizeof(startEA));
+
+   // saves function lines
+   qfwrite(_fp, &dl.num, sizeof(dl.num));
+   qfwrite(_fp, dl.lines, dl.num);
+
+   // saves sig/hash
+   qfwrite(_fp, &sig, sizeof(sig));
+   qfwrite(_fp, &hash, sizeof(hash));
+   qfwrite(_fp, &hash2, sizeof(hash2));
+   qfwrite(_fp, &crc_hash, sizeof(crc_hash));
+   qfwrite(_fp, &str_hash, sizeof(str_hash));
+
+   // saves function refs
+   sig_save_refs(_fp, prefs);
+   sig_save_refs(_fp, srefs);
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : sig_load_prefs                      */
+/* description: Loads signature  refs from disk   */
+/*------------------------------------------------*/
+
+void sig_t::load_prefs(FILE *_fp, int _type) {
+   uint32_t _num, _i;
+   fref_t *_eatab;
+
+   // loads function refs in reverse order
+   qfread(_fp, &_num, sizeof(_num));
+   _eatab = new fref_t[_num];
+
+   for (_i = 0; _i < _num; _i++) {
+      qfread(_fp, &_eatab[_i].ea, sizeof(_eatab[_i].ea));
+      qfread(_fp, &_eatab[_i].type, sizeof(_eatab[_i].type));
+   }
+
+   for (_i = _num; _i > 0; _i--) {
+      if (_type == SIG_PRED) {
+         add_pref(_eatab[_i - 1].ea, _eatab[_i - 1].type, CHECK_REF);
+      }
+      else {
+         add_sref(_eatab[_i - 1].ea, _eatab[_i - 1].type, CHECK_REF);
+      }
+   }
+
+   delete [] _eatab;
+}
+
+/*------------------------------------------------*/
+/* function : sig_load                            */
+/* description: Loads signature from disk         */
+/*------------------------------------------------*/
+
+sig_t *sig_load(FILE *fp) {
+   uint32_t len;
+   sig_t * sig;
+   char buf[512];
+   char *name;
+
+   sig = new sig_t();
+   if (!sig) {
+      return NULL;
+   }
+   // loads function name
+   qfread(fp, &len, sizeof(len));
+   name = len < sizeof(buf) ? buf : new char[len + 1];
+   qfread(fp, name, len);
+   name[len] = '\0';
+
+   sig->set_name(name);
+   if (name != buf) {
+      delete [] name;
+   }
+
+   // loads function start address
+   qfread(fp, &sig->startEA, sizeof(sig->startEA));
+
+   // loads function line
+   qfread(fp, &sig->dl.num, sizeof(sig->dl.num));
+   sig->dl.lines = new char[sig->dl.num + 1];
+   if (sig->dl.lines) {
+      qfread(fp, sig->dl.lines, sig->dl.num);
+      sig->dl.lines[sig->dl.num] = '\0';
+   }
+   else {
+      sig->dl.num = 0;
+   }
+
+   // loads sig/hash
+   qfread(fp, &sig->sig, sizeof(sig->sig));
+   qfread(fp, &sig->hash, sizeof(sig->hash));
+   qfread(fp, &sig->hash2, sizeof(sig->hash2));
+   qfread(fp, &sig->crc_hash, sizeof(sig->crc_hash));
+   qfread(fp, &sig->str_hash, sizeof(sig->str_hash));
+
+   // loads sig refs
+   sig->load_prefs(fp, SIG_PRED);
+   sig->load_prefs(fp, SIG_SUCC);
+
+   return sig;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t()                           */
+/* description: Initializes a new signature list  */
+/*------------------------------------------------*/
+
+bool slist_t::init(uint32_t initial_num, const char *file) {
+   this->file = file;
+   num = 0;
+   org_num = initial_num;
+   holes = 0;
+   lazy = NULL;
+   ids = NULL;
+   sigs = new sig_t *[initial_num];
+
+   if (!sigs && org_num != 0) {
+      return false;
+   }
+   return true;
+}
+
+slist_t::slist_t(uint32_t num, const char *file) {
+   init(num, file);
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::realloc                     */
+/* description: Realloc a signature list          */
+/*------------------------------------------------*/
+
+bool slist_t::realloc(uint32_t new_num) {
+   uint32_t *new_ids;
+
+   sig_t **new_sigs = new sig_t *[org_num + new_num];
+   if (!new_sigs) {
+      return false;
+   }
+   if (sigs) {
+      memcpy(new_sigs, sigs, org_num * sizeof(sig_t*));
+      delete [] sigs;
+   }
+   if (ids) {
+      new_ids = new uint32_t[org_num + new_num];
+      memcpy(new_ids, ids, org_num * sizeof(uint32_t));
+      delete [] ids;
+      ids = new_ids;
+   }
+   org_num += new_num;
+   sigs = new_sigs;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : sig_compare                         */
+/* description: Compares two signature            */
+/*------------------------------------------------*/
+
+int OS_CDECL sig_compare(const void *arg1, const void *arg2) {
+   unsigned long v1, v2;
+
+   v1 = (*(sig_t **)arg1)->sig;
+   v2 = (*(sig_t **)arg2)->sig;
+
+   if (v2 > v1) {
+      return 1;
+   }
+   if (v2 < v1) {
+      return -1;
+   }
+   v1 = (*(sig_t **)arg1)->hash;
+   v2 = (*(sig_t **)arg2)->hash;
+
+   if (v2 > v1) {
+      return 1;
+   }
+   if (v2 < v1) {
+      return -1;
+   }
+   v1 = (*(sig_t **)arg1)->crc_hash;
+   v2 = (*(sig_t **)arg2)->crc_hash;
+
+   if (v2 > v1) {
+      return 1;
+   }
+   if (v2 < v1) {
+      return -1;
+   }
+   v1 = (*(sig_t **)arg1)->str_hash;
+   v2 = (*(sig_t **)arg2)->str_hash;
+
+   if (v2 > v1) {
+      return 1;
+   }
+   if (v2 < v1) {
+      return -1;
+   }
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::sort                        */
+/* description: Sorts the signature to the list   */
+/*------------------------------------------------*/
+
+void slist_t::sort() {
+   qsort(sigs, num, sizeof(*sigs), sig_compare);
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::add                         */
+/* description: Adds a new signature to the list  */
+/*------------------------------------------------*/
+
+void slist_t::add(sig_t *sig) {
+   // grows geometrically: result lists are filled one entry at a time
+   if (num >= org_num) {
+      if (!realloc(qmax(org_num, (uint32_t)32))) {
+         return;
+      }
+   }
+
+   sig->node = num;
+   if (ids) {
+      ids[num] = SLIST_NOID;
+   }
+   sigs[num++] = sig;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::remove                      */
+/* description: Removes a signature from the list */
+/* note: the slot is only cleared so that the     */
+/*       indexes of the other entries do not      */
+/*       change until the list is packed          */
+/*------------------------------------------------*/
+
+void slist_t::remove(uint32_t n) {
+   if (n >= num || (!sigs[n] && (!ids || ids[n] == SLIST_NOID))) {
+      return;
+   }
+   sigs[n] = NULL;
+   if (ids) {
+      ids[n] = SLIST_NOID;
+   }
+   holes++;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::move                        */
+/* description: Moves the entries idx[0..n-1] to  */
+/*              the end of dst                    */
+/* note: the indexes are the ones before the move */
+/*       (the list is not packed)                 */
+/*------------------------------------------------*/
+
+uint32_t slist_t::move(slist_t *dst, const uint32_t *idx, uint32_t n) {
+   uint32_t i, moved;
+
+   if (dst->num + n > dst->org_num && !dst->realloc(qmax(n, dst->org_num))) {
+      return 0;
+   }
+
+   moved = 0;
+   for (i = 0; i < n; i++) {
+      if (idx[i] >= num || !get(idx[i])) {
+         continue;
+      }
+      dst->add(sigs[idx[i]]);
+      remove(idx[i]);
+      moved++;
+   }
+
+   return moved;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::pack                        */
+/* description: Drops the removed entries         */
+/*------------------------------------------------*/
+
+void slist_t::pack() {
+   uint32_t i, j;
+
+   if (!holes) {
+      return;
+   }
+
+   for (i = j = 0; i < num; i++) {
+      if (sigs[i]) {
+         sigs[i]->node = j;
+      }
+      else if (!ids || ids[i] == SLIST_NOID) {
+         continue;
+      }
+      if (ids) {
+         ids[j] = ids[i];
+      }
+      sigs[j++] = sigs[i];
+   }
+   num = j;
+   holes = 0;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::set_lazy                    */
+/* description: Makes the list hold num entries   */
+/*              loaded on demand from lz          */
+/*------------------------------------------------*/
+
+void slist_t::set_lazy(slazy_t *lz, uint32_t n) {
+   uint32_t i;
+
+   if (n > org_num) {
+      realloc(n - org_num);
+   }
+
+   ids = new uint32_t[org_num];
+   for (i = 0; i < n; i++) {
+      sigs[i] = NULL;
+      ids[i] = i;
+   }
+   num = n;
+   lazy = lz;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::get                         */
+/* description: Returns entry n, loading it if    */
+/*              needed (NULL if removed)          */
+/*------------------------------------------------*/
+
+sig_t *slist_t::get(uint32_t n) {
+   if (!sigs[n] && lazy && ids[n] != SLIST_NOID) {
+      sigs[n] = lazy->load(lazy, ids[n]);
+      if (sigs[n]) {
+         sigs[n]->node = n;
+      }
+      else {
+         // unreadable entries are dropped on the next pack
+         ids[n] = SLIST_NOID;
+         holes++;
+      }
+   }
+
+   return sigs[n];
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::load_all                    */
+/* description: Loads every entry of a lazy list  */
+/*              and drops the source              */
+/* note: needed before walking the whole list     */
+/*------------------------------------------------*/
+
+void slist_t::load_all() {
+   uint32_t i;
+
+   if (!lazy) {
+      return;
+   }
+
+   for (i = 0; i < num; i++) {
+      get(i);
+   }
+   pack();
+
+   lazy->release(lazy);
+   lazy = NULL;
+   delete [] ids;
+   ids = NULL;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::~slist_t                   */
+/* description: Frees a new signature list        */
+/*------------------------------------------------*/
+
+slist_t::~slist_t() {
+   if (lazy) {
+      lazy->release(lazy);
+   }
+   delete [] ids;
+   delete [] sigs;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::free_sigs                  */
+/* description: Frees a new signature list        */
+/*------------------------------------------------*/
+
+void slist_t::free_sigs() {
+   for (uint32_t i = 0; i < num; i++) {
+      delete sigs[i];
+   }
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_crc32                       */
+/* description: Updates a CRC-32 (IEEE) checksum  */
+/*------------------------------------------------*/
+
+uint32_t sigfile_crc32(uint32_t crc, const void *data, size_t len) {
+   static uint32_t table[256];
+   static bool init = false;
+   const uchar *ptr = (const uchar *)data;
+   uint32_t c;
+   int i, k;
+
+   if (!init) {
+      for (i = 0; i < 256; i++) {
+         c = (uint32_t)i;
+         for (k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+         }
+         table[i] = c;
+      }
+      init = true;
+   }
+
+   crc = ~crc;
+   while (len--) {
+      crc = table[(crc ^ *ptr++) & 0xFF] ^ (crc >> 8);
+   }
+
+   return ~crc;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_write                       */
+/* description: Writes a block and updates the    */
+/*              file checksum                     */
+/*------------------------------------------------*/
+
+static bool sigfile_write(FILE *fp, const void *data, size_t len, uint32_t *crc) {
+   if (len == 0) {
+      return true;
+   }
+   *crc = sigfile_crc32(*crc, data, len);
+
+   return qfwrite(fp, data, len) == (ssize_t)len;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_write_refs                  */
+/* description: Writes the edges of a ref list    */
+/*------------------------------------------------*/
+
+static bool sigfile_write_refs(FILE *fp, frefs_t *refs, uint32_t *crc) {
+   sfedge_t edge;
+   fref_t *tmp;
+
+   memset(&edge, 0, sizeof(edge));
+
+   for (tmp = refs ? refs->list : NULL; tmp; tmp = tmp->next) {
+      edge.ea = tmp->ea;
+      edge.type = tmp->type;
+      if (!sigfile_write(fp, &edge, sizeof(edge), crc)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_make_record                 */
+/* description: Fills the record of a signature   */
+/*              whose edges and strings start at  */
+/*              the given offsets                 */
+/*------------------------------------------------*/
+
+static void sigfile_make_record(sig_t *sig, sfrecord_t *rec, uint64_t edges, uint64_t strs) {
+   memset(rec, 0, sizeof(*rec));
+
+   rec->start = sig->startEA;
+   rec->name_off = strs;
+   rec->name_len = (uint32_t)sig->name.length();
+   rec->lines_off = strs + rec->name_len;
+   rec->lines_len = sig->dl.num;
+   rec->sig = sig->sig;
+   rec->hash = sig->hash;
+   rec->hash2 = sig->hash2;
+   rec->crc_hash = sig->crc_hash;
+   rec->str_hash = sig->str_hash;
+   rec->pref_first = (uint32_t)edges;
+   rec->pref_num = sig->prefs ? sig->prefs->num : 0;
+   rec->sref_first = rec->pref_first + rec->pref_num;
+   rec->sref_num = sig->srefs ? sig->srefs->num : 0;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::save                        */
+/* description: Saves signature list to disk      */
+/*              (versioned format, see sigfile.h) */
+/*------------------------------------------------*/
+
+int slist_t::save(const char *filename) {
+   FILE * fp;
+   sfheader_t hdr;
+   sfrecord_t rec;
+   uint64_t edges, strs;
+   uint32_t i, crc;
+   sig_t *sig;
+   bool ok;
+
+   fp = qfopen(filename, "wb+");
+   if (fp == NULL) {
+      return -1;
+   }
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, SIGFILE_MAGIC, sizeof(hdr.magic));
+   hdr.version = SIGFILE_VERSION;
+   hdr.hsize = sizeof(sfheader_t);
+   hdr.rsize = sizeof(sfrecord_t);
+   hdr.ea_size = sizeof(ea_t);
+   hdr.num = num;
+
+   for (i = 0; i < num; i++) {
+      sig = sigs[i];
+      hdr.nedges += (sig->prefs ? sig->prefs->num : 0) + (sig->srefs ? sig->srefs->num : 0);
+      hdr.str_size += sig->name.length() + sig->dl.num;
+   }
+
+   hdr.rec_off = sizeof(sfheader_t);
+   hdr.edge_off = hdr.rec_off + (uint64_t)num * sizeof(sfrecord_t);
+   hdr.str_off = hdr.edge_off + hdr.nedges * sizeof(sfedge_t);
+
+   // the checksum is not known yet
+   ok = qfwrite(fp, &hdr, sizeof(hdr)) == sizeof(hdr);
+
+   crc = 0;
+   edges = 0;
+   strs = 0;
+
+   for (i = 0; ok && i < num; i++) {
+      sig = sigs[i];
+
+      sigfile_make_record(sig, &rec, edges, strs);
+
+      edges += rec.pref_num + rec.sref_num;
+      strs += rec.name_len + rec.lines_len;
+
+      ok = sigfile_write(fp, &rec, sizeof(rec), &crc);
+   }
+
+   for (i = 0; ok && i < num; i++) {
+      ok = sigfile_write_refs(fp, sigs[i]->prefs, &crc) && sigfile_write_refs(fp, sigs[i]->srefs, &crc);
+   }
+
+   for (i = 0; ok && i < num; i++) {
+      sig = sigs[i];
+      ok = sigfile_write(fp, sig->name.c_str(), sig->name.length(), &crc) && sigfile_write(fp, sig->dl.lines, sig->dl.num, &crc);
+   }
+
+   if (ok) {
+      hdr.crc = crc;
+      ok = qfseek(fp, 0, SEEK_SET) == 0 && qfwrite(fp, &hdr, sizeof(hdr)) == sizeof(hdr);
+   }
+   qfclose(fp);
+
+   return ok ? 0 : -1;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_load_refs                   */
+/* description: Builds a ref list from the edge   */
+/*              array (same order as saved)       */
+/*------------------------------------------------*/
+
+static frefs_t *sigfile_load_refs(const sfedge_t *edges, uint32_t num) {
+   frefs_t *refs;
+   fref_t **tail;
+   fref_t *ref;
+   uint32_t i;
+
+   if (num == 0) {
+      return NULL;
+   }
+
+   refs = new frefs_t();
+   if (!refs) {
+      return NULL;
+   }
+   memset(refs, 0, sizeof(*refs));
+
+   // refs were unique when saved: no duplicate check
+   tail = &refs->list;
+   for (i = 0; i < num; i++) {
+      ref = new fref_t();
+      if (!ref) {
+         break;
+      }
+      ref->ea = (ea_t)edges[i].ea;
+      ref->type = edges[i].type;
+      ref->rtype = CHECK_REF;
+      ref->next = NULL;
+
+      *tail = ref;
+      tail = &ref->next;
+      refs->num++;
+   }
+
+   return refs;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_make_sig                    */
+/* description: Builds a signature from a record  */
+/*------------------------------------------------*/
+
+static sig_t *sigfile_make_sig(const sfrecord_t *rec, const sfedge_t *edges, const char *strs) {
+   sig_t *sig;
+
+   sig = new sig_t();
+   if (!sig) {
+      return NULL;
+   }
+
+   sig->set_name(qstring(strs + rec->name_off, rec->name_len));
+   sig->startEA = (ea_t)rec->start;
+
+   sig->dl.lines = new char[rec->lines_len + 1];
+   if (sig->dl.lines) {
+      memcpy(sig->dl.lines, strs + rec->lines_off, rec->lines_len);
+      sig->dl.lines[rec->lines_len] = '\0';
+      sig->dl.num = rec->lines_len;
+   }
+
+   sig->sig = rec->sig;
+   sig->hash = rec->hash;
+   sig->hash2 = rec->hash2;
+   sig->crc_hash = rec->crc_hash;
+   sig->str_hash = rec->str_hash;
+
+   sig->prefs = sigfile_load_refs(edges + rec->pref_first, rec->pref_num);
+   sig->srefs = sigfile_load_refs(edges + rec->sref_first, rec->sref_num);
+
+   return sig;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_check                       */
+/* description: Validates a mapped signature file */
+/*------------------------------------------------*/
+
+static bool sigfile_check(const uchar *data, size_t size) {
+   const sfheader_t *hdr = (const sfheader_t *)data;
+   const sfrecord_t *rec;
+   uint32_t i;
+
+   if (hdr->version != SIGFILE_VERSION || hdr->hsize != sizeof(sfheader_t) || hdr->rsize != sizeof(sfrecord_t)) {
+      msg("slist_t::load: unsupported signature file version %u\n", hdr->version);
+      return false;
+   }
+   if (hdr->ea_size != sizeof(ea_t)) {
+      msg("slist_t::load: signature file was generated by the %d-bit plugin\n", hdr->ea_size * 8);
+      return false;
+   }
+
+   if (hdr->rec_off != sizeof(sfheader_t)
+       || hdr->edge_off != hdr->rec_off + (uint64_t)hdr->num * sizeof(sfrecord_t)
+       || hdr->nedges > (size - hdr->edge_off) / sizeof(sfedge_t)
+       || hdr->str_off != hdr->edge_off + hdr->nedges * sizeof(sfedge_t)
+       || hdr->str_off > size || hdr->str_size != size - hdr->str_off) {
+      msg("slist_t::load: truncated signature file\n");
+      return false;
+   }
+
+   if (sigfile_crc32(0, data + sizeof(sfheader_t), size - sizeof(sfheader_t)) != hdr->crc) {
+      msg("slist_t::load: signature file checksum mismatch\n");
+      return false;
+   }
+
+   rec = (const sfrecord_t *)(data + hdr->rec_off);
+   for (i = 0; i < hdr->num; i++) {
+      if (rec[i].name_off + rec[i].name_len > hdr->str_size
+          || rec[i].lines_off + rec[i].lines_len > hdr->str_size
+          || (uint64_t)rec[i].pref_first + rec[i].pref_num > hdr->nedges
+          || (uint64_t)rec[i].sref_first + rec[i].sref_num > hdr->nedges) {
+         msg("slist_t::load: corrupted signature record %u\n", i);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::load_map                    */
+/* description: Loads a signature list from a     */
+/*              mapped file (versioned format)    */
+/*------------------------------------------------*/
+
+bool slist_t::load_map(const uchar *data, size_t size) {
+   const sfheader_t *hdr = (const sfheader_t *)data;
+   const sfrecord_t *rec;
+   const sfedge_t *edges;
+   const char *strs;
+   sig_t *sig;
+   uint32_t i;
+
+   if (!sigfile_check(data, size)) {
+      return false;
+   }
+
+   rec = (const sfrecord_t *)(data + hdr->rec_off);
+   edges = (const sfedge_t *)(data + hdr->edge_off);
+   strs = (const char *)(data + hdr->str_off);
+
+   if (!init(hdr->num, NULL)) {
+      return false;
+   }
+
+   for (i = 0; i < hdr->num; i++, rec++) {
+      sig = sigfile_make_sig(rec, edges, strs);
+      if (!sig) {
+         break;
+      }
+      add(sig);
+   }
+
+   sort();
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t::load_legacy                 */
+/* description: Loads a signature list saved in   */
+/*              the unversioned format            */
+/*------------------------------------------------*/
+
+bool slist_t::load_legacy(const char *filename) {
+   uint32_t init_num;
+
+   FILE *fp = qfopen(filename, "rb");
+   if (fp == NULL) {
+      msg("slist_t::load: qfopen('%s', 'rb') failed\n", filename);
+      return false;
+   }
+   if (qfread(fp, &init_num, sizeof(init_num)) != sizeof(init_num)) {
+      msg("slist_t::load: qfread(...) failed\n");
+      qfclose(fp);
+      return false;
+   }
+
+   if (init(init_num, NULL)) {
+
+      for (uint32_t i = 0; i < init_num; i++) {
+         add(sig_load(fp));
+      }
+
+      sort();
+   }
+
+   qfclose(fp);
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : slist_t()                           */
+/* description: Loads signature list from disk    */
+/*------------------------------------------------*/
+
+slist_t::slist_t(const char *filename) {
+   uchar *data;
+   size_t size;
+   void *handle;
+
+   num = 0;
+   org_num = 0;
+   holes = 0;
+   lazy = NULL;
+   ids = NULL;
+   file = NULL;
+   dclk = false;
+   gv = NULL;
+   unique = false;
+   msl = NULL;
+   sigs = NULL;
+
+   data = (uchar *)os_map_file(filename, &size, &handle);
+   if (data) {
+      if (size >= sizeof(sfheader_t) && !memcmp(data, SIGFILE_MAGIC, 4)) {
+         load_map(data, size);
+         os_unmap_file(data, size, handle);
+         return;
+      }
+      os_unmap_file(data, size, handle);
+   }
+
+   load_legacy(filename);
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_pack_refs                   */
+/* description: Copies the edges of a ref list to*/
+/*              a stream entry                    */
+/*------------------------------------------------*/
+
+static uchar *sigfile_pack_refs(uchar *p, frefs_t *refs) {
+   sfedge_t edge;
+   fref_t *tmp;
+
+   memset(&edge, 0, sizeof(edge));
+
+   for (tmp = refs ? refs->list : NULL; tmp; tmp = tmp->next) {
+      edge.ea = tmp->ea;
+      edge.type = tmp->type;
+      memcpy(p, &edge, sizeof(edge));
+      p += sizeof(edge);
+   }
+
+   return p;
+}
+
+/*------------------------------------------------*/
+/* function : sigfile_pack                        */
+/* description: Serializes a signature as a      */
+/*              stream entry (see sigfile.h)      */
+/*------------------------------------------------*/
+
+uchar *sigfile_pack(sig_t *sig, uint32_t *len) {
+   sfrecord_t rec;
+   uint64_t size;
+   uchar *buf, *p;
+
+   sigfile_make_record(sig, &rec, 0, 0);
+
+   size = sizeof(rec) + (uint64_t)(rec.pref_num + rec.sref_num) * sizeof(sfedge_t) + rec.name_len + rec.lines_len;
+   // keeps the next entry aligned
+   size = (size + 7) & ~(uint64_t)7;
+
+   buf = new uchar[sizeof(size) + size];
+   if (!buf) {
+      return NULL;
+   }
+   memset(buf, 0, sizeof(size) + size);
+
+   p = buf;
+   memcpy(p, &size, sizeof(size));
+   p += sizeof(size);
+   memcpy(p, &rec, sizeof(rec));
+   p += sizeof(rec);
+   p = sigfile_pack_refs(p, sig->prefs);
+   p = sigfile_pack_refs(p, sig->srefs);
+   memcpy(p, sig->name.c_str(), rec.name_len);
+   p += rec.name_len;
+   memcpy(p, sig->dl.lines, rec.lines_len);
+
+   *len = (uint32_t)(sizeof(size) + size);
+
+   return buf;
+}
+
+/*------------------------------------------------*/
+/* function : sfstream_t::sfstream_t              */
+/* description: Initializes a stream decoder      */
+/*------------------------------------------------*/
+
+sfstream_t::sfstream_t() {
+   buf = NULL;
+   len = 0;
+   size = 0;
+   flags = 0;
+   hdr = false;
+   error = false;
+   sl = NULL;
+   lists = NULL;
+   lists_ea = NULL;
+   nlists = 0;
+   ea = BADADDR;
+}
+
+/*------------------------------------------------*/
+/* function : sfstream_t::~sfstream_t             */
+/* description: Frees the decoder (and the list   */
+/*              if it was not returned)           */
+/*------------------------------------------------*/
+
+sfstream_t::~sfstream_t() {
+   delete [] buf;
+
+   if (sl) {
+      sl->free_sigs();
+      delete sl;
+   }
+
+   for (uint32_t i = 0; i < nlists; i++) {
+      lists[i]->free_sigs();
+      delete lists[i];
+   }
+   free(lists);
+   free(lists_ea);
+}
+
+/*------------------------------------------------*/
+/* function : sfstream_t::feed                    */
+/* description: Decodes the complete entries of a */
+/*              stream chunk                      */
+/*------------------------------------------------*/
+
+bool sfstream_t::feed(const void *data, size_t n) {
+   const sfshdr_t *sh;
+   const sfrecord_t *rec;
+   const sfedge_t *edges;
+   uint64_t esize, nedges;
+   size_t pos, nsize;
+   uchar *nbuf;
+   sig_t *sig;
+
+   if (error) {
+      return false;
+   }
+
+   if (len + n > size) {
+      nsize = qmax(qmax(size * 2, len + n), (size_t)(64 * 1024));
+      nbuf = new uchar[nsize];
+      if (!nbuf) {
+         error = true;
+         return false;
+      }
+      if (buf) {
+         memcpy(nbuf, buf, len);
+         delete [] buf;
+      }
+      buf = nbuf;
+      size = nsize;
+   }
+   memcpy(buf + len, data, n);
+   len += n;
+
+   pos = 0;
+
+   if (!hdr) {
+      if (len < sizeof(sfshdr_t)) {
+         return true;
+      }
+
+      sh = (const sfshdr_t *)buf;
+      if (memcmp(sh->magic, SFSTREAM_MAGIC, sizeof(sh->magic)) || sh->version != SFSTREAM_VERSION) {
+         msg("sfstream_t::feed: unsupported signature stream\n");
+         error = true;
+         return false;
+      }
+      if (sh->ea_size != sizeof(ea_t)) {
+         msg("sfstream_t::feed: signature stream was generated by the %d-bit plugin\n", sh->ea_size * 8);
+         error = true;
+         return false;
+      }
+
+      flags = sh->flags;
+      // batch lists are created by their separator
+      if (!(flags & SFSTREAM_BATCH)) {
+         sl = new slist_t(0, NULL);
+         if (!sl) {
+            error = true;
+            return false;
+         }
+      }
+
+      hdr = true;
+      pos = sizeof(sfshdr_t);
+   }
+
+   while (len - pos >= sizeof(esize)) {
+      memcpy(&esize, buf + pos, sizeof(esize));
+      if ((esize < sizeof(sfrecord_t) && (esize != sizeof(uint64_t) || !(flags & SFSTREAM_BATCH))) || esize & 7) {
+         error = true;
+         break;
+      }
+      if (esize > len - pos - sizeof(esize)) {
+         break;
+      }
+
+      if (esize == sizeof(uint64_t)) {
+         memcpy(&esize, buf + pos + sizeof(esize), sizeof(esize));
+         if (!next_list((ea_t)esize)) {
+            error = true;
+            break;
+         }
+         pos += 2 * sizeof(esize);
+         continue;
+      }
+      if (!sl) {
+         error = true;
+         break;
+      }
+
+      rec = (const sfrecord_t *)(buf + pos + sizeof(esize));
+      nedges = (uint64_t)rec->pref_num + rec->sref_num;
+      if (rec->pref_first != 0 || rec->sref_first != rec->pref_num || rec->name_off != 0
+          || rec->lines_off != rec->name_len
+          || sizeof(sfrecord_t) + nedges * sizeof(sfedge_t) + rec->name_len + rec->lines_len > esize) {
+         error = true;
+         break;
+      }
+      edges = (const sfedge_t *)(rec + 1);
+
+      // grows geometrically: the number of signatures is not known
+      if (sl->num >= sl->org_num && !sl->realloc(qmax(sl->org_num, (uint32_t)((flags & SFSTREAM_BATCH) ? 16 : 1024)))) {
+         error = true;
+         break;
+      }
+
+      sig = sigfile_make_sig(rec, edges, (const char *)(edges + nedges));
+      if (!sig) {
+         error = true;
+         break;
+      }
+      sl->add(sig);
+
+      pos += sizeof(esize) + (size_t)esize;
+   }
+
+   if (error) {
+      msg("sfstream_t::feed: corrupted signature stream\n");
+      return false;
+   }
+
+   // entries are 8 bytes aligned: the buffer start stays aligned
+   if (pos) {
+      memmove(buf, buf + pos, len - pos);
+      len -= pos;
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : sfstream_t::finish                  */
+/* description: Returns the decoded list sorted   */
+/*              like a loaded signature file      */
+/*------------------------------------------------*/
+
+slist_t *sfstream_t::finish() {
+   slist_t *ret;
+
+   if (error || !hdr || len != 0) {
+      msg("sfstream_t::finish: incomplete signature stream\n");
+      return NULL;
+   }
+
+   // replays the sender sort (if any) then the loader one so that the
+   // list is in the exact order of the signature file path
+   if (flags & SFSTREAM_SORT) {
+      sl->sort();
+   }
+   sl->sort();
+
+   ret = sl;
+   sl = NULL;
+
+   return ret;
+}
+
+/*------------------------------------------------*/
+/* function : sfstream_t::next_list               */
+/* description: Keeps the current list of a batch */
+/*              stream and starts the list of     */
+/*              function fea                      */
+/*------------------------------------------------*/
+
+bool sfstream_t::next_list(ea_t fea) {
+   slist_t **nl;
+   ea_t *ne;
+   uint32_t cap;
+
+   if (sl) {
+      // arrays are doubled when nlists reaches a power of two
+      if (nlists == 0 || (nlists >= 16 && (nlists & (nlists - 1)) == 0)) {
+         cap = qmax(nlists * 2, (uint32_t)16);
+         nl = (slist_t **)realloc(lists, cap * sizeof(*lists));
+         if (!nl) {
+            return false;
+         }
+         lists = nl;
+         ne = (ea_t *)realloc(lists_ea, cap * sizeof(*lists_ea));
+         if (!ne) {
+            return false;
+         }
+         lists_ea = ne;
+      }
+
+      lists[nlists] = sl;
+      lists_ea[nlists] = ea;
+      nlists++;
+   }
+
+   sl = new slist_t(0, NULL);
+   if (!sl) {
+      return false;
+   }
+   ea = fea;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : sfstream_t::finish_batch            */
+/* description: Returns the lists of a batch      */
+/*              stream in stream order (and their */
+/*              function addresses)               */
+/*------------------------------------------------*/
+
+slist_t **sfstream_t::finish_batch(ea_t **eas, uint32_t *num) {
+   slist_t **ret;
+
+   if (error || !hdr || len != 0 || !(flags & SFSTREAM_BATCH)) {
+      msg("sfstream_t::finish_batch: incomplete signature stream\n");
+      return NULL;
+   }
+
+   // the last list has no following separator
+   if (sl && !next_list(BADADDR)) {
+      return NULL;
+   }
+   delete sl;
+   sl = NULL;
+
+   ret = lists;
+   *eas = lists_ea;
+   *num = nlists;
+
+   lists = NULL;
+   lists_ea = NULL;
+   nlists = 0;
+
+   return ret;
+}
@@ -0,0 +1,221 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Minimal replacements for the few IDA SDK types and helpers used by the
+// diffing core (sig lists, chained lists, hash, diff engine) so that it can
+// be built outside of IDA (PDIFF_STANDALONE).
+
+#ifndef __STANDALONE_H__
+#define __STANDALONE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define idaapi
+
+typedef unsigned char uchar;
+typedef uint32_t uint32;
+typedef int32_t int32;
+typedef uint64_t uint64;
+
+#ifdef __EA64__
+typedef uint64_t ea_t;
+#else
+typedef uint32_t ea_t;
+#endif
+
+#define BADADDR ((ea_t)-1)
+#define QMAXPATH 260
+
+struct graph_viewer_t;
+struct func_t;
+
+template <class T> inline T qmin(const T &a, const T &b) { return a < b ? a : b; }
+template <class T> inline T qmax(const T &a, const T &b) { return a > b ? a : b; }
+
+// %a prints an address in hex, as in IDA
+inline std::string qfmt_ea(const char *format) {
+   std::string fmt(format);
+   size_t i;
+
+   for (i = fmt.find("%a"); i != std::string::npos; i = fmt.find("%a", i)) {
+      fmt.replace(i, 2, sizeof(ea_t) == 8 ? "%llX" : "%X");
+   }
+
+   return fmt;
+}
+
+/*------------------------------------------------*/
+/* qstring : zero-initializable string (sig_t is  */
+/*           memset to 0 on creation)             */
+/*------------------------------------------------*/
+
+class qstring {
+   char *buf;
+   size_t len;
+
+   void assign(const char *s, size_t n) {
+      char *nbuf = (char *)malloc(n + 1);
+      memcpy(nbuf, s, n);
+      nbuf[n] = '\0';
+      free(buf);
+      buf = nbuf;
+      len = n;
+   }
+
+public:
+   qstring() : buf(NULL), len(0) {}
+   qstring(const char *s) : buf(NULL), len(0) { assign(s, strlen(s)); }
+   qstring(const char *s, size_t n) : buf(NULL), len(0) { assign(s, n); }
+   qstring(const qstring &s) : buf(NULL), len(0) { assign(s.c_str(), s.length()); }
+   ~qstring() { free(buf); }
+
+   qstring &operator=(const char *s) { assign(s, strlen(s)); return *this; }
+   qstring &operator=(const qstring &s) { if (this != &s) assign(s.c_str(), s.length()); return *this; }
+
+   bool operator==(const qstring &s) const { return len == s.len && !memcmp(c_str(), s.c_str(), len); }
+   bool operator!=(const qstring &s) const { return !(*this == s); }
+
+   const char *c_str() const { return buf ? buf : ""; }
+   size_t length() const { return len; }
+   bool empty() const { return len == 0; }
+
+   qstring &sprnt(const char *format, ...) {
+      std::string fmt = qfmt_ea(format);
+      va_list va;
+      int n;
+
+      va_start(va, format);
+      n = vsnprintf(NULL, 0, fmt.c_str(), va);
+      va_end(va);
+
+      std::vector<char> tmp(n + 1);
+      va_start(va, format);
+      vsnprintf(&tmp[0], tmp.size(), fmt.c_str(), va);
+      va_end(va);
+
+      assign(&tmp[0], n);
+      return *this;
+   }
+};
+
+template <class T> class qvector : public std::vector<T> {
+public:
+   void add(const T &x) { this->push_back(x); }
+   bool add_unique(const T &x) {
+      if (std::find(this->begin(), this->end(), x) != this->end()) {
+         return false;
+      }
+      this->push_back(x);
+      return true;
+   }
+};
+
+inline int msg(const char *format, ...) {
+   va_list va;
+   int ret;
+
+   va_start(va, format);
+   ret = vprintf(format, va);
+   va_end(va);
+
+   return ret;
+}
+
+#define qsnprintf snprintf
+#define qfopen fopen
+#define qfclose fclose
+#define qfseek fseek
+
+inline int qfprintf(FILE *fp, const char *format, ...) {
+   std::string fmt = qfmt_ea(format);
+   va_list va;
+   int ret;
+
+   va_start(va, format);
+   ret = vfprintf(fp, fmt.c_str(), va);
+   va_end(va);
+
+   return ret;
+}
+
+inline ssize_t qfread(FILE *fp, void *buf, size_t n) {
+   return fread(buf, 1, n, fp);
+}
+
+inline ssize_t qfwrite(FILE *fp, const void *buf, size_t n) {
+   return fwrite(buf, 1, n, fp);
+}
+
+#define qstrdup strdup
+#define qfree free
+
+inline char *qstrncpy(char *dst, const char *src, size_t dstsize) {
+   if (dstsize) {
+      strncpy(dst, src, dstsize - 1);
+      dst[dstsize - 1] = '\0';
+   }
+   return dst;
+}
+
+/*------------------------------------------------*/
+/* os_map_file : maps a whole file read only      */
+/*               (see unix_fct.cpp)               */
+/*------------------------------------------------*/
+
+inline void *os_map_file(const char *path, size_t *size, void **handle) {
+   struct stat st;
+   void *data;
+   int fd;
+
+   *handle = NULL;
+   fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      return NULL;
+   }
+   if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return NULL;
+   }
+
+   data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) {
+      return NULL;
+   }
+   *size = (size_t)st.st_size;
+
+   return data;
+}
+
+inline void os_unmap_file(void *data, size_t size, void *) {
+   munmap(data, size);
+}
+
+#endif
@@ -22,10 +22,54 @@
 #include "system.h"
 #include "options.h"
 #include "os.h"
+#include "sigfile.h"
+
+#ifdef PDIFF_THREADS
+#include <atomic>
+#include <thread>
+#endif
 
 // global variable to keep IPC state
 ipc_config_t ipcc;
 
+// signatures being streamed to the first instance (second instance side)
+struct ipc_stream {
+   idata_t d;
+   int pending;     // chunks not acknowledged yet
+   bool error;
+};
+
+static struct ipc_stream ipcs;
+
+// second instance kept running for an idb (first instance side)
+struct ipc_worker {
+   char *file;                          // idb path (NULL: free slot)
+   void *data;                          // IPC channel
+   uint32 stamp;                        // last use
+   bool dead;                           // channel failed, relaunched on next use
+   sparse_t *pending;                   // prefetch in progress (or NULL)
+   ea_t pending_ea;
+   slist_t *ready[IPC_MAX_PREFETCH];    // prefetched function lists
+   ea_t ready_ea[IPC_MAX_PREFETCH];
+   int nready;
+};
+
+static struct ipc_worker ipcw[IPC_MAX_WORKERS];
+static uint32 ipcw_stamp;
+
+// second idb parsing running in the background
+struct sparse {
+   char tmpname[QMAXPATH];    // batch mode: signature file
+   void *process;             // batch mode: second instance
+   struct ipc_worker *worker; // IPC mode: instance streaming the signatures
+   sfstream_t *st;            // IPC mode: decoded signatures
+   bool ok;                   // IPC mode: command completed
+#ifdef PDIFF_THREADS
+   std::thread *receiver;
+   std::atomic<bool> done;    // receiver is over
+#endif
+};
+
 /*------------------------------------------------*/
 /* function : generate_idc_file                   */
 /* description: generates an idc file to launch   */
@@ -47,13 +91,13 @@ static int generate_idc_file(char *file) {
 }
 
 /*------------------------------------------------*/
-/* function : system_execute_second_instance      */
-/* description: Executes another IDA instance     */
+/* function : system_second_instance_cmd          */
+/* description: Builds the command line of        */
+/*              another IDA instance              */
 /*------------------------------------------------*/
 
-static int system_execute_second_instance(char *idc, ea_t ea, const char *file, bool close, long id, void *data) {
+static int system_second_instance_cmd(char *cmd, size_t size, char *idc, ea_t ea, const char *file, long id) {
    char path[QMAXPATH*4];
-   char cmd[QMAXPATH*4];
 
    if (!getsysfile(path, sizeof(path), IDA_EXEC, NULL)) {
       return -1;
@@ -63,7 +107,7 @@ static int system_execute_second_instance(char *idc, ea_t ea, const char *file,
       return -1;
    }
 
-   qsnprintf(cmd, sizeof(cmd), "\"%s\" -A -S\"%s\" -Opatchdiff2:%ld:%a:%u:\"%s\" \"%s\"",
+   qsnprintf(cmd, size, "\"%s\" -A -S\"%s\" -Opatchdiff2:%ld:%a:%u:\"%s\" \"%s\"",
                            path,
                            idc,
                            id,
@@ -77,9 +121,175 @@ static int system_execute_second_instance(char *idc, ea_t ea, const char *file,
                            file
                            );
 
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : system_execute_second_instance      */
+/* description: Executes another IDA instance     */
+/*------------------------------------------------*/
+
+static int system_execute_second_instance(char *idc, ea_t ea, const char *file, bool close, long id, void *data) {
+   char cmd[QMAXPATH*4];
+
+   if (system_second_instance_cmd(cmd, sizeof(cmd), idc, ea, file, id)) {
+      return -1;
+   }
+
    return os_execute_command(cmd, close, data);
 }
 
+/*------------------------------------------------*/
+/* function : ipc_worker_close                    */
+/* description: Stops a second instance and frees */
+/*              its prefetched lists              */
+/*------------------------------------------------*/
+
+static void ipc_worker_close(struct ipc_worker *w) {
+   slist_t *sl;
+   int i;
+
+   if (!w->file) {
+      return;
+   }
+
+   // the receiver must be done with the channel before it is closed
+   if (w->pending) {
+      sl = system_parse_idb_finish(w->pending);
+      if (sl) {
+         sl->free_sigs();
+         delete sl;
+      }
+   }
+
+   for (i = 0; i < w->nready; i++) {
+      w->ready[i]->free_sigs();
+      delete w->ready[i];
+   }
+
+   os_ipc_close(w->data);
+   qfree(w->file);
+
+   memset(w, '\0', sizeof(*w));
+}
+
+/*------------------------------------------------*/
+/* function : ipc_worker_get                      */
+/* description: Returns the second instance of an */
+/*              idb (launched if needed, the least*/
+/*              recently used one is replaced)    */
+/*------------------------------------------------*/
+
+static struct ipc_worker *ipc_worker_get(const char *file) {
+   struct ipc_worker *w = NULL;
+   char tmpname[QMAXPATH];
+   long key;
+   int i;
+
+   for (i = 0; i < IPC_MAX_WORKERS; i++) {
+      if (ipcw[i].file && !strcmp(ipcw[i].file, file)) {
+         w = &ipcw[i];
+         break;
+      }
+   }
+
+   if (w && w->dead) {
+      ipc_worker_close(w);
+   }
+
+   if (!w || !w->file) {
+      // free slots have a null stamp
+      if (!w) {
+         w = &ipcw[0];
+         for (i = 1; i < IPC_MAX_WORKERS; i++) {
+            if (ipcw[i].stamp < w->stamp) {
+               w = &ipcw[i];
+            }
+         }
+         ipc_worker_close(w);
+      }
+
+      // one channel per slot
+      key = os_get_pid() * IPC_MAX_WORKERS + (long)(w - ipcw);
+
+      if (!os_ipc_init(&w->data, key, IPC_SERVER)) {
+         return NULL;
+      }
+      os_tempnam(tmpname, sizeof(tmpname), ".idc");
+      if (system_execute_second_instance(tmpname, BADADDR, file, false, key, w->data) != 0) {
+         os_ipc_close(w->data);
+         w->data = NULL;
+         return NULL;
+      }
+
+      w->file = qstrdup(file);
+   }
+
+   w->stamp = ++ipcw_stamp;
+
+   return w;
+}
+
+/*------------------------------------------------*/
+/* function : ipc_worker_settle                   */
+/* description: Waits for the prefetch in progress*/
+/*              and keeps its result              */
+/*------------------------------------------------*/
+
+static void ipc_worker_settle(struct ipc_worker *w) {
+   sparse_t *sp = w->pending;
+   slist_t *sl;
+
+   if (!sp) {
+      return;
+   }
+
+   w->pending = NULL;
+   sl = system_parse_idb_finish(sp);
+   if (!sl) {
+      return;
+   }
+
+   if (w->nready == IPC_MAX_PREFETCH) {
+      w->ready[0]->free_sigs();
+      delete w->ready[0];
+      memmove(&w->ready[0], &w->ready[1], (IPC_MAX_PREFETCH - 1) * sizeof(w->ready[0]));
+      memmove(&w->ready_ea[0], &w->ready_ea[1], (IPC_MAX_PREFETCH - 1) * sizeof(w->ready_ea[0]));
+      w->nready--;
+   }
+
+   w->ready[w->nready] = sl;
+   w->ready_ea[w->nready] = w->pending_ea;
+   w->nready++;
+}
+
+/*------------------------------------------------*/
+/* function : ipc_worker_take                     */
+/* description: Returns (and forgets) the         */
+/*              prefetched list of a function     */
+/*------------------------------------------------*/
+
+static slist_t *ipc_worker_take(struct ipc_worker *w, ea_t ea) {
+   slist_t *sl;
+   int i;
+
+   if (w->pending && w->pending_ea == ea) {
+      ipc_worker_settle(w);
+   }
+
+   for (i = 0; i < w->nready; i++) {
+      if (w->ready_ea[i] == ea) {
+         sl = w->ready[i];
+         memmove(&w->ready[i], &w->ready[i + 1], (w->nready - i - 1) * sizeof(w->ready[0]));
+         memmove(&w->ready_ea[i], &w->ready_ea[i + 1], (w->nready - i - 1) * sizeof(w->ready_ea[0]));
+         w->nready--;
+         return sl;
+      }
+   }
+
+   return NULL;
+}
+
 /*------------------------------------------------*/
 /* function : ipc_init                            */
 /* description: Inits interprocess communication  */
@@ -88,31 +298,19 @@ static int system_execute_second_instance(char *idc, ea_t ea, const char *file,
 
 bool ipc_init(const char *file, int type, long id) {
    bool ret;
-   long pid;
-   char tmpname[QMAXPATH];
 
    if (type == 0) {
       ipcc.init = false;
       ipcc.data = NULL;
+      memset(ipcw, '\0', sizeof(ipcw));
+   }
+   else if (type == 1) {
+      return ipc_worker_get(file) != NULL;
    }
    else if (!ipcc.init) {
-      if (type == 1) {
-         pid = os_get_pid();
-         ret = os_ipc_init(&ipcc.data, pid, IPC_SERVER);
-         if (!ret) {
-            return false;
-         }
-         os_tempnam(tmpname, sizeof(tmpname), ".idc");
-         if (system_execute_second_instance(tmpname, BADADDR, file, false, pid, ipcc.data) != 0) {
-            ipc_close();
-            return false;
-         }
-      }
-      else {
-         ret = os_ipc_init(&ipcc.data, id, IPC_CLIENT);
-         if (!ret) {
-            return false;
-         }
+      ret = os_ipc_init(&ipcc.data, id, IPC_CLIENT);
+      if (!ret) {
+         return false;
       }
 
       ipcc.init = true;
@@ -128,6 +326,12 @@ bool ipc_init(const char *file, int type, long id) {
 /*------------------------------------------------*/
 
 void ipc_close() {
+   int i;
+
+   for (i = 0; i < IPC_MAX_WORKERS; i++) {
+      ipc_worker_close(&ipcw[i]);
+   }
+
    if (!ipcc.init) {
       return;
    }
@@ -140,28 +344,56 @@ void ipc_close() {
 
 /*------------------------------------------------*/
 /* function : ipc_send_cmd                        */
-/* description: Executes command on the remote    */
-/*              IDA instance                      */
+/* description: Sends command to the remote IDA   */
+/*              instance                          */
 /*------------------------------------------------*/
 
-static bool ipc_send_cmd(char *cmd) {
+static bool ipc_send_cmd(void *data, char *cmd) {
    idata_t d;
 
    d.cmd = IPC_DATA;
    qstrncpy(d.data, cmd, sizeof(d.data));
+   d.len = (long)strlen(d.data) + 1;
 
-   if (!os_ipc_send(ipcc.data, IPC_SERVER, &d)) {
-      return false;
-   }
+   return os_ipc_send(data, IPC_SERVER, &d);
+}
 
-   if (!os_ipc_recv(ipcc.data, IPC_SERVER, &d) || d.cmd != IPC_DONE) {
-      return false;
+/*------------------------------------------------*/
+/* function : ipc_recv_sigs                       */
+/* description: Decodes the signatures streamed   */
+/*              back by the remote instance until */
+/*              the command is done               */
+/*------------------------------------------------*/
+
+static bool ipc_recv_sigs(void *data, sfstream_t *st) {
+   idata_t d;
+   bool ret;
+
+   while (1) {
+      if (!os_ipc_recv(data, IPC_SERVER, &d)) {
+         return false;
+      }
+      if (d.cmd == IPC_DONE) {
+         break;
+      }
+      if (d.cmd != IPC_SIGS || d.len < 0 || d.len > (long)sizeof(d.data)) {
+         return false;
+      }
+
+      // signatures are decoded while the remote instance keeps parsing,
+      // IPC_END tells it to stop sending on errors
+      ret = st->feed(d.data, (size_t)d.len);
+
+      d.cmd = ret ? IPC_DONE : IPC_END;
+      d.len = 0;
+      if (!os_ipc_send(data, IPC_SERVER, &d)) {
+         return false;
+      }
    }
 
    return true;
 }
 
-
 /*------------------------------------------------*/
 /* function : ipc_recv_cmd                        */
 /* description: Receives command to execute       */
@@ -202,23 +434,177 @@ bool ipc_recv_cmd_end() {
    idata_t d;
 
    d.cmd = IPC_DONE;
+   d.len = 0;
 
    return os_ipc_send(ipcc.data, IPC_CLIENT, &d);
 }
 
+/*------------------------------------------------*/
+/* function : ipc_stream_ack                      */
+/* description: Waits for the oldest chunk to be  */
+/*              acknowledged                      */
+/*------------------------------------------------*/
+
+static bool ipc_stream_ack() {
+   idata_t ack;
+
+   ack.cmd = IPC_END;
+   if (!os_ipc_recv(ipcc.data, IPC_CLIENT, &ack)) {
+      ipcs.error = true;
+      ipcs.pending = 0;
+      return false;
+   }
+
+   // IPC_END: the first instance failed to decode the stream, the
+   // remaining acks are still read
+   ipcs.pending--;
+   if (ack.cmd != IPC_DONE) {
+      ipcs.error = true;
+   }
+
+   return !ipcs.error;
+}
+
+/*------------------------------------------------*/
+/* function : ipc_stream_flush                    */
+/* description: Sends the pending stream chunk    */
+/*------------------------------------------------*/
+
+static bool ipc_stream_flush() {
+   if (ipcs.error) {
+      return false;
+   }
+   if (ipcs.d.len == 0) {
+      return true;
+   }
+
+   ipcs.d.cmd = IPC_SIGS;
+   if (!os_ipc_send(ipcc.data, IPC_CLIENT, &ipcs.d)) {
+      ipcs.error = true;
+      ipcs.pending = 0;
+      return false;
+   }
+   ipcs.d.len = 0;
+   ipcs.pending++;
+
+   // up to IPC_WINDOW chunks are in flight (a single one with the
+   // shared memory transport)
+   if (ipcs.pending >= IPC_WINDOW) {
+      return ipc_stream_ack();
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : ipc_stream_write                    */
+/* description: Appends data to the stream        */
+/*------------------------------------------------*/
+
+static void ipc_stream_write(const void *data, size_t len) {
+   const char *p = (const char *)data;
+   size_t n;
+
+   while (len && !ipcs.error) {
+      n = qmin(len, sizeof(ipcs.d.data) - (size_t)ipcs.d.len);
+      memcpy(ipcs.d.data + ipcs.d.len, p, n);
+      ipcs.d.len += n;
+      p += n;
+      len -= n;
+
+      if ((size_t)ipcs.d.len == sizeof(ipcs.d.data)) {
+         ipc_stream_flush();
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : ipc_stream_begin                    */
+/* description: Starts streaming signatures to   */
+/*              the first instance                */
+/*------------------------------------------------*/
+
+bool ipc_stream_begin(uint32_t flags) {
+   sfshdr_t hdr;
+
+   ipcs.d.len = 0;
+   ipcs.pending = 0;
+   ipcs.error = !ipcc.init;
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, SFSTREAM_MAGIC, sizeof(hdr.magic));
+   hdr.version = SFSTREAM_VERSION;
+   hdr.ea_size = sizeof(ea_t);
+   hdr.flags = flags;
+
+   ipc_stream_write(&hdr, sizeof(hdr));
+
+   return !ipcs.error;
+}
+
+/*------------------------------------------------*/
+/* function : ipc_stream_sig                      */
+/* description: Streams one signature             */
+/*------------------------------------------------*/
+
+void ipc_stream_sig(sig_t *sig) {
+   uchar *buf;
+   uint32_t len;
+
+   if (ipcs.error) {
+      return;
+   }
+
+   buf = sigfile_pack(sig, &len);
+   if (!buf) {
+      ipcs.error = true;
+      return;
+   }
+
+   ipc_stream_write(buf, len);
+   delete [] buf;
+}
+
+/*------------------------------------------------*/
+/* function : ipc_stream_fct                      */
+/* description: Starts the list of a function in  */
+/*              a batch stream                    */
+/*------------------------------------------------*/
+
+void ipc_stream_fct(ea_t ea) {
+   uint64_t sep[2];
+
+   sep[0] = sizeof(uint64_t);
+   sep[1] = (uint64_t)ea;
+
+   ipc_stream_write(sep, sizeof(sep));
+}
+
+/*------------------------------------------------*/
+/* function : ipc_stream_end                      */
+/* description: Sends the last stream chunk       */
+/*------------------------------------------------*/
+
+bool ipc_stream_end() {
+   ipc_stream_flush();
+
+   // a transport failure clears pending
+   while (ipcs.pending) {
+      ipc_stream_ack();
+   }
+
+   return !ipcs.error;
+}
+
 /*------------------------------------------------*/
 /* function : ipc_execute_second_instance         */
 /* description: Sends command to the second IDA   */
 /*              instance                          */
 /*------------------------------------------------*/
 
-static void ipc_execute_second_instance(char *idc, ea_t ea, const char *file) {
+static bool ipc_execute_second_instance(struct ipc_worker *w, ea_t ea) {
    char cmd[QMAXPATH*4];
 
-   if (!ipc_init(file, 1, 0)) {
-      return;
-   }
-
    qsnprintf(cmd, sizeof(cmd), "%u:%a:%u:%s",
                            0,
                            ea,
@@ -227,10 +613,124 @@ static void ipc_execute_second_instance(char *idc, ea_t ea, const char *file) {
 #else
                            0,  // dto went away in 7.0, not clear how to replicate above
 #endif
-                           idc
+                           IPC_STREAM_FILE
                            );
 
-   ipc_send_cmd(cmd);
+   return ipc_send_cmd(w->data, cmd);
+}
+
+#ifdef PDIFF_THREADS
+/*------------------------------------------------*/
+/* function : system_parse_recv                   */
+/* description: Receiver thread of a background   */
+/*              parsing                           */
+/*------------------------------------------------*/
+
+static void system_parse_recv(sparse_t *sp) {
+   sp->ok = ipc_recv_sigs(sp->worker->data, sp->st);
+   sp->done = true;
+}
+#endif
+
+/*------------------------------------------------*/
+/* function : system_parse_idb_start              */
+/* description: starts generating the list of     */
+/*              signatures of another idb while   */
+/*              the caller keeps working          */
+/*------------------------------------------------*/
+
+sparse_t *system_parse_idb_start(ea_t ea, const char *file, options_t *opt) {
+   char cmd[QMAXPATH*4];
+   sparse_t *sp;
+
+   sp = new sparse_t();
+   if (!sp) {
+      return NULL;
+   }
+   memset(sp->tmpname, '\0', sizeof(sp->tmpname));
+   sp->process = NULL;
+   sp->worker = NULL;
+   sp->st = NULL;
+   sp->ok = false;
+#ifdef PDIFF_THREADS
+   sp->receiver = NULL;
+   sp->done = false;
+#endif
+
+   // the IPC instance streams its signatures, the batch one saves them
+   if (opt->options_use_ipc()) {
+      sp->worker = ipc_worker_get(file);
+      if (!sp->worker) {
+         delete sp;
+         return NULL;
+      }
+
+      // a worker runs one command at a time
+      ipc_worker_settle(sp->worker);
+
+      if (!ipc_execute_second_instance(sp->worker, ea)) {
+         sp->worker->dead = true;
+         delete sp;
+         return NULL;
+      }
+
+      sp->st = new sfstream_t();
+#ifdef PDIFF_THREADS
+      // the chunks must be acknowledged as they come for the remote
+      // instance to keep parsing
+      sp->receiver = new std::thread(system_parse_recv, sp);
+#else
+      sp->ok = ipc_recv_sigs(sp->worker->data, sp->st);
+#endif
+      return sp;
+   }
+
+   os_tempnam(sp->tmpname, sizeof(sp->tmpname), ".idc");
+
+   if (system_second_instance_cmd(cmd, sizeof(cmd), sp->tmpname, ea, file, 0) == 0) {
+      sp->process = os_start_command(cmd);
+   }
+   if (!sp->process) {
+      os_unlink(sp->tmpname);
+      delete sp;
+      return NULL;
+   }
+
+   return sp;
+}
+
+/*------------------------------------------------*/
+/* function : system_parse_idb_finish             */
+/* description: waits for a background parsing    */
+/*              and returns its signatures        */
+/*------------------------------------------------*/
+
+slist_t *system_parse_idb_finish(sparse_t *sp) {
+   slist_t *sl = NULL;
+
+   if (sp->st) {
+#ifdef PDIFF_THREADS
+      sp->receiver->join();
+      delete sp->receiver;
+#endif
+      if (sp->ok) {
+         sl = sp->st->finish();
+      }
+      else {
+         sp->worker->dead = true;
+      }
+      delete sp->st;
+   }
+   else {
+      if (os_wait_command(sp->process) == 0) {
+         sl = new slist_t(sp->tmpname);
+      }
+      os_unlink(sp->tmpname);
+   }
+
+   delete sp;
+
+   return sl;
 }
 
 /*------------------------------------------------*/
@@ -240,22 +740,182 @@ static void ipc_execute_second_instance(char *idc, ea_t ea, const char *file) {
 /*------------------------------------------------*/
 
 slist_t *system_parse_idb(ea_t ea, const char *file, options_t *opt) {
-   slist_t *sl = NULL;
-   char tmpname[QMAXPATH];
+   struct ipc_worker *w;
+   sparse_t *sp;
+   slist_t *sl;
+
+   if (ea != BADADDR && opt->options_use_ipc()) {
+      w = ipc_worker_get(file);
+      sl = w ? ipc_worker_take(w, ea) : NULL;
+      if (sl) {
+         return sl;
+      }
+   }
 
-   os_tempnam(tmpname, sizeof(tmpname), ".idc");
+   sp = system_parse_idb_start(ea, file, opt);
+   if (!sp) {
+      return NULL;
+   }
+
+   return system_parse_idb_finish(sp);
+}
+
+/*------------------------------------------------*/
+/* function : system_prefetch_fct                 */
+/* description: speculatively parses a function of*/
+/*              another idb on its idle worker    */
+/*              returns 1 if started, 0 if already*/
+/*              available, -1 if the worker is    */
+/*              busy or IPC is disabled           */
+/*------------------------------------------------*/
+
+int system_prefetch_fct(ea_t ea, const char *file, options_t *opt) {
+#ifdef PDIFF_THREADS
+   struct ipc_worker *w;
+   sparse_t *sp;
+   int i;
 
    if (!opt->options_use_ipc()) {
-      system_execute_second_instance(tmpname, ea, file, true, 0, NULL);
+      return -1;
    }
-   else {
-      ipc_execute_second_instance(tmpname, ea, file);
+
+   w = ipc_worker_get(file);
+   if (!w) {
+      return -1;
+   }
+
+   if (w->pending) {
+      if (w->pending_ea == ea) {
+         return 0;
+      }
+      if (!w->pending->done) {
+         return -1;
+      }
+      ipc_worker_settle(w);
+   }
+
+   for (i = 0; i < w->nready; i++) {
+      if (w->ready_ea[i] == ea) {
+         return 0;
+      }
+   }
+
+   sp = system_parse_idb_start(ea, file, opt);
+   if (!sp) {
+      return -1;
+   }
+
+   w->pending = sp;
+   w->pending_ea = ea;
+
+   return 1;
+#else
+   // without a receiver thread the prefetch would block the UI
+   return -1;
+#endif
+}
+
+/*------------------------------------------------*/
+/* function : system_parse_fcts                   */
+/* description: generates the block lists of the  */
+/*              functions eas[num] of another idb */
+/*              with a single request (NULL items */
+/*              for the functions which failed)   */
+/*------------------------------------------------*/
+
+slist_t **system_parse_fcts(ea_t *eas, uint32_t num, const char *file, options_t *opt) {
+   struct ipc_worker *w;
+   char tmpname[QMAXPATH];
+   char cmd[QMAXPATH*4];
+   slist_t **ret, **lists = NULL;
+   ea_t *leas = NULL;
+   uint32_t nlists = 0, i;
+   uint64_t ea;
+   sfstream_t *st;
+   FILE *fp;
+   bool ok;
+
+   // the function list goes through a file: it does not fit a command
+   os_tempnam(tmpname, sizeof(tmpname), ".eas");
+   fp = qfopen(tmpname, "wb");
+   if (!fp) {
+      return NULL;
+   }
+   for (i = 0; i < num; i++) {
+      ea = (uint64_t)eas[i];
+      qfwrite(fp, &ea, sizeof(ea));
    }
+   qfclose(fp);
+
+   // a worker is used even without the IPC option: the alternative is one
+   // IDA instance per function
+   w = ipc_worker_get(file);
+   if (!w) {
+      os_unlink(tmpname);
+      return NULL;
+   }
+   ipc_worker_settle(w);
+
+   qsnprintf(cmd, sizeof(cmd), "%u:%a:%u:%c%s",
+                           0,
+                           BADADDR,
+#if IDA_SDK_VERSION < 700
+                           dto.graph.s_showpref,
+#else
+                           0,  // dto went away in 7.0, not clear how to replicate above
+#endif
+                           IPC_BATCH_PREFIX,
+                           tmpname
+                           );
 
-   sl = new slist_t(tmpname);
+   st = new sfstream_t();
+   ok = ipc_send_cmd(w->data, cmd) && ipc_recv_sigs(w->data, st);
+   if (ok) {
+      lists = st->finish_batch(&leas, &nlists);
+   }
+   else {
+      w->dead = true;
+   }
+   delete st;
    os_unlink(tmpname);
 
-   return sl;
+   if (!opt->options_use_ipc()) {
+      ipc_worker_close(w);
+   }
+
+   if (!lists) {
+      return NULL;
+   }
+
+   // one list per requested function, in request order
+   ret = NULL;
+   if (nlists == num) {
+      ret = new slist_t *[num];
+      for (i = 0; i < num; i++) {
+         if (leas[i] != eas[i]) {
+            break;
+         }
+         ret[i] = lists[i]->num ? lists[i] : NULL;
+      }
+      if (i < num) {
+         delete [] ret;
+         ret = NULL;
+      }
+   }
+
+   if (!ret) {
+      msg("Error: unexpected block lists from the second instance.\n");
+   }
+   for (i = 0; i < nlists; i++) {
+      if (!ret || !ret[i]) {
+         lists[i]->free_sigs();
+         delete lists[i];
+      }
+   }
+   free(lists);
+   free(leas);
+
+   return ret;
 }
 
 /*------------------------------------------------*/
@@ -29,11 +29,26 @@
 
 #define IPC_DATA 0
 #define IPC_DONE 1
+#define IPC_SIGS 2
 #define IPC_END  3
 
+// only the header and the used part of data are transferred
+#define IPC_DATA_SIZE (64 * 1024)
+
+// file name telling the second instance to stream the signatures back
+// over IPC instead of saving them
+#define IPC_STREAM_FILE "-"
+
+// file name prefix telling the second instance to stream the block lists
+// of the functions whose addresses are stored in the named file
+#define IPC_BATCH_PREFIX '+'
+
 #define IPC_SERVER 1
 #define IPC_CLIENT 2
 
+#define IPC_MAX_WORKERS  4    // second instances kept running (one per idb)
+#define IPC_MAX_PREFETCH 4    // prefetched function lists per instance
+
 
 struct ipc_config {
    long init;
@@ -44,18 +59,29 @@ typedef struct ipc_config ipc_config_t;
 
 struct idata {
    long cmd;
-   char data[256];
+   long len;      // used bytes of data
+   char data[IPC_DATA_SIZE];
 };
 
 typedef struct idata idata_t;
 
+typedef struct sparse sparse_t;
+
 
 bool system_get_pref(const char *, void *, int);
 slist_t *system_parse_idb(ea_t, const char *, options_t *);
+sparse_t *system_parse_idb_start(ea_t, const char *, options_t *);
+slist_t *system_parse_idb_finish(sparse_t *);
+int system_prefetch_fct(ea_t, const char *, options_t *);
+slist_t **system_parse_fcts(ea_t *, uint32_t, const char *, options_t *);
 
 bool ipc_init(const char *, int, long);
 void ipc_close();
 bool ipc_recv_cmd(char *, size_t);
 bool ipc_recv_cmd_end();
+bool ipc_stream_begin(uint32_t);
+void ipc_stream_sig(sig_t *);
+void ipc_stream_fct(ea_t);
+bool ipc_stream_end();
 
 #endif
@@ -0,0 +1,262 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times the clist_t lookup tables (cindex) on 1k to 1M element lists: the
+// build cost (first lookup of a type) and the cost of one get_eq_sig call
+// per element of the other list, for each indexed match type. Then diffs
+// lists of the same sizes with generate_diff: the time must grow about
+// linearly, and every pair must satisfy its match type although the
+// tables are read while update_and_remove takes the matches out.
+
+#include "precomp.h"
+
+#include <string.h>
+#include <chrono>
+
+#include "sig.h"
+#include "clist.h"
+#include "diff.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+/*------------------------------------------------*/
+/* function : bench_rand                          */
+/* description: Returns a hash of an element      */
+/*              index and a salt                  */
+/*------------------------------------------------*/
+
+static uint32_t bench_rand(size_t i, uint32_t salt) {
+   uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ULL + salt;
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+
+   return (uint32_t)h;
+}
+
+/*------------------------------------------------*/
+/* function : bench_list                          */
+/* description: Builds a sorted list of num sigs  */
+/*              (side 0 or 1: 1 in 8 sigs of side */
+/*              1 differ from side 0)             */
+/*------------------------------------------------*/
+
+static slist_t *bench_list(size_t num, uint32_t side) {
+   slist_t *sl;
+   sig_t *sig;
+   char name[32];
+   size_t i, j;
+
+   sl = new slist_t(num, NULL);
+   for (i = 0; i < num; i++) {
+      j = (side && bench_rand(i, 1) % 8 == 0) ? i + num : i;
+
+      sig = new sig_t();
+      if (bench_rand(j, 2) % 2) {
+         qsnprintf(name, sizeof(name), "fct_%u", (uint32_t)j);
+      }
+      else {
+         qsnprintf(name, sizeof(name), "sub_%x", (uint32_t)(0x401000 + i * 0x40));
+      }
+      sig->set_name(name);
+      sig->set_start(0x401000 + i * 0x40);
+      // clustered: many sigs share sig and hash, fewer crc_hash
+      sig->sig = bench_rand(j, 3) % (num / 4 + 1);
+      sig->hash = bench_rand(j, 4) % 7;
+      sig->crc_hash = bench_rand(j, 5) % (num / 2 + 1);
+      sig->str_hash = bench_rand(j, 6) % 3 ? bench_rand(j, 7) : 0;
+      sig->hash2 = bench_rand(j, 8);
+      sig->lines = 2 + bench_rand(j, 9) % 100;
+      sl->add(sig);
+   }
+   sl->sort();
+
+   return sl;
+}
+
+/*------------------------------------------------*/
+/* function : bench_free                          */
+/* description: Frees a list and its clist        */
+/*------------------------------------------------*/
+
+static void bench_free(slist_t *sl, clist_t *cl) {
+   size_t i;
+
+   delete cl;
+   for (i = 0; i < sl->num; i++) {
+      sl->sigs[i]->nodes = NULL;
+   }
+   sl->free_sigs();
+   delete sl;
+}
+
+/*------------------------------------------------*/
+/* function : bench_type                          */
+/* description: Times one match type on a pair of */
+/*              lists                             */
+/*------------------------------------------------*/
+
+static void bench_type(size_t num, clist_t *cl1, clist_t *cl2, int type, const char *tname) {
+   bench_clock::time_point t0, t1, t2;
+   dpsig_t *ds;
+   size_t found = 0;
+
+   // the first lookup builds the table of this type (name and str
+   // lookups return early on sub_ names and empty strings)
+   for (ds = cl1->sigs; ds; ds = ds->next) {
+      if (strncmp(ds->sig->name.c_str(), "sub_", 4) && ds->sig->str_hash) {
+         break;
+      }
+   }
+   t0 = bench_clock::now();
+   cl2->reset();
+   cl2->get_eq_sig(ds ? ds : cl1->sigs, type);
+   t1 = bench_clock::now();
+
+   for (ds = cl1->sigs; ds; ds = ds->next) {
+      cl2->reset();
+      if (cl2->get_eq_sig(ds, type)) {
+         found++;
+      }
+   }
+   t2 = bench_clock::now();
+
+   msg("cindex: %8u %-14s build %9.3f ms  lookup %8.1f ns  (%u found)\n",
+       (uint32_t)num, tname,
+       std::chrono::duration<double, std::milli>(t1 - t0).count(),
+       std::chrono::duration<double, std::nano>(t2 - t1).count() / num,
+       (uint32_t)found);
+}
+
+/*------------------------------------------------*/
+/* function : bench_pair                          */
+/* description: Checks that a pair satisfies its  */
+/*              match type                        */
+/*------------------------------------------------*/
+
+static bool bench_pair(sig_t *s1, sig_t *s2) {
+   if (!s2 || s2->msig != s1 || s2->mtype != s1->mtype) {
+      return false;
+   }
+
+   switch (s1->mtype) {
+      case DIFF_EQUAL_NAME:
+         return s1->name == s2->name;
+      case DIFF_EQUAL_SIG_HASH_CRC:
+      case DIFF_EQUAL_SIG_HASH_CRC_STR:
+      case DIFF_EQUAL_SIG_HASH:
+         return sig_equal(s1, s2, s1->mtype);
+      case DIFF_NEQUAL_STR:
+         return s1->str_hash == s2->str_hash;
+   }
+
+   return false;
+}
+
+/*------------------------------------------------*/
+/* function : bench_diff                          */
+/* description: Times generate_diff on two lists  */
+/*              of num sigs                       */
+/*------------------------------------------------*/
+
+static int bench_diff(size_t num) {
+   bench_clock::time_point t0, t1;
+   uint32_t types[DIFF_MANUAL];
+   uint32_t matched = 0, bad = 0;
+   slist_t *sl[2];
+   sig_t *sig;
+   size_t i, k;
+
+   sl[0] = bench_list(num, 0);
+   sl[1] = bench_list(num, 1);
+   memset(types, 0, sizeof(types));
+
+   t0 = bench_clock::now();
+   if (generate_diff_mt(NULL, sl[0], sl[1], "bench", NULL, 1) != 0) {
+      msg("cindex: %u: diff failed\n", (uint32_t)num);
+      return 1;
+   }
+   t1 = bench_clock::now();
+
+   for (i = 0; i < num; i++) {
+      sig = sl[0]->sigs[i];
+      if (sig->mtype == DIFF_UNMATCHED) {
+         continue;
+      }
+      if (sig->mtype < 0 || sig->mtype >= DIFF_MANUAL || !bench_pair(sig, sig->msig)) {
+         bad++;
+         continue;
+      }
+      types[sig->mtype]++;
+      matched++;
+   }
+
+   msg("cindex: %8u diff %11.3f ms  %8.1f us per function  (%u matched: %u name, %u crc, %u crc/str, %u hash, %u pred/succ, %u str)\n",
+       (uint32_t)num,
+       std::chrono::duration<double, std::milli>(t1 - t0).count(),
+       std::chrono::duration<double, std::micro>(t1 - t0).count() / num,
+       matched, types[DIFF_EQUAL_NAME], types[DIFF_EQUAL_SIG_HASH_CRC], types[DIFF_EQUAL_SIG_HASH_CRC_STR],
+       types[DIFF_EQUAL_SIG_HASH], types[DIFF_NEQUAL_PRED] + types[DIFF_NEQUAL_SUCC], types[DIFF_NEQUAL_STR]);
+
+   // the diff pool owning the list elements is gone
+   for (k = 0; k < 2; k++) {
+      for (i = 0; i < num; i++) {
+         sl[k]->sigs[i]->nodes = NULL;
+      }
+      sl[k]->free_sigs();
+      delete sl[k];
+   }
+
+   if (bad) {
+      msg("cindex: %u: %u pairs do not satisfy their match type\n", (uint32_t)num, bad);
+      return 1;
+   }
+   return 0;
+}
+
+int main() {
+   static const size_t nums[] = { 1000, 10000, 100000, 1000000 };
+   slist_t *sl1, *sl2;
+   clist_t *cl1, *cl2;
+   size_t i, num;
+
+   for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+      num = nums[i];
+      sl1 = bench_list(num, 0);
+      sl2 = bench_list(num, 1);
+      cl1 = new clist_t(sl1, NULL);
+      cl2 = new clist_t(sl2, NULL);
+
+      bench_type(num, cl1, cl2, DIFF_EQUAL_NAME, "name");
+      bench_type(num, cl1, cl2, DIFF_EQUAL_SIG_HASH_CRC, "sig_hash_crc");
+      bench_type(num, cl1, cl2, DIFF_EQUAL_SIG_HASH, "sig_hash");
+      bench_type(num, cl1, cl2, DIFF_NEQUAL_STR, "str");
+
+      bench_free(sl1, cl1);
+      bench_free(sl2, cl2);
+   }
+
+   for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+      if (bench_diff(nums[i])) {
+         return 1;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,201 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times the address hash table (hash.cpp) against the chained table it
+// replaced (ref_hash.cpp) on 10k to 1M entries: building a presized table,
+// and probing it with present addresses in a random order and with absent
+// addresses. Both tables get the same addresses in the same order. The
+// build time of a growing table is also given for the current one.
+
+#include "precomp.h"
+
+#include <chrono>
+
+#include "sig.h"
+#include "hash.h"
+#include "ref_hash.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+/*------------------------------------------------*/
+/* function : bench_ms                            */
+/* description: Returns the time between t0 and   */
+/*              t1 in ms                          */
+/*------------------------------------------------*/
+
+static double bench_ms(bench_clock::time_point t0, bench_clock::time_point t1) {
+   return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+/*------------------------------------------------*/
+/* function : bench_build                         */
+/* description: Builds a table of num sigs sized  */
+/*              for size elements                 */
+/*------------------------------------------------*/
+
+static hpsig_t *bench_build(sig_t *sigs, size_t num, size_t size) {
+   hpsig_t *hsig;
+   size_t i;
+
+   hsig = hash_init(size);
+   if (!hsig) {
+      return NULL;
+   }
+   for (i = 0; i < num; i++) {
+      if (hash_add_ea(hsig, &sigs[i]) != 0) {
+         hash_free(hsig);
+         return NULL;
+      }
+   }
+
+   return hsig;
+}
+
+/*------------------------------------------------*/
+/* function : bench_ref_build                     */
+/* description: Builds a reference table of num   */
+/*              sigs                              */
+/*------------------------------------------------*/
+
+static ref_hpsig_t *bench_ref_build(sig_t *sigs, size_t num) {
+   ref_hpsig_t *hsig;
+   size_t i;
+
+   hsig = ref_hash_init(num);
+   if (!hsig) {
+      return NULL;
+   }
+   for (i = 0; i < num; i++) {
+      if (ref_hash_add_ea(hsig, &sigs[i]) != 0) {
+         ref_hash_free(hsig);
+         return NULL;
+      }
+   }
+
+   return hsig;
+}
+
+/*------------------------------------------------*/
+/* function : bench_size                          */
+/* description: Runs the benchmark on num entries */
+/*------------------------------------------------*/
+
+static int bench_size(size_t num) {
+   bench_clock::time_point t0, t1, t2, t3, t4, t5, r0, r1, r2, r3;
+   ref_hpsig_t *rsig;
+   hpsig_t *hsig;
+   sig_t *sigs;
+   ea_t *order;
+   size_t i, j, bad = 0;
+   ea_t tmp;
+
+   // function starts, 16 bytes aligned with gaps as in a real idb
+   sigs = new sig_t[num];
+   order = new ea_t[num];
+   for (i = 0; i < num; i++) {
+      sigs[i].startEA = 0x401000 + i * 0x40 + (i % 3) * 0x10;
+      order[i] = sigs[i].startEA;
+   }
+   // random probe order (fixed seed)
+   for (i = num - 1, j = 12345; i > 0; i--) {
+      j = j * 6364136223846793005ULL + 1442695040888963407ULL;
+      tmp = order[i];
+      order[i] = order[(j >> 33) % (i + 1)];
+      order[(j >> 33) % (i + 1)] = tmp;
+   }
+
+   r0 = bench_clock::now();
+   rsig = bench_ref_build(sigs, num);
+   r1 = bench_clock::now();
+   if (!rsig) {
+      msg("hash: %u: cannot build the reference table\n", (uint32_t)num);
+      return 1;
+   }
+   for (i = 0; i < num; i++) {
+      if (!ref_hash_find_ea(rsig, order[i])) {
+         bad++;
+      }
+   }
+   r2 = bench_clock::now();
+   for (i = 0; i < num; i++) {
+      if (ref_hash_find_ea(rsig, order[i] + 8)) {
+         bad++;
+      }
+   }
+   r3 = bench_clock::now();
+   ref_hash_free(rsig);
+
+   t0 = bench_clock::now();
+   hsig = bench_build(sigs, num, 0);
+   t1 = bench_clock::now();
+   if (!hsig) {
+      msg("hash: %u: cannot build the table\n", (uint32_t)num);
+      return 1;
+   }
+   hash_free(hsig);
+
+   t2 = bench_clock::now();
+   hsig = bench_build(sigs, num, num);
+   t3 = bench_clock::now();
+   if (!hsig) {
+      msg("hash: %u: cannot build the table\n", (uint32_t)num);
+      return 1;
+   }
+
+   for (i = 0; i < num; i++) {
+      if (!hash_find_ea(hsig, order[i])) {
+         bad++;
+      }
+   }
+   t4 = bench_clock::now();
+   for (i = 0; i < num; i++) {
+      if (hash_find_ea(hsig, order[i] + 8)) {
+         bad++;
+      }
+   }
+   t5 = bench_clock::now();
+
+   // old -> new
+   msg("hash: %8u  build %8.3f -> %8.3f ms (grow %8.3f ms)  hit %6.1f -> %6.1f ns  miss %6.1f -> %6.1f ns\n",
+       (uint32_t)num, bench_ms(r0, r1), bench_ms(t2, t3), bench_ms(t0, t1),
+       bench_ms(r1, r2) * 1e6 / num, bench_ms(t3, t4) * 1e6 / num,
+       bench_ms(r2, r3) * 1e6 / num, bench_ms(t4, t5) * 1e6 / num);
+
+   hash_free(hsig);
+   delete [] order;
+   delete [] sigs;
+
+   if (bad) {
+      msg("hash: %u: %u wrong lookups\n", (uint32_t)num, (uint32_t)bad);
+      return 1;
+   }
+   return 0;
+}
+
+int main() {
+   static const size_t nums[] = { 10000, 100000, 1000000 };
+   size_t i;
+
+   for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+      if (bench_size(nums[i])) {
+         return 1;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,92 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times the byte span x86/PPC heuristics on a raw 16 MiB stream: opcode and
+// nop removal at every x86 position, and at every PPC word.
+
+#include "precomp.h"
+
+#include <chrono>
+
+#include "x86.h"
+#include "ppc.h"
+
+#define BENCH_SIZE (16 * 1024 * 1024)
+
+typedef std::chrono::steady_clock bench_clock;
+
+// bytes of the prefixes, nops and jumps the heuristics look for
+static const unsigned char bench_bytes[] = {
+   0x40, 0x48, 0x4F, 0x66, 0xF3, 0xF2, 0x0F, 0x85, 0x75, 0x77, 0x8B, 0x8D,
+   0x87, 0xC0, 0x00, 0x24, 0x64, 0xB4, 0x26, 0xA4, 0x80, 0xB6, 0xE9, 0xEB,
+   0x90, 0x50, 0x58, 0x7C, 0x60, 0x63, 0x78, 0x43, 0xCC, 0xFF, 0x74, 0x1B
+};
+
+/*------------------------------------------------*/
+/* function : bench_ns                            */
+/* description: Returns the time since t0 in ns   */
+/*              per item                          */
+/*------------------------------------------------*/
+
+static double bench_ns(bench_clock::time_point t0, size_t num) {
+   return std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count() / num;
+}
+
+int main() {
+   bench_clock::time_point t0;
+   unsigned char *mem, op;
+   uint64_t state = 88172645463325252ULL;
+   uint32_t sum = 0, nops;
+   size_t i;
+   int x64, be;
+
+   mem = new unsigned char[BENCH_SIZE];
+   for (i = 0; i < BENCH_SIZE; i++) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      mem[i] = bench_bytes[(state >> 16) % sizeof(bench_bytes)];
+   }
+
+   for (x64 = 0; x64 < 2; x64++) {
+      nops = 0;
+      t0 = bench_clock::now();
+      for (i = 0; i < BENCH_SIZE; i++) {
+         op = x86_get_byte(mem + i, BENCH_SIZE - i, x64 != 0);
+         sum += op;
+         nops += x86_remove_instr(op, mem + i, BENCH_SIZE - i, x64 != 0);
+      }
+      msg("span: x86-%s %6.2f ns per position (%u nops)\n", x64 ? "64" : "32", bench_ns(t0, BENCH_SIZE), nops);
+   }
+
+   for (be = 0; be < 2; be++) {
+      nops = 0;
+      t0 = bench_clock::now();
+      for (i = 0; i < BENCH_SIZE; i += 4) {
+         op = ppc_get_byte(mem + i, BENCH_SIZE - i, be != 0);
+         sum += op;
+         nops += ppc_remove_instr(op, mem + i, BENCH_SIZE - i, be != 0);
+      }
+      msg("span: ppc-%s %6.2f ns per word (%u nops)\n", be ? "be" : "le", bench_ns(t0, BENCH_SIZE / 4), nops);
+   }
+
+   delete [] mem;
+
+   // keeps the opcodes from being optimized out
+   return sum == 0xFFFFFFFF;
+}
@@ -0,0 +1,131 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// In memory netnodes for the tests of backup.cpp: named nodes holding blobs
+// and altvals, with the few calls of the IDA SDK the backup code makes.
+
+#ifndef __MOCK_NETNODE_H__
+#define __MOCK_NETNODE_H__
+
+#include "precomp.h"
+
+#include <string>
+#include <map>
+#include <vector>
+
+typedef uint32_t nodeidx_t;
+
+#define BADNODE ((nodeidx_t)-1)
+
+struct mnode_t {
+   std::string name;
+   std::map<std::pair<char, nodeidx_t>, std::string> blobs;
+   std::map<nodeidx_t, nodeidx_t> alts;
+};
+
+// nodes by number, never freed (killed nodes are only emptied). Node 0
+// stands for no node (altval of a missing index) and is not used.
+extern std::vector<mnode_t> mock_nodes;
+
+class netnode {
+   nodeidx_t id;
+
+   mnode_t &node() {
+      return mock_nodes[id];
+   }
+
+public:
+   netnode() : id(BADNODE) {}
+   netnode(nodeidx_t n) : id(n) {}
+
+   operator nodeidx_t() const {
+      return id;
+   }
+
+   bool create(const char *name) {
+      for (id = 0; id < mock_nodes.size(); id++) {
+         if (mock_nodes[id].name == name) {
+            return false;
+         }
+      }
+      mock_nodes.push_back(mnode_t());
+      mock_nodes.back().name = name;
+      return true;
+   }
+
+   bool create() {
+      id = (nodeidx_t)mock_nodes.size();
+      mock_nodes.push_back(mnode_t());
+      return true;
+   }
+
+   void kill() {
+      if (id < mock_nodes.size()) {
+         node() = mnode_t();
+      }
+   }
+
+   bool setblob(const void *buf, size_t size, nodeidx_t start, char tag) {
+      node().blobs[std::make_pair(tag, start)] = std::string((const char *)buf, size);
+      return true;
+   }
+
+   size_t blobsize(nodeidx_t start, char tag) {
+      std::map<std::pair<char, nodeidx_t>, std::string>::iterator it = node().blobs.find(std::make_pair(tag, start));
+
+      return it == node().blobs.end() ? 0 : it->second.size();
+   }
+
+   void *getblob(void *buf, size_t *size, nodeidx_t start, char tag) {
+      std::map<std::pair<char, nodeidx_t>, std::string>::iterator it = node().blobs.find(std::make_pair(tag, start));
+
+      if (it == node().blobs.end() || *size < it->second.size()) {
+         return NULL;
+      }
+      memcpy(buf, it->second.data(), it->second.size());
+      *size = it->second.size();
+      return buf;
+   }
+
+   nodeidx_t altval(nodeidx_t i) {
+      std::map<nodeidx_t, nodeidx_t>::iterator it = node().alts.find(i);
+
+      return it == node().alts.end() ? 0 : it->second;
+   }
+
+   void altset(nodeidx_t i, nodeidx_t v) {
+      node().alts[i] = v;
+   }
+
+   nodeidx_t altfirst() {
+      return node().alts.empty() ? BADNODE : node().alts.begin()->first;
+   }
+
+   nodeidx_t altnext(nodeidx_t i) {
+      std::map<nodeidx_t, nodeidx_t>::iterator it = node().alts.upper_bound(i);
+
+      return it == node().alts.end() ? BADNODE : it->first;
+   }
+};
+
+// the "Reuse" button
+inline int askbuttons_c(const char *, const char *, const char *, int, const char *) {
+   return 1;
+}
+
+#endif
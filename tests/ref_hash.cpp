@@ -0,0 +1,151 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Reference address hash table, as hash.cpp was before the robin hood
+// table. hash_free used to leak the bucket array: the reference frees it
+// so that the benchmark does not grow with every size.
+
+#include "precomp.h"
+
+#include "ref_hash.h"
+
+/*------------------------------------------------*/
+/* function : ref_hash_init                       */
+/* description: Initializes hash table to NULL    */
+/*------------------------------------------------*/
+
+ref_hpsig_t *ref_hash_init(size_t num) {
+   unsigned int i;
+   ref_hpsig_t *hsig;
+   static unsigned int primes[] = { 67, 251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521, 131071, 262139, 524287, 1048573, 2097143 };
+
+   for (i = 0; i < ((sizeof(primes) / sizeof(unsigned int)) - 1); i++) {
+      if (primes[i] > (num/3)) {
+         break;
+      }
+   }
+   hsig = new ref_hpsig_t();
+   if (!hsig) {
+      return NULL;
+   }
+   hsig->max_hash = primes[i];
+   hsig->table = new ref_hsignature_t *[hsig->max_hash];
+   if (!hsig->table) {
+      delete hsig;
+      return NULL;
+   }
+
+   for (i = 0; i < hsig->max_hash; i++) {
+      hsig->table[i] = NULL;
+   }
+   return hsig;
+}
+
+/*------------------------------------------------*/
+/* function : ref_hash_mk_ea                      */
+/* description: Creates hash value                */
+/*------------------------------------------------*/
+
+unsigned int ref_hash_mk_ea(ref_hpsig_t *htable, ea_t val) {
+   char *ptr;
+   unsigned int h = 0;
+   size_t i;
+
+   ptr = (char *) &val;
+
+   for (i = 0; i < sizeof(val); i++) {
+      h += ptr[i];
+      h += ( h << 10 );
+      h ^= ( h >> 6 );
+   }
+
+   h += ( h << 3);
+   h ^= ( h >> 11 );
+   h += ( h >> 15 );
+
+   return h % htable->max_hash;
+}
+
+/*------------------------------------------------*/
+/* function : ref_hash_add_ea                     */
+/* description: Adds element to the hash table    */
+/*------------------------------------------------*/
+
+int ref_hash_add_ea(ref_hpsig_t *htable, sig_t *sig) {
+   int id = ref_hash_mk_ea(htable, sig->startEA);
+   ref_hsignature_t *hsig = NULL;
+
+   hsig = new ref_hsignature_t();
+   if (!hsig) {
+      return -1;
+   }
+   hsig->sig = sig;
+   hsig->next = htable->table[id];
+   htable->table[id] = hsig;
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : ref_hash_find_ea                    */
+/* description: Finds element in the hash table   */
+/*------------------------------------------------*/
+
+sig_t *ref_hash_find_ea(ref_hpsig_t *htable, ea_t ea) {
+   if (ea == BADADDR) {
+      return NULL;
+   }
+   int id = ref_hash_mk_ea(htable, ea);
+   ref_hsignature_t *hsig;
+
+   hsig = htable->table[id];
+
+   while (hsig != NULL) {
+      if (hsig->sig->startEA == ea) {
+         return hsig->sig;
+      }
+      hsig = hsig->next;
+   }
+
+   return NULL;
+}
+
+/*------------------------------------------------*/
+/* function : ref_hash_free                       */
+/* description: Frees hash table                  */
+/*------------------------------------------------*/
+
+void ref_hash_free(ref_hpsig_t *htable) {
+   unsigned int i;
+   ref_hsignature_t *hsig, *tmp;
+
+   for (i = 0; i < htable->max_hash; i++) {
+      hsig = htable->table[i];
+
+      while (hsig != NULL) {
+         tmp = hsig->next;
+         delete hsig;
+
+         hsig = tmp;
+      }
+   }
+
+   delete [] htable->table;
+   delete htable;
+}
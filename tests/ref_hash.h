@@ -0,0 +1,46 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __REF_HASH_H__
+#define __REF_HASH_H__
+
+#include "precomp.h"
+#include "sig.h"
+
+// Reference address hash table: the prime sized chained table with a one
+// at a time hash that hash.cpp replaced. bench_hash times it against the
+// current table.
+
+struct ref_hsignature_t {
+   sig_t *sig;
+   ref_hsignature_t *next;
+};
+
+struct ref_hpsig_t {
+   unsigned int max_hash;
+   ref_hsignature_t **table;
+};
+
+ref_hpsig_t *ref_hash_init(size_t);
+unsigned int ref_hash_mk_ea(ref_hpsig_t *, ea_t);
+int ref_hash_add_ea(ref_hpsig_t *, sig_t *);
+sig_t *ref_hash_find_ea(ref_hpsig_t *, ea_t);
+void ref_hash_free(ref_hpsig_t *);
+
+#endif
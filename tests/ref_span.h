@@ -0,0 +1,65 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __REF_SPAN_H__
+#define __REF_SPAN_H__
+
+#include "precomp.h"
+#include "patchdiff.h"
+
+// Mocked database of the reference heuristics: ref_len bytes at address 0,
+// the other addresses read as 0xFF (as get_byte on a missing byte).
+
+extern const unsigned char *ref_mem;
+extern size_t ref_len;
+extern bool ref_be;      // PPC words are big endian
+extern cpu_t ref_cpu;
+
+inline unsigned char ref_get_byte(ea_t ea) {
+   return ea < ref_len ? ref_mem[ea] : 0xFF;
+}
+
+inline unsigned short ref_get_word(ea_t ea) {
+   if (ref_be) {
+      return (ref_get_byte(ea) << 8) | ref_get_byte(ea + 1);
+   }
+   return ref_get_byte(ea) | (ref_get_byte(ea + 1) << 8);
+}
+
+inline uint32_t ref_get_long(ea_t ea) {
+   if (ref_be) {
+      return ((uint32_t)ref_get_word(ea) << 16) | ref_get_word(ea + 2);
+   }
+   return ref_get_word(ea) | ((uint32_t)ref_get_word(ea + 2) << 16);
+}
+
+inline ea_t ref_get_item_end(ea_t ea) {
+   return ea + 1;
+}
+
+unsigned char ref_x86_get_byte(ea_t);
+bool ref_x86_remove_instr(unsigned char, ea_t);
+bool ref_x86_is_end_block(ea_t);
+bool ref_x86_is_direct_jump(ea_t);
+ea_t ref_x86_get_fake_jump(ea_t);
+int ref_x86_is_cond_jump_pos(ea_t);
+
+unsigned char ref_ppc_get_byte(ea_t);
+bool ref_ppc_remove_instr(unsigned char, ea_t);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Saves diff results to in memory netnodes (tests/mock/netnode.h) and loads
+// them back: the version 4 backup must give the same lists, stored in a few
+// compressed blobs per list, and saving again must replace the old backup.
+// The loaded lists read their entries on demand: rows can be removed and
+// moved before they are loaded, and a damaged chunk only loses its rows.
+
+#include "precomp.h"
+
+#include "mock/netnode.h"
+
+// backup.cpp is built here, after the netnode mock
+#include "backup.cpp"
+
+#define TEST_PAIRS   40000
+#define TEST_SINGLES 30000
+
+#define TEST_CHECK(x) \
+   if (!(x)) { \
+      msg("backup: line %d: %s\n", __LINE__, #x); \
+      return 1; \
+   }
+
+std::vector<mnode_t> mock_nodes(1);
+
+options_t::options_t(pd_plugmod_t *) : ipc(false), save_db(true), sig_cache(false), threads(1), diff_threads(1), graph_cache(0) {}
+
+options_t::~options_t() {}
+
+/*------------------------------------------------*/
+/* function : pget_func_name                      */
+/* description: Names the functions of the IDB    */
+/*------------------------------------------------*/
+
+char *pget_func_name(ea_t ea, char *buffer, size_t blen) {
+   qsnprintf(buffer, blen, "fct_%X", (uint32_t)ea);
+   return buffer;
+}
+
+/*------------------------------------------------*/
+/* function : test_sig                            */
+/* description: Creates the sig of function i of  */
+/*              a file                            */
+/*------------------------------------------------*/
+
+static sig_t *test_sig(uint32_t i, int nfile) {
+   char name[32];
+   sig_t *sig;
+   uint32_t k;
+
+   sig = new sig_t();
+   sig->startEA = (nfile == 1 ? 0x401000 : 0x801000) + i * 0x20;
+   if (nfile == 1) {
+      pget_func_name(sig->startEA, name, sizeof(name));
+   }
+   else if (i % 4) {
+      qsnprintf(name, sizeof(name), "sub_%X", (uint32_t)sig->startEA);
+   }
+   else {
+      qsnprintf(name, sizeof(name), "named_%u", i);
+   }
+   sig->set_name(name);
+   sig->nfile = nfile;
+   sig->mtype = DIFF_UNMATCHED;
+   sig->id_crc = i % 3;
+   sig->sig = i * 7;
+   sig->hash = i % 11;
+   sig->crc_hash = i * 0x9E3779B1;
+   sig->str_hash = i % 5 ? 0 : i;
+   sig->flag = i % 2;
+   sig->lines = 2 + i % 50;
+   for (k = 0; k < i % 6; k++) {
+      sig->add_sref(0x401000 + ((i + k * 13) % TEST_PAIRS) * 0x20, k % 2, CHECK_REF);
+   }
+
+   return sig;
+}
+
+/*------------------------------------------------*/
+/* function : test_engine                         */
+/* description: Builds the result lists of a diff */
+/*------------------------------------------------*/
+
+static deng_t *test_engine(options_t *opt) {
+   deng_t *eng;
+   sig_t *s1, *s2;
+   uint32_t i;
+
+   eng = new deng_t(opt);
+   eng->opt = opt;
+   eng->mlist = new slist_t(0, "file.sig");
+   eng->ilist = new slist_t(0, "file.sig");
+   eng->ulist = new slist_t(0, "file.sig");
+
+   for (i = 0; i < TEST_PAIRS; i++) {
+      s1 = test_sig(i, 1);
+      s2 = test_sig(i, 2);
+      s1->set_matched_sig(s2, i % 3 ? DIFF_EQUAL_SIG_HASH : DIFF_NEQUAL_SUCC);
+      if (i % 3) {
+         eng->ilist->add(s1);
+      }
+      else {
+         eng->mlist->add(s1);
+      }
+   }
+   for (i = 0; i < TEST_SINGLES; i++) {
+      eng->ulist->add(test_sig(TEST_PAIRS + i, 1 + i % 2));
+   }
+
+   return eng;
+}
+
+/*------------------------------------------------*/
+/* function : test_same_sig                       */
+/* description: Compares the saved fields of two  */
+/*              sigs                              */
+/*------------------------------------------------*/
+
+static bool test_same_sig(sig_t *a, sig_t *b) {
+   fref_t *fa, *fb;
+
+   if (!a || !b) {
+      return a == b;
+   }
+
+   if (a->startEA != b->startEA || a->mtype != b->mtype || a->id_crc != b->id_crc
+         || a->nfile != b->nfile || a->sig != b->sig || a->hash != b->hash
+         || a->crc_hash != b->crc_hash || a->str_hash != b->str_hash
+         || a->flag != b->flag || a->lines != b->lines || a->name != b->name) {
+      return false;
+   }
+
+   // the references are read back in reverse order
+   if ((a->srefs ? a->srefs->num : 0) != (b->srefs ? b->srefs->num : 0)) {
+      return false;
+   }
+   for (fa = a->srefs ? a->srefs->list : NULL; fa; fa = fa->next) {
+      for (fb = b->srefs->list; fb; fb = fb->next) {
+         if (fa->ea == fb->ea && fa->type == fb->type) {
+            break;
+         }
+      }
+      if (!fb) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : test_same                           */
+/* description: Compares the result lists of two  */
+/*              engines                           */
+/*------------------------------------------------*/
+
+static int test_same(deng_t *e1, deng_t *e2) {
+   slist_t *l1[3] = { e1->mlist, e1->ilist, e1->ulist };
+   slist_t *l2[3] = { e2->mlist, e2->ilist, e2->ulist };
+   sig_t *a, *b;
+   uint32_t i, j;
+
+   for (j = 0; j < 3; j++) {
+      TEST_CHECK(l1[j]->num == l2[j]->num);
+      for (i = 0; i < l1[j]->num; i++) {
+         a = l1[j]->get(i);
+         b = l2[j]->get(i);
+         TEST_CHECK(test_same_sig(a, b));
+         TEST_CHECK(test_same_sig(a->msig, b->msig));
+         TEST_CHECK(!b->msig || b->msig->msig == b);
+      }
+   }
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : test_blobs                          */
+/* description: Returns the number of blobs and   */
+/*              their size                        */
+/*------------------------------------------------*/
+
+static size_t test_blobs(size_t *size) {
+   std::map<std::pair<char, nodeidx_t>, std::string>::iterator it;
+   size_t i, n = 0;
+
+   *size = 0;
+   for (i = 0; i < mock_nodes.size(); i++) {
+      for (it = mock_nodes[i].blobs.begin(); it != mock_nodes[i].blobs.end(); ++it) {
+         *size += it->second.size();
+         n++;
+      }
+   }
+
+   return n;
+}
+
+/*------------------------------------------------*/
+/* function : test_index                          */
+/* description: Reads the index of a saved list   */
+/*------------------------------------------------*/
+
+static bool test_index(const char *name, bkindex_t *hdr, std::vector<bkchunk_t> &chunks) {
+   netnode node;
+   uchar *index;
+   size_t size;
+
+   node.create(name);
+   index = backup_get_blob(node, 0, 'I', &size);
+   if (!index || size < sizeof(*hdr)) {
+      delete [] index;
+      return false;
+   }
+
+   memcpy(hdr, index, sizeof(*hdr));
+   chunks.resize(hdr->nchunks);
+   if (hdr->nchunks) {
+      memcpy(&chunks[0], index + sizeof(*hdr), hdr->nchunks * sizeof(bkchunk_t));
+   }
+   delete [] index;
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : test_loaded                         */
+/* description: Returns the number of entries     */
+/*              loaded in a list                  */
+/*------------------------------------------------*/
+
+static uint32_t test_loaded(slist_t *sl) {
+   uint32_t i, n = 0;
+
+   for (i = 0; i < sl->num; i++) {
+      if (sl->sigs[i]) {
+         n++;
+      }
+   }
+
+   return n;
+}
+
+/*------------------------------------------------*/
+/* function : test_lazy                           */
+/* description: Checks the on demand loading of   */
+/*              the lists saved from eng          */
+/*------------------------------------------------*/
+
+static int test_lazy(deng_t *eng, options_t *opt) {
+   std::vector<bkchunk_t> chunks;
+   std::string *blob;
+   deng_t *l = NULL;
+   bkindex_t hdr;
+   uint32_t id, n;
+   sig_t *sig;
+
+   TEST_CHECK(backup_load_results(&l, opt) == 1 && l);
+   TEST_CHECK(l->mlist->lazy && l->ilist->lazy && l->ulist->lazy);
+   TEST_CHECK(test_loaded(l->mlist) == 0 && test_loaded(l->ulist) == 0);
+
+   // only the row asked for is read
+   n = l->mlist->num - 1;
+   TEST_CHECK(test_same_sig(l->mlist->get(n), eng->mlist->get(n)));
+   TEST_CHECK(test_loaded(l->mlist) == 1 && (uint32_t)l->mlist->sigs[n]->node == n);
+
+   // rows removed or moved before they are loaded (same changes on eng)
+   id = 2;
+   l->mlist->remove(1);
+   TEST_CHECK(l->mlist->move(l->ilist, &id, 1) == 1);
+   l->mlist->pack();
+   l->ilist->pack();
+   eng->mlist->remove(1);
+   eng->mlist->move(eng->ilist, &id, 1);
+   eng->mlist->pack();
+   eng->ilist->pack();
+   TEST_CHECK(test_loaded(l->mlist) == 1 && test_loaded(l->ilist) == 1);
+   if (test_same(eng, l)) {
+      return 1;
+   }
+
+   // load_all drops the source
+   l->ulist->load_all();
+   TEST_CHECK(!l->ulist->lazy && !l->ulist->ids && test_loaded(l->ulist) == l->ulist->num);
+   delete l;
+   l = NULL;
+
+   // a damaged chunk: its rows are dropped, the other ones still load
+   TEST_CHECK(test_index("$ pdiff2_unmatched", &hdr, chunks) && hdr.nchunks > 1);
+   blob = NULL;
+   for (n = 0; n < mock_nodes.size(); n++) {
+      if (mock_nodes[n].name == "$ pdiff2_unmatched") {
+         blob = &mock_nodes[n].blobs[std::make_pair('C', (nodeidx_t)1 << BACKUP_CHUNK_SHIFT)];
+      }
+   }
+   TEST_CHECK(blob && !blob->empty());
+   blob->resize(blob->size() / 2);
+
+   TEST_CHECK(backup_load_results(&l, opt) == 1 && l);
+   TEST_CHECK(l->ulist->get(chunks[1].first) == NULL && l->ulist->holes == 1);
+   sig = l->ulist->get(0);
+   TEST_CHECK(test_same_sig(sig, eng->ulist->get(0)));
+   l->ulist->load_all();
+   TEST_CHECK(l->ulist->num == eng->ulist->num - chunks[1].num);
+   delete l;
+
+   return 0;
+}
+
+int main() {
+   options_t opt(NULL);
+   deng_t *eng, *l1 = NULL, *l2 = NULL;
+   std::vector<bkchunk_t> chunks;
+   bkindex_t hdr;
+   size_t i, nblobs, size, raw = 0, packed = 0;
+
+   eng = test_engine(&opt);
+   backup_save_results(eng);
+
+   // one engine blob, and an index and a few chunks per list
+   nblobs = test_blobs(&size);
+   TEST_CHECK(nblobs < 20);
+   TEST_CHECK(test_index("$ pdiff2_unmatched", &hdr, chunks));
+   TEST_CHECK(hdr.num == TEST_SINGLES && hdr.nchunks > 1);
+   TEST_CHECK(test_index("$ pdiff2_identical", &hdr, chunks));
+   TEST_CHECK(hdr.num == eng->ilist->num && hdr.nchunks > 1);
+   for (i = 0; i < chunks.size(); i++) {
+      TEST_CHECK(chunks[i].raw_size <= BACKUP_CHUNK_SIZE + BACKUP_ENTRY_SIZE);
+      TEST_CHECK(chunks[i].packed_size <= chunks[i].raw_size);
+      TEST_CHECK(i == 0 || chunks[i].first == chunks[i - 1].first + chunks[i - 1].num);
+      raw += chunks[i].raw_size;
+      packed += chunks[i].packed_size;
+   }
+   TEST_CHECK(packed < raw);
+
+   TEST_CHECK(backup_load_results(&l1, &opt) == 1 && l1);
+   if (test_same(eng, l1)) {
+      return 1;
+   }
+
+   // saving again replaces the previous backup
+   backup_save_results(l1);
+   TEST_CHECK(test_blobs(&size) == nblobs);
+   TEST_CHECK(backup_load_results(&l2, &opt) == 1 && l2);
+   if (test_same(eng, l2)) {
+      return 1;
+   }
+
+   if (test_lazy(eng, &opt)) {
+      return 1;
+   }
+
+   msg("backup: %u entries in %u blobs, %u bytes (chunks packed to %u%%)\n",
+       (uint32_t)(TEST_PAIRS + TEST_SINGLES), (uint32_t)nblobs, (uint32_t)size, (uint32_t)(packed * 100 / raw));
+
+   // frees the lists and their file 1 sigs, as in the plugin
+   delete eng;
+   delete l1;
+   delete l2;
+
+   return 0;
+}
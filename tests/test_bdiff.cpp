@@ -0,0 +1,322 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs the block diff of the matched functions on synthetic block lists:
+// the second lists go through a batch stream, as sent back by the second
+// instance. Every pair must get its removed, added and changed blocks,
+// the pairs that could not be parsed must be left out, and the file must
+// be ranked by decreasing score. The pair diffs only run on several
+// threads when the diff threads option asks for it, with the same file.
+
+#include "precomp.h"
+
+#include <map>
+#include <string>
+
+#include "bdiff.h"
+#include "parser.h"
+#include "system.h"
+#include "sigfile.h"
+#include "options.h"
+
+#define TEST_PAIRS  64
+#define TEST_FAIL1  9     // first function is not parsed
+#define TEST_FAIL2  5     // second function has no blocks
+#define TEST_BASE1  0x401000
+#define TEST_BASE2  0x801000
+#define TEST_FSIZE  0x1000
+#define TEST_CHUNK  777   // stream piece size (entries span pieces)
+#define TEST_FILE   "test_bdiff.txt"
+#define TEST_FILE_MT "test_bdiff_mt.txt"
+#define TEST_THREADS 4
+
+#define TEST_CHECK(x) \
+   if (!(x)) { \
+      msg("bdiff: line %d: %s\n", __LINE__, #x); \
+      return 1; \
+   }
+
+options_t::options_t(pd_plugmod_t *) : ipc(false), save_db(true), sig_cache(false), threads(1), diff_threads(1), graph_cache(0) {}
+
+options_t::~options_t() {}
+
+int options_t::options_diff_threads() {
+   return diff_threads;
+}
+
+/*------------------------------------------------*/
+/* function : test_rand                           */
+/* description: Returns a hash of an index and a  */
+/*              salt                              */
+/*------------------------------------------------*/
+
+static uint32_t test_rand(size_t i, uint32_t salt) {
+   uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ULL + salt;
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+
+   return (uint32_t)h;
+}
+
+// changes of the second function of pair p
+static uint32_t test_blocks(size_t p)  { return 8 + p % 13; }
+static uint32_t test_removed(size_t p) { return p % 3; }
+static uint32_t test_added(size_t p)   { return p % 4; }
+static uint32_t test_changed(size_t p) { return p % 5; }
+
+/*------------------------------------------------*/
+/* function : test_block                          */
+/* description: Returns a block of pair p         */
+/*------------------------------------------------*/
+
+static sig_t *test_block(ea_t ea, size_t id, bool changed) {
+   sig_t *sig = new sig_t();
+
+   sig->set_start(ea);
+   sig->sig = test_rand(id, 1);
+   sig->hash = test_rand(id, 2);
+   sig->crc_hash = test_rand(id, 3) + (changed ? 1 : 0);
+   sig->lines = 1 + id % 7;
+
+   return sig;
+}
+
+/*------------------------------------------------*/
+/* function : test_list                           */
+/* description: Returns the block list of pair p  */
+/*              in file 1 or 2                    */
+/*------------------------------------------------*/
+
+static slist_t *test_list(size_t p, int file) {
+   ea_t ea = (file == 1 ? TEST_BASE1 : TEST_BASE2) + p * TEST_FSIZE;
+   uint32_t n = test_blocks(p), j;
+   slist_t *sl;
+
+   sl = new slist_t(n + 4, NULL);
+   if (file == 2 && p == TEST_FAIL2) {
+      return sl;
+   }
+
+   if (file == 1) {
+      for (j = 0; j < n; j++) {
+         sl->add(test_block(ea + j * 0x10, p * 64 + j, false));
+      }
+   }
+   else {
+      for (j = 0; j < n - test_removed(p); j++) {
+         sl->add(test_block(ea + j * 0x10, p * 64 + j, j < test_changed(p)));
+      }
+      for (j = 0; j < test_added(p); j++) {
+         sl->add(test_block(ea + (n + j) * 0x10, p * 64 + 32 + j, false));
+      }
+   }
+   sl->sort();
+
+   return sl;
+}
+
+/*------------------------------------------------*/
+/* function : parse_fcts                          */
+/* description: Parses the first functions (mock) */
+/*------------------------------------------------*/
+
+slist_t **parse_fcts(const ea_t *eas, size_t num, char, options_t *) {
+   slist_t **lists = new slist_t *[num];
+   size_t i, p;
+
+   for (i = 0; i < num; i++) {
+      p = (eas[i] - TEST_BASE1) / TEST_FSIZE;
+      lists[i] = p == TEST_FAIL1 ? NULL : test_list(p, 1);
+   }
+
+   return lists;
+}
+
+/*------------------------------------------------*/
+/* function : system_parse_fcts                   */
+/* description: Parses the second functions       */
+/*              through a batch stream (mock of   */
+/*              the second instance)              */
+/*------------------------------------------------*/
+
+slist_t **system_parse_fcts(ea_t *eas, uint32_t num, const char *, options_t *) {
+   std::string data;
+   sfshdr_t hdr;
+   sfstream_t st;
+   slist_t *sl, **lists, **ret;
+   ea_t *leas;
+   uint64_t sep[2];
+   uint32_t nlists, len, i, j;
+   uchar *buf;
+   size_t pos;
+
+   memcpy(hdr.magic, SFSTREAM_MAGIC, sizeof(hdr.magic));
+   hdr.version = SFSTREAM_VERSION;
+   hdr.ea_size = sizeof(ea_t);
+   hdr.flags = SFSTREAM_BATCH;
+   data.append((const char *)&hdr, sizeof(hdr));
+
+   // as run_second_batch
+   for (i = 0; i < num; i++) {
+      sep[0] = sizeof(uint64_t);
+      sep[1] = (uint64_t)eas[i];
+      data.append((const char *)sep, sizeof(sep));
+
+      sl = test_list((eas[i] - TEST_BASE2) / TEST_FSIZE, 2);
+      for (j = 0; j < sl->num; j++) {
+         buf = sigfile_pack(sl->sigs[j], &len);
+         data.append((const char *)buf, len);
+         delete [] buf;
+      }
+      sl->free_sigs();
+      delete sl;
+   }
+
+   for (pos = 0; pos < data.size(); pos += TEST_CHUNK) {
+      if (!st.feed(data.data() + pos, qmin((size_t)TEST_CHUNK, data.size() - pos))) {
+         return NULL;
+      }
+   }
+
+   lists = st.finish_batch(&leas, &nlists);
+   if (!lists) {
+      return NULL;
+   }
+
+   // as the real one: empty lists are parsing failures
+   ret = new slist_t *[num];
+   for (i = 0; i < nlists; i++) {
+      if (nlists == num && leas[i] == eas[i] && lists[i]->num) {
+         ret[i] = lists[i];
+         continue;
+      }
+      if (i < num) {
+         ret[i] = NULL;
+      }
+      lists[i]->free_sigs();
+      delete lists[i];
+   }
+   for (; i < num; i++) {
+      ret[i] = NULL;
+   }
+   free(lists);
+   free(leas);
+
+   return ret;
+}
+
+/*------------------------------------------------*/
+/* function : test_read                           */
+/* description: Returns the content of file       */
+/*------------------------------------------------*/
+
+static std::string test_read(const char *file) {
+   std::string data;
+   char buf[4096];
+   size_t n;
+   FILE *fp;
+
+   fp = fopen(file, "rb");
+   if (!fp) {
+      return data;
+   }
+   while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      data.append(buf, n);
+   }
+   fclose(fp);
+
+   return data;
+}
+
+int main() {
+   options_t opt(NULL);
+   std::map<ea_t, size_t> pairs;
+   deng_t *eng;
+   slist_t *ml;
+   sig_t *sig;
+   char line[256], name1[64], name2[64];
+   uint32_t score, added, removed, changed, blocks1, blocks2, ea1, ea2;
+   uint32_t last_score = 0xffffffff, last_ea = 0;
+   size_t p, lines = 0;
+   FILE *fp;
+
+   ml = new slist_t(TEST_PAIRS, NULL);
+   for (p = 0; p < TEST_PAIRS; p++) {
+      sig = new sig_t();
+      sig->set_start(TEST_BASE1 + p * TEST_FSIZE);
+      qsnprintf(name1, sizeof(name1), "fct_%u", (uint32_t)p);
+      sig->set_name(name1);
+      sig->msig = new sig_t();
+      sig->msig->set_start(TEST_BASE2 + p * TEST_FSIZE);
+      sig->msig->set_name(name1);
+      ml->add(sig);
+      pairs[sig->startEA] = p;
+   }
+
+   eng = new deng_t(&opt);
+   eng->opt = &opt;
+   eng->mlist = ml;
+
+   TEST_CHECK(bdiff_matched(eng, TEST_FILE) == 0);
+   opt.diff_threads = TEST_THREADS;
+   TEST_CHECK(bdiff_matched(eng, TEST_FILE_MT) == 0);
+   TEST_CHECK(test_read(TEST_FILE) == test_read(TEST_FILE_MT));
+   remove(TEST_FILE_MT);
+
+   fp = fopen(TEST_FILE, "r");
+   TEST_CHECK(fp != NULL);
+   TEST_CHECK(fgets(line, sizeof(line), fp) && line[0] == '#');
+   while (fgets(line, sizeof(line), fp)) {
+      TEST_CHECK(sscanf(line, "%u %u %u %u %u %u %x %x %63s %63s", &score, &added, &removed, &changed,
+                        &blocks1, &blocks2, &ea1, &ea2, name1, name2) == 10);
+      TEST_CHECK(pairs.count(ea1));
+      p = pairs[ea1];
+      pairs.erase(ea1);
+      TEST_CHECK(p != TEST_FAIL1 && p != TEST_FAIL2);
+      TEST_CHECK(ea2 == TEST_BASE2 + p * TEST_FSIZE);
+      TEST_CHECK(!strcmp(name1, name2));
+      TEST_CHECK(blocks1 == test_blocks(p));
+      TEST_CHECK(blocks2 == test_blocks(p) - test_removed(p) + test_added(p));
+      TEST_CHECK(added == test_added(p));
+      TEST_CHECK(removed == test_removed(p));
+      TEST_CHECK(changed == test_changed(p));
+      TEST_CHECK(score == added + removed + changed);
+      TEST_CHECK(score < last_score || (score == last_score && ea1 > last_ea));
+      last_score = score;
+      last_ea = ea1;
+      lines++;
+   }
+   fclose(fp);
+   remove(TEST_FILE);
+
+   TEST_CHECK(lines == TEST_PAIRS - 2);
+   TEST_CHECK(pairs.size() == 2 && pairs.count(TEST_BASE1 + TEST_FAIL1 * TEST_FSIZE) && pairs.count(TEST_BASE1 + TEST_FAIL2 * TEST_FSIZE));
+
+   msg("bdiff: %u pairs ranked, 2 parsing failures left out, same file with %u threads\n", (uint32_t)lines, (uint32_t)TEST_THREADS);
+
+   // the second functions are not owned by the list
+   for (p = 0; p < ml->num; p++) {
+      delete ml->sigs[p]->msig;
+      ml->sigs[p]->msig = NULL;
+   }
+   delete eng;
+
+   return 0;
+}
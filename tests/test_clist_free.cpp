@@ -0,0 +1,90 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Destroys a heap allocated clist_t of 1M elements on a thread with a small
+// stack: freeing the chained lists recursively overflows it.
+
+#include "precomp.h"
+
+#include <pthread.h>
+
+#include "sig.h"
+#include "clist.h"
+#include "diff.h"
+
+#define TEST_NUM   1000000
+#define TEST_STACK (256 * 1024)
+
+/*------------------------------------------------*/
+/* function : test_free                           */
+/* description: Deletes the list (thread entry)   */
+/*------------------------------------------------*/
+
+static void *test_free(void *arg) {
+   delete (clist_t *)arg;
+   return NULL;
+}
+
+int main() {
+   slist_t *sl;
+   clist_t *cl;
+   sig_t *sig;
+   dpsig_t *ds, *next;
+   pthread_attr_t attr;
+   pthread_t th;
+   uint32_t i;
+
+   sl = new slist_t(TEST_NUM, NULL);
+   for (i = 0; i < TEST_NUM; i++) {
+      sig = new sig_t();
+      sig->startEA = 0x1000 + i * 16;
+      sig->sig = i % 5000;
+      sig->hash = i % 7;
+      sig->crc_hash = i;
+      sl->add(sig);
+   }
+
+   // not pooled: the destructor frees the elements
+   cl = new clist_t(sl, NULL);
+
+   // every other element goes to the matched lists
+   for (ds = cl->sigs, i = 0; ds; ds = next, i++) {
+      next = ds->next;
+      if (i & 1) {
+         cl->remove(ds);
+      }
+   }
+
+   pthread_attr_init(&attr);
+   pthread_attr_setstacksize(&attr, TEST_STACK);
+   if (pthread_create(&th, &attr, test_free, cl) != 0) {
+      msg("clist_free: pthread_create failed\n");
+      return 1;
+   }
+   pthread_join(th, NULL);
+   pthread_attr_destroy(&attr);
+
+   for (i = 0; i < sl->num; i++) {
+      sl->sigs[i]->nodes = NULL;
+   }
+   sl->free_sigs();
+   delete sl;
+
+   msg("clist_free: %u elements freed\n", TEST_NUM);
+   return 0;
+}
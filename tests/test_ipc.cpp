@@ -0,0 +1,253 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs the unix IPC channel between this process and a copy of it started
+// as the second instance: messages of every size are echoed back, a long
+// signature stream is pipelined with acknowledgments, an idle wait must
+// not burn CPU and a second instance exiting without answering must be
+// detected. Prints the round trip time and the stream throughput.
+
+#include "precomp.h"
+
+#include <sys/resource.h>
+#include <chrono>
+
+#include "system.h"
+#include "unix_fct.h"
+
+#define TEST_ECHOS   2000
+#define TEST_CHUNKS  512     // streamed chunks (32 MB)
+#define TEST_IDLE    500     // ms the second instance waits before answering
+
+// commands of the second instance
+#define TEST_ECHO    IPC_DATA
+#define TEST_STREAM  IPC_SIGS
+#define TEST_WAIT    IPC_DONE
+#define TEST_EXIT    IPC_END
+
+#define TEST_CHECK(x) \
+   if (!(x)) { \
+      msg("ipc: line %d: %s\n", __LINE__, #x); \
+      return 1; \
+   }
+
+static idata_t test_data;
+static idata_t test_ack;
+
+/*------------------------------------------------*/
+/* function : test_rand                           */
+/* description: Returns a hash of an index and a  */
+/*              salt                              */
+/*------------------------------------------------*/
+
+static uint32_t test_rand(size_t i, uint32_t salt) {
+   uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ULL + salt;
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+
+   return (uint32_t)h;
+}
+
+/*------------------------------------------------*/
+/* function : test_fill                           */
+/* description: Fills message i with len bytes    */
+/*------------------------------------------------*/
+
+static void test_fill(idata_t *d, long cmd, size_t i, long len) {
+   long j;
+
+   d->cmd = cmd;
+   d->len = len;
+   for (j = 0; j < len; j++) {
+      d->data[j] = (char)test_rand(i, (uint32_t)j);
+   }
+}
+
+/*------------------------------------------------*/
+/* function : test_same                           */
+/* description: Checks the bytes of message i     */
+/*------------------------------------------------*/
+
+static bool test_same(idata_t *d, size_t i, long len) {
+   long j;
+
+   if (d->len != len) {
+      return false;
+   }
+   for (j = 0; j < len; j++) {
+      if (d->data[j] != (char)test_rand(i, (uint32_t)j)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : test_cpu                            */
+/* description: Returns the CPU time used (ms)    */
+/*------------------------------------------------*/
+
+static double test_cpu() {
+   struct rusage ru;
+
+   getrusage(RUSAGE_SELF, &ru);
+
+   return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+/*------------------------------------------------*/
+/* function : test_second                         */
+/* description: Runs the second instance side     */
+/*------------------------------------------------*/
+
+static int test_second(long pid) {
+   void *ipc;
+   uint32_t i, n;
+   int pending;
+
+   if (!os_ipc_init(&ipc, pid, IPC_CLIENT)) {
+      return 1;
+   }
+
+   while (os_ipc_recv(ipc, IPC_CLIENT, &test_data)) {
+      switch (test_data.cmd) {
+         case TEST_ECHO:
+            test_data.cmd = IPC_DONE;
+            os_ipc_send(ipc, IPC_CLIENT, &test_data);
+            break;
+         case TEST_WAIT:
+            usleep(TEST_IDLE * 1000);
+            test_data.cmd = IPC_DONE;
+            test_data.len = 0;
+            os_ipc_send(ipc, IPC_CLIENT, &test_data);
+            break;
+         case TEST_STREAM:
+            // as ipc_stream_sig: up to IPC_WINDOW chunks in flight
+            memcpy(&n, test_data.data, sizeof(n));
+            pending = 0;
+            for (i = 0; i < n; i++) {
+               test_fill(&test_data, IPC_SIGS, i, sizeof(test_data.data));
+               os_ipc_send(ipc, IPC_CLIENT, &test_data);
+               if (++pending >= IPC_WINDOW) {
+                  os_ipc_recv(ipc, IPC_CLIENT, &test_ack);
+                  pending--;
+               }
+            }
+            while (pending--) {
+               os_ipc_recv(ipc, IPC_CLIENT, &test_ack);
+            }
+            test_data.cmd = IPC_DONE;
+            test_data.len = 0;
+            os_ipc_send(ipc, IPC_CLIENT, &test_data);
+            break;
+         case TEST_EXIT:
+            // leaves without answering
+            return 0;
+      }
+   }
+
+   return 1;
+}
+
+int main(int argc, char **argv) {
+   std::chrono::steady_clock::time_point t0, t1;
+   double rtt, stream, idle, cpu;
+   char cmd[QMAXPATH + 64];
+   void *ipc;
+   long pid;
+   uint32_t n;
+   size_t i;
+   long len;
+
+   if (argc > 2) {
+      return test_second(atol(argv[2]));
+   }
+
+   pid = os_get_pid();
+   TEST_CHECK(os_ipc_init(&ipc, pid, IPC_SERVER));
+   qsnprintf(cmd, sizeof(cmd), "exec %s second %ld", argv[0], pid);
+   TEST_CHECK(os_execute_command(cmd, false, ipc) == 0);
+
+   // every size, only the used part is sent
+   t0 = std::chrono::steady_clock::now();
+   for (i = 0; i < TEST_ECHOS; i++) {
+      len = i < 2 ? (long)(i * IPC_DATA_SIZE) : (long)(test_rand(i, 1) % (i % 4 ? 256 : IPC_DATA_SIZE + 1));
+      test_fill(&test_data, TEST_ECHO, i, len);
+      TEST_CHECK(os_ipc_send(ipc, IPC_SERVER, &test_data));
+      TEST_CHECK(os_ipc_recv(ipc, IPC_SERVER, &test_data));
+      TEST_CHECK(test_data.cmd == IPC_DONE);
+      TEST_CHECK(test_same(&test_data, i, len));
+   }
+   t1 = std::chrono::steady_clock::now();
+   rtt = std::chrono::duration<double, std::micro>(t1 - t0).count() / TEST_ECHOS;
+
+   test_data.cmd = IPC_DATA;
+   test_data.len = IPC_DATA_SIZE + 1;
+   TEST_CHECK(!os_ipc_send(ipc, IPC_SERVER, &test_data));
+
+   // the stream chunks must come in order, whole
+   n = TEST_CHUNKS;
+   test_data.cmd = TEST_STREAM;
+   test_data.len = sizeof(n);
+   memcpy(test_data.data, &n, sizeof(n));
+   t0 = std::chrono::steady_clock::now();
+   TEST_CHECK(os_ipc_send(ipc, IPC_SERVER, &test_data));
+   for (i = 0; ; i++) {
+      TEST_CHECK(os_ipc_recv(ipc, IPC_SERVER, &test_data));
+      if (test_data.cmd == IPC_DONE) {
+         break;
+      }
+      TEST_CHECK(test_data.cmd == IPC_SIGS);
+      TEST_CHECK(test_same(&test_data, i, sizeof(test_data.data)));
+      test_ack.cmd = IPC_DONE;
+      test_ack.len = 0;
+      TEST_CHECK(os_ipc_send(ipc, IPC_SERVER, &test_ack));
+   }
+   t1 = std::chrono::steady_clock::now();
+   TEST_CHECK(i == TEST_CHUNKS);
+   stream = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+   // waiting for the second instance must not poll
+   test_data.cmd = TEST_WAIT;
+   test_data.len = 0;
+   TEST_CHECK(os_ipc_send(ipc, IPC_SERVER, &test_data));
+   cpu = test_cpu();
+   t0 = std::chrono::steady_clock::now();
+   TEST_CHECK(os_ipc_recv(ipc, IPC_SERVER, &test_data));
+   t1 = std::chrono::steady_clock::now();
+   cpu = test_cpu() - cpu;
+   idle = std::chrono::duration<double, std::milli>(t1 - t0).count();
+   TEST_CHECK(idle >= TEST_IDLE / 2);
+   TEST_CHECK(cpu < TEST_IDLE / 10);
+
+   // a second instance leaving without an answer must not hang the first
+   test_data.cmd = TEST_EXIT;
+   test_data.len = 0;
+   TEST_CHECK(os_ipc_send(ipc, IPC_SERVER, &test_data));
+   TEST_CHECK(!os_ipc_recv(ipc, IPC_SERVER, &test_data));
+
+   os_ipc_close(ipc);
+
+   msg("ipc: %u messages echoed (round trip %.1f us), %u MB streamed in %.0f ms, idle wait %.1f ms CPU\n",
+       (uint32_t)TEST_ECHOS, rtt, (uint32_t)(TEST_CHUNKS * sizeof(test_data.data) >> 20), stream, cpu);
+
+   return 0;
+}
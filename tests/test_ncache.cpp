@@ -0,0 +1,150 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs random lookups, additions and removals on the name cache against a
+// std::map model, then checks the option change reset, the demangling time
+// counter and concurrent use by the parse_idb workers.
+
+#include "precomp.h"
+
+#include <string.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+
+#include "ncache.h"
+
+#define TEST_OPS     400000
+#define TEST_FCTS    20000
+#define TEST_THREADS 8
+
+#define TEST_CHECK(x) \
+   if (!(x)) { \
+      msg("ncache: line %d: %s\n", __LINE__, #x); \
+      return 1; \
+   }
+
+/*------------------------------------------------*/
+/* function : test_rand                           */
+/* description: Returns the next value of a       */
+/*              xorshift generator                */
+/*------------------------------------------------*/
+
+static uint32_t test_rand(uint64_t *state) {
+   *state ^= *state << 13;
+   *state ^= *state >> 7;
+   *state ^= *state << 17;
+
+   return (uint32_t)(*state >> 16);
+}
+
+/*------------------------------------------------*/
+/* function : test_worker                         */
+/* description: Names the functions of one thread */
+/*------------------------------------------------*/
+
+static void test_worker(uint32_t t) {
+   char buf[64];
+   ea_t ea;
+   uint32_t i;
+
+   for (i = 0; i < 50000; i++) {
+      ea = t * 100000 + i;
+      if (ncache_get(ea, 1, 3, buf, sizeof(buf)) < 0) {
+         ncache_add(ea, "f", 1);
+      }
+      ncache_get(ea, 1, 3, buf, sizeof(buf));
+   }
+}
+
+int main() {
+   std::map<ea_t, std::string> names;   // "" for no usable name
+   std::map<ea_t, std::string>::iterator it;
+   std::vector<std::thread> workers;
+   std::string name;
+   ncstats_t st;
+   uint64_t state = 88172645463325252ULL, time = 0, gets = 0;
+   char buf[64];
+   uint32_t i, op;
+   ea_t ea;
+   int r;
+
+   for (i = 0; i < TEST_OPS; i++) {
+      ea = test_rand(&state) % TEST_FCTS;
+      op = test_rand(&state) % 10;
+
+      if (op < 5) {
+         r = ncache_get(ea, 1, 2, buf, sizeof(buf));
+         gets++;
+         it = names.find(ea);
+         if (it == names.end()) {
+            TEST_CHECK(r == -1);
+         }
+         else if (it->second.empty()) {
+            TEST_CHECK(r == 0);
+         }
+         else {
+            TEST_CHECK(r == 1 && it->second.compare(0, sizeof(buf) - 1, buf) == 0);
+         }
+      }
+      else if (op < 8) {
+         // names longer than the buffer are truncated on lookup
+         name = "name_" + std::to_string((unsigned long long)ea) + std::string(test_rand(&state) % 80, 'x');
+         if (test_rand(&state) % 7 == 0) {
+            name.clear();
+         }
+         ncache_add(ea, name.empty() ? NULL : name.c_str(), 5);
+         names[ea] = name;
+         time += 5;
+      }
+      else {
+         ncache_forget(ea);
+         names.erase(ea);
+      }
+   }
+
+   ncache_get_stats(&st);
+   TEST_CHECK(st.num == names.size());
+   TEST_CHECK(st.hits + st.misses == gets);
+   TEST_CHECK(st.time == time);
+   msg("ncache: %u names, %u bytes, %u hits, %u misses\n", st.num, (uint32_t)st.size, (uint32_t)st.hits, (uint32_t)st.misses);
+
+   // other demangling options: the names are dropped
+   TEST_CHECK(ncache_get(names.begin()->first, 1, 3, buf, sizeof(buf)) == -1);
+   ncache_get_stats(&st);
+   TEST_CHECK(st.num == 0 && st.size == 0);
+
+   for (i = 0; i < TEST_THREADS; i++) {
+      workers.push_back(std::thread(test_worker, i));
+   }
+   for (i = 0; i < TEST_THREADS; i++) {
+      workers[i].join();
+   }
+   ncache_get_stats(&st);
+   TEST_CHECK(st.num == TEST_THREADS * 50000);
+   for (i = 0; i < TEST_THREADS; i++) {
+      TEST_CHECK(ncache_get(i * 100000 + 49999, 1, 3, buf, sizeof(buf)) == 1 && !strcmp(buf, "f"));
+   }
+
+   ncache_clear();
+   ncache_get_stats(&st);
+   TEST_CHECK(st.num == 0);
+
+   return 0;
+}
@@ -0,0 +1,327 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Diffs two synthetic call graphs, unmatches a connected block of matched
+// functions, then matches them back by hand one anchor at a time as the
+// result choosers do. diff_propagate must only find pairs of the first
+// diff and, with them, give back every pair of the block.
+
+#include "precomp.h"
+
+#include <vector>
+#include <map>
+#include <set>
+
+#include "sig.h"
+#include "diff.h"
+
+#define TEST_FCTS  3000
+#define TEST_BLOCK 300
+#define TEST_BASE1 0x401000
+#define TEST_BASE2 0x801000
+
+/*------------------------------------------------*/
+/* function : test_rand                           */
+/* description: Returns a hash of a function      */
+/*              index and a salt                  */
+/*------------------------------------------------*/
+
+static uint32_t test_rand(size_t i, uint32_t salt) {
+   uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ULL + salt;
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+
+   return (uint32_t)h;
+}
+
+/*------------------------------------------------*/
+/* function : test_list                           */
+/* description: Builds the call graph of one file */
+/*              (file 2 changes a few functions)  */
+/*------------------------------------------------*/
+
+static slist_t *test_list(ea_t base, bool changed) {
+   slist_t *sl;
+   sig_t *sig;
+   char name[32];
+   size_t i;
+   uint32_t k;
+
+   sl = new slist_t(TEST_FCTS, NULL);
+   for (i = 0; i < TEST_FCTS; i++) {
+      sig = new sig_t();
+      // a few named functions seed the diff
+      if (test_rand(i, 1) % 32 == 0) {
+         qsnprintf(name, sizeof(name), "fct_%u", (uint32_t)i);
+      }
+      else {
+         qsnprintf(name, sizeof(name), "sub_%x", (uint32_t)(base + i * 0x40));
+      }
+      sig->set_name(name);
+      sig->set_start(base + i * 0x40);
+      // collisions: part of the functions are only told apart by their
+      // neighbourhood
+      sig->sig = test_rand(i, 2) % 400;
+      sig->hash = test_rand(i, 3) % 3;
+      sig->crc_hash = test_rand(i, 4) % 4;
+      sig->hash2 = test_rand(i, 5);
+      sig->lines = 2 + test_rand(i, 6) % 50;
+      if (changed && test_rand(i, 7) % 16 == 0) {
+         sig->crc_hash += 4;
+         sig->hash2++;
+      }
+      for (k = 0; k < 3; k++) {
+         sig->add_sref(base + (test_rand(i, 10 + k) % TEST_FCTS) * 0x40, 0, CHECK_REF);
+      }
+      sl->add(sig);
+   }
+   sl->sort();
+
+   return sl;
+}
+
+/*------------------------------------------------*/
+/* function : test_lists                          */
+/* description: Builds the result lists (as       */
+/*              deng_t::display)                  */
+/*------------------------------------------------*/
+
+static void test_lists(deng_t *eng, slist_t *l1, slist_t *l2) {
+   sig_t *sig;
+   size_t i;
+
+   eng->mlist = new slist_t(eng->matched, NULL);
+   eng->ulist = new slist_t(eng->unmatched, NULL);
+   eng->ilist = new slist_t(eng->identical, NULL);
+
+   for (i = 0; i < l1->num; i++) {
+      sig = l1->sigs[i];
+      if (sig->get_matched_type() == DIFF_UNMATCHED) {
+         sig->set_nfile(1);
+         eng->ulist->add(sig);
+      }
+      else if (sig_equal(sig, sig->msig, DIFF_EQUAL_SIG_HASH)) {
+         eng->ilist->add(sig);
+      }
+      else {
+         eng->mlist->add(sig);
+      }
+   }
+   for (i = 0; i < l2->num; i++) {
+      sig = l2->sigs[i];
+      if (sig->get_matched_type() == DIFF_UNMATCHED) {
+         sig->set_nfile(2);
+         eng->ulist->add(sig);
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : test_unmatch                        */
+/* description: Unmatches sig (as                 */
+/*              res_unmatch_rows)                 */
+/*------------------------------------------------*/
+
+static void test_unmatch(deng_t *eng, sig_t *sig) {
+   slist_t *sl = sig_equal(sig, sig->msig, DIFF_EQUAL_SIG_HASH) ? eng->ilist : eng->mlist;
+   uint32_t n = sig->node;
+
+   sig->nfile = 1;
+   sig->msig->nfile = 2;
+
+   eng->ulist->add(sig);
+   eng->ulist->add(sig->msig);
+
+   sig->msig->mtype = DIFF_UNMATCHED;
+   sig->mtype = DIFF_UNMATCHED;
+   sig->msig->msig = NULL;
+   sig->msig = NULL;
+
+   sl->remove(n);
+}
+
+/*------------------------------------------------*/
+/* function : test_match                          */
+/* description: Matches s1 and s2 by hand and     */
+/*              propagates (as propagate_match)   */
+/*------------------------------------------------*/
+
+static void test_match(deng_t *eng, sig_t *s1, sig_t *s2, qvector<sig_t *> &found) {
+   size_t i, j;
+
+   s1->set_matched_sig(s2, DIFF_MANUAL);
+
+   found.clear();
+   found.push_back(s1);
+   found.push_back(s2);
+   diff_propagate(eng, s1, s2, &found);
+
+   for (i = 0; i < found.size(); i++) {
+      s1 = found[i];
+      s2 = s1->msig;
+
+      j = s1->node;
+      if (j < eng->ulist->num && eng->ulist->sigs[j] == s1) {
+         eng->ulist->remove(j);
+      }
+
+      if (s1->nfile == 1) {
+         if (sig_equal(s1, s2, DIFF_EQUAL_SIG_HASH)) {
+            eng->ilist->add(s1);
+         }
+         else {
+            eng->mlist->add(s1);
+         }
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : test_live                           */
+/* description: Returns the number of entries of  */
+/*              a result list                     */
+/*------------------------------------------------*/
+
+static size_t test_live(slist_t *sl) {
+   return sl->num - sl->holes;
+}
+
+int main() {
+   slist_t *l1, *l2;
+   deng_t *eng = NULL;
+   std::map<sig_t *, sig_t *> pairs;
+   std::map<ea_t, sig_t *> eas;
+   std::vector<sig_t *> block, queue;
+   std::set<sig_t *> seen;
+   qvector<sig_t *> found;
+   frefs_t *refs[2];
+   fref_t *fr;
+   sig_t *sig;
+   size_t i, k, matched, anchors, wrong;
+   int ret = 0;
+
+   l1 = test_list(TEST_BASE1, false);
+   l2 = test_list(TEST_BASE2, true);
+   if (generate_diff_mt(&eng, l1, l2, "test", NULL, 1) != 0 || !eng) {
+      msg("propagate: diff failed\n");
+      return 1;
+   }
+   test_lists(eng, l1, l2);
+
+   for (i = 0; i < l1->num; i++) {
+      sig = l1->sigs[i];
+      eas[sig->startEA] = sig;
+      if (sig->msig) {
+         pairs[sig] = sig->msig;
+      }
+   }
+   matched = test_live(eng->mlist) + test_live(eng->ilist);
+   if (pairs.size() < TEST_FCTS / 2) {
+      msg("propagate: only %u functions matched\n", (uint32_t)pairs.size());
+      return 1;
+   }
+
+   // a connected block of matched functions (callees first)
+   sig = eng->mlist->num ? eng->mlist->sigs[eng->mlist->num / 2] : eng->ilist->sigs[0];
+   queue.push_back(sig);
+   seen.insert(sig);
+   for (i = 0; i < queue.size() && block.size() < TEST_BLOCK; i++) {
+      sig = queue[i];
+      if (!sig->msig) {
+         continue;
+      }
+      block.push_back(sig);
+      refs[0] = sig->srefs;
+      refs[1] = sig->prefs;
+      for (k = 0; k < 2; k++) {
+         for (fr = refs[k] ? refs[k]->list : NULL; fr; fr = fr->next) {
+            if (eas.count(fr->ea) && !seen.count(eas[fr->ea])) {
+               seen.insert(eas[fr->ea]);
+               queue.push_back(eas[fr->ea]);
+            }
+         }
+      }
+   }
+
+   for (i = 0; i < block.size(); i++) {
+      test_unmatch(eng, block[i]);
+   }
+   diff_propagate_reset(eng);
+
+   // matches the block back, one anchor per pair not found yet
+   anchors = wrong = 0;
+   for (i = 0; i < block.size(); i++) {
+      sig = block[i];
+      if (sig->msig) {
+         continue;
+      }
+      test_match(eng, sig, pairs[sig], found);
+      anchors++;
+      for (k = 0; k < found.size(); k++) {
+         if (found[k]->nfile == 1 && pairs[found[k]] != found[k]->msig) {
+            wrong++;
+         }
+      }
+   }
+
+   for (i = 0; i < block.size(); i++) {
+      if (block[i]->msig != pairs[block[i]]) {
+         msg("propagate: %x is not matched back\n", (uint32_t)block[i]->startEA);
+         ret = 1;
+         break;
+      }
+   }
+   if (wrong) {
+      msg("propagate: %u wrong pairs\n", (uint32_t)wrong);
+      ret = 1;
+   }
+   if (anchors * 2 > block.size()) {
+      msg("propagate: %u anchors for %u pairs\n", (uint32_t)anchors, (uint32_t)block.size());
+      ret = 1;
+   }
+   if (test_live(eng->mlist) + test_live(eng->ilist) != matched) {
+      msg("propagate: the result lists lost entries\n");
+      ret = 1;
+   }
+   for (i = 0; i < eng->ulist->num; i++) {
+      if (eng->ulist->sigs[i] && eng->ulist->sigs[i]->msig) {
+         msg("propagate: %x is matched but still in the unmatched list\n", (uint32_t)eng->ulist->sigs[i]->startEA);
+         ret = 1;
+         break;
+      }
+   }
+
+   if (!ret) {
+      msg("propagate: %u pairs matched back from %u anchors\n", (uint32_t)block.size(), (uint32_t)anchors);
+   }
+
+   // the result lists only hold file 1 sigs: frees both files instead
+   delete eng->mlist;
+   delete eng->ulist;
+   delete eng->ilist;
+   eng->mlist = eng->ulist = eng->ilist = NULL;
+   delete eng;
+   l1->free_sigs();
+   l2->free_sigs();
+   delete l1;
+   delete l2;
+
+   return ret;
+}
@@ -0,0 +1,219 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs the parse_idb sharding with a synthetic signature generator and
+// checks that the .sig file written for 2 to 8 shards, and the order the
+// sink sees the signatures in, are identical to a single shard.
+
+#include "precomp.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "sig.h"
+#include "pshard.h"
+
+#define TEST_FCTS 20000
+#define TEST_BASE 0x401000
+
+static std::vector<ea_t> sink_order;
+
+/*------------------------------------------------*/
+/* function : test_rand                           */
+/* description: Returns a hash of a function      */
+/*              index and a salt                  */
+/*------------------------------------------------*/
+
+static uint32_t test_rand(size_t i, uint32_t salt) {
+   uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ULL + salt;
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+
+   return (uint32_t)h;
+}
+
+/*------------------------------------------------*/
+/* function : test_sink                           */
+/* description: Records the sink order            */
+/*------------------------------------------------*/
+
+static void test_sink(sig_t *sig) {
+   sink_order.push_back(sig->startEA);
+}
+
+/*------------------------------------------------*/
+/* function : test_work                           */
+/* description: Generates the signatures of a     */
+/*              shard (stands for sig_generate)   */
+/*------------------------------------------------*/
+
+static void test_work(pshard_t *shard) {
+   sig_t *sig;
+   char name[32];
+   size_t i;
+   uint32_t k;
+
+   // the first shard finishes last
+   if (shard->start == 0 && shard->end < TEST_FCTS) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   }
+
+   for (i = shard->start; i < shard->end; i++) {
+      // some functions are dropped, as the 1 line jump functions
+      if (test_rand(i, 1) % 10 == 0) {
+         continue;
+      }
+
+      sig = new sig_t();
+      qsnprintf(name, sizeof(name), "sub_%x", (uint32_t)(TEST_BASE + i * 0x40));
+      sig->set_name(name);
+      sig->set_start(TEST_BASE + i * 0x40);
+      sig->sig = test_rand(i, 2) % 3000;
+      sig->hash = test_rand(i, 3) % 7;
+      sig->crc_hash = test_rand(i, 4);
+      sig->str_hash = test_rand(i, 5) % 100;
+      sig->hash2 = test_rand(i, 6);
+      sig->lines = 2 + test_rand(i, 7) % 100;
+      for (k = 0; k < 3; k++) {
+         sig->add_sref(TEST_BASE + (test_rand(i, 10 + k) % TEST_FCTS) * 0x40, 0, CHECK_REF);
+      }
+
+      // class references, shared by several shards
+      if (test_rand(i, 8) % 16 == 0) {
+         shard->class_l.add_unique(0x900000 + (test_rand(i, 9) % 64) * 8);
+      }
+
+      shard->sl->add(sig);
+      shard->gen_lines += sig->lines;
+      if (shard->sink) {
+         shard->sink(sig);
+      }
+   }
+}
+
+/*------------------------------------------------*/
+/* function : test_parse                          */
+/* description: Parses the synthetic idb with     */
+/*              nshards and saves it to file      */
+/*------------------------------------------------*/
+
+static uint64_t test_parse(size_t nshards, const char *file) {
+   slist_t *sl;
+   sig_t *sig;
+   pshard_t *shards, all;
+   char name[32];
+   size_t i;
+
+   sl = new slist_t(TEST_FCTS, NULL);
+   shards = pshard_init(TEST_FCTS, nshards, test_sink, NULL);
+   pshard_run(shards, nshards, test_work, test_sink);
+
+   all.sl = sl;
+   pshard_merge(shards, nshards, &all);
+   delete [] shards;
+
+   sl->realloc(all.class_l.size());
+   for (i = 0; i < all.class_l.size(); i++) {
+      sig = new sig_t();
+      qsnprintf(name, sizeof(name), "class_%x", (uint32_t)all.class_l[i]);
+      sig->set_name(name);
+      sig->set_start(all.class_l[i]);
+      sig->sig = CLASS_SIG;
+      sig->lines = 1;
+      sl->add(sig);
+   }
+
+   sl->sort();
+   sl->save(file);
+   sl->free_sigs();
+   delete sl;
+
+   return all.gen_lines;
+}
+
+/*------------------------------------------------*/
+/* function : test_read                           */
+/* description: Reads a whole file                */
+/*------------------------------------------------*/
+
+static bool test_read(const char *file, std::vector<char> &data) {
+   FILE *fp;
+   char buf[4096];
+   size_t n;
+
+   fp = fopen(file, "rb");
+   if (!fp) {
+      return false;
+   }
+   data.clear();
+   while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      data.insert(data.end(), buf, buf + n);
+   }
+   fclose(fp);
+
+   return true;
+}
+
+int main() {
+   static const size_t nshards[] = { 2, 3, 4, 7, 8 };
+   std::vector<char> ref, data;
+   std::vector<ea_t> ref_order;
+   char ref_file[64], file[64];
+   uint64_t ref_lines, lines;
+   size_t i;
+   int ret = 0;
+
+   qsnprintf(ref_file, sizeof(ref_file), "/tmp/pdiff2_pshard_%d_1.sig", (int)getpid());
+   ref_lines = test_parse(1, ref_file);
+   ref_order = sink_order;
+   if (!test_read(ref_file, ref) || ref.empty()) {
+      msg("pshard: cannot read %s\n", ref_file);
+      return 1;
+   }
+
+   for (i = 0; i < sizeof(nshards) / sizeof(nshards[0]); i++) {
+      sink_order.clear();
+      qsnprintf(file, sizeof(file), "/tmp/pdiff2_pshard_%d_%d.sig", (int)getpid(), (int)nshards[i]);
+      lines = test_parse(nshards[i], file);
+
+      if (!test_read(file, data) || data != ref) {
+         msg("pshard: %d shards: the .sig file differs from a single shard\n", (int)nshards[i]);
+         ret = 1;
+      }
+      if (sink_order != ref_order) {
+         msg("pshard: %d shards: the sink order differs from a single shard\n", (int)nshards[i]);
+         ret = 1;
+      }
+      if (lines != ref_lines) {
+         msg("pshard: %d shards: the statistics differ from a single shard\n", (int)nshards[i]);
+         ret = 1;
+      }
+      unlink(file);
+   }
+   unlink(ref_file);
+
+   if (!ret) {
+      msg("pshard: %u bytes, identical for 1 to 8 shards\n", (uint32_t)ref.size());
+   }
+   return ret;
+}
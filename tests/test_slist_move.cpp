@@ -0,0 +1,96 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks the O(1) result list changes: removed rows keep the indexes of the
+// other rows until the list is packed, a bulk move takes the indexes given
+// before the move, and pack renumbers sig->node.
+
+#include "precomp.h"
+
+#include "sig.h"
+
+#define TEST_NUM 100000
+
+#define TEST_CHECK(x) \
+   if (!(x)) { \
+      msg("slist_move: line %d: %s\n", __LINE__, #x); \
+      return 1; \
+   }
+
+int main() {
+   slist_t *a, *b;
+   sig_t **sigs;
+   uint32_t *idx;
+   uint32_t i;
+
+   a = new slist_t(0, NULL);
+   b = new slist_t(0, NULL);
+   sigs = new sig_t *[TEST_NUM];
+   idx = new uint32_t[TEST_NUM / 2];
+
+   // add grows the list geometrically
+   for (i = 0; i < TEST_NUM; i++) {
+      sigs[i] = new sig_t();
+      sigs[i]->startEA = i;
+      a->add(sigs[i]);
+   }
+   TEST_CHECK(a->num == TEST_NUM && a->org_num < 2 * TEST_NUM);
+   TEST_CHECK(sigs[TEST_NUM - 1]->node == TEST_NUM - 1);
+
+   // moves the even rows, the odd rows keep their index
+   for (i = 0; i < TEST_NUM / 2; i++) {
+      idx[i] = 2 * i;
+   }
+   TEST_CHECK(a->move(b, idx, TEST_NUM / 2) == TEST_NUM / 2);
+   TEST_CHECK(a->num == TEST_NUM && a->holes == TEST_NUM / 2);
+   TEST_CHECK(a->sigs[0] == NULL && a->sigs[1] == sigs[1]);
+   TEST_CHECK(b->num == TEST_NUM / 2 && b->sigs[7] == sigs[14] && sigs[14]->node == 7);
+
+   // removed or out of range rows are skipped
+   TEST_CHECK(a->move(b, idx, 2) == 0);
+   idx[0] = TEST_NUM;
+   TEST_CHECK(a->move(b, idx, 1) == 0);
+
+   // removing a row twice counts one hole
+   a->remove(1);
+   a->remove(1);
+   a->remove(TEST_NUM);
+   TEST_CHECK(a->holes == TEST_NUM / 2 + 1);
+   TEST_CHECK(a->sigs[3] == sigs[3] && a->sigs[3]->node == 3);
+
+   a->pack();
+   TEST_CHECK(a->num == TEST_NUM / 2 - 1 && a->holes == 0);
+   for (i = 0; i < a->num; i++) {
+      TEST_CHECK(a->sigs[i] == sigs[2 * i + 3] && (uint32_t)a->sigs[i]->node == i);
+   }
+
+   // nothing to pack in the destination
+   b->pack();
+   TEST_CHECK(b->num == TEST_NUM / 2 && b->sigs[TEST_NUM / 2 - 1] == sigs[TEST_NUM - 2]);
+
+   for (i = 0; i < TEST_NUM; i++) {
+      delete sigs[i];
+   }
+   delete [] sigs;
+   delete [] idx;
+   delete a;
+   delete b;
+
+   msg("slist_move: %u rows moved and packed\n", TEST_NUM);
+   return 0;
+}
@@ -0,0 +1,212 @@
+/*
+   Patchdiff2
+   Portions (C) 2010 - 2011 Nicolas Pouvesle
+   Portions (C) 2007 - 2009 Tenable Network Security, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 2 as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Checks the byte span x86/PPC heuristics on a few known instructions, then fuzzes them against the ea based reference
+// versions (tests/ref_*.cpp) over random byte streams for x86-32, x86-64
+// and both PPC byte orders. Every position is tried, up to past the end of
+// the stream where the missing bytes read as 0xFF.
+
+#include "precomp.h"
+
+#include "patchdiff.h"
+#include "x86.h"
+#include "ppc.h"
+#include "ref_span.h"
+
+#define TEST_ROUNDS 400
+#define TEST_MAXLEN 4000
+
+#define TEST_CHECK(x) \
+   if (!(x)) { \
+      msg("span: line %d: %s\n", __LINE__, #x); \
+      return 1; \
+   }
+
+const unsigned char *ref_mem;
+size_t ref_len;
+bool ref_be;
+cpu_t ref_cpu;
+
+// bytes of the prefixes, nops and jumps the heuristics look for
+static const unsigned char test_bytes[] = {
+   0x40, 0x48, 0x4F, 0x66, 0xF3, 0xF2, 0x0F, 0x85, 0x75, 0x77, 0x8B, 0x8D,
+   0x87, 0xC0, 0x00, 0x24, 0x64, 0xB4, 0x26, 0xA4, 0x80, 0xB6, 0xE9, 0xEB,
+   0x90, 0x50, 0x58, 0x7C, 0x60, 0x63, 0x78, 0x43, 0xCC, 0xFF, 0x74, 0x1B
+};
+
+/*------------------------------------------------*/
+/* function : test_rand                           */
+/* description: Returns the next value of a       */
+/*              xorshift generator                */
+/*------------------------------------------------*/
+
+static uint32_t test_rand(uint64_t *state) {
+   *state ^= *state << 13;
+   *state ^= *state >> 7;
+   *state ^= *state << 17;
+
+   return (uint32_t)(*state >> 16);
+}
+
+/*------------------------------------------------*/
+/* function : test_known                          */
+/* description: Checks a few known instructions   */
+/*------------------------------------------------*/
+
+static int test_known() {
+   static const unsigned char push_ebx[] = { 0x53 };
+   static const unsigned char rex_mov[] = { 0x48, 0x89, 0xE5 };
+   static const unsigned char mov_eax_eax[] = { 0x8B, 0xC0 };
+   static const unsigned char mov_eax_ecx[] = { 0x8B, 0xC1 };
+   static const unsigned char lea_esi[] = { 0x8D, 0x76, 0x00 };
+   static const unsigned char jmp_0[] = { 0xE9, 0x00, 0x00, 0x00, 0x00 };
+   static const unsigned char jmp_short_0[] = { 0xEB, 0x00 };
+   static const unsigned char jmp_short_1[] = { 0xEB, 0x01 };
+   static const unsigned char jz_near[] = { 0x0F, 0x84, 0x10, 0x00, 0x00, 0x00 };
+   static const unsigned char jnz_short[] = { 0x75, 0x10 };
+   static const unsigned char int3[] = { 0xCC };
+   static const unsigned char mr_be[] = { 0x7C, 0x63, 0x1B, 0x78 };   // mr r3, r3
+   static const unsigned char mr_le[] = { 0x78, 0x1B, 0x63, 0x7C };   // byte swapped
+   unsigned char op;
+
+   TEST_CHECK(x86_get_byte(push_ebx, sizeof(push_ebx), false) == 0x50);
+   TEST_CHECK(x86_get_byte(rex_mov, sizeof(rex_mov), true) == 0x89);
+   TEST_CHECK(x86_get_byte(rex_mov, sizeof(rex_mov), false) == 0x48);
+
+   TEST_CHECK(x86_remove_instr(0x8B, mov_eax_eax, sizeof(mov_eax_eax), false));
+   TEST_CHECK(!x86_remove_instr(0x8B, mov_eax_ecx, sizeof(mov_eax_ecx), false));
+   TEST_CHECK(x86_remove_instr(0x8D, lea_esi, sizeof(lea_esi), false));
+   // the displacement is past the end of the span
+   TEST_CHECK(!x86_remove_instr(0x8D, lea_esi, 2, false));
+
+   TEST_CHECK(x86_is_fake_jump(jmp_0, sizeof(jmp_0)));
+   TEST_CHECK(!x86_is_fake_jump(jmp_0, sizeof(jmp_0) - 1));
+   TEST_CHECK(x86_is_fake_jump(jmp_short_0, sizeof(jmp_short_0)));
+   TEST_CHECK(!x86_is_fake_jump(jmp_short_1, sizeof(jmp_short_1)));
+
+   TEST_CHECK(x86_is_direct_jump(jmp_short_1, sizeof(jmp_short_1)));
+   TEST_CHECK(!x86_is_direct_jump(jnz_short, sizeof(jnz_short)));
+   TEST_CHECK(x86_is_cond_jump_pos(jz_near, sizeof(jz_near)) == 1);
+   TEST_CHECK(x86_is_cond_jump_pos(jnz_short, sizeof(jnz_short)) == 2);
+   TEST_CHECK(x86_is_cond_jump_pos(jmp_short_1, sizeof(jmp_short_1)) == 0);
+   TEST_CHECK(x86_is_end_block(int3, sizeof(int3)));
+   TEST_CHECK(!x86_is_end_block(int3, 0));
+
+   op = ppc_get_byte(mr_be, sizeof(mr_be), true);
+   TEST_CHECK(ppc_remove_instr(op, mr_be, sizeof(mr_be), true));
+   // the last byte is past the end of the span
+   TEST_CHECK(!ppc_remove_instr(op, mr_be, sizeof(mr_be) - 1, true));
+   op = ppc_get_byte(mr_le, sizeof(mr_le), true);
+   TEST_CHECK(!ppc_remove_instr(op, mr_le, sizeof(mr_le), true));
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : test_x86                            */
+/* description: Compares the x86 heuristics with  */
+/*              the reference at every position   */
+/*------------------------------------------------*/
+
+static int test_x86(const unsigned char *mem, size_t len, bool x64, uint32_t *checks) {
+   const unsigned char *buf;
+   unsigned char op;
+   size_t n;
+   ea_t ea;
+
+   ref_mem = mem;
+   ref_len = len;
+   ref_cpu = x64 ? CPU_X8664 : CPU_X8632;
+
+   for (ea = 0; ea < len + 8; ea++) {
+      buf = mem + (ea < len ? ea : 0);
+      n = ea < len ? len - ea : 0;
+
+      op = ref_x86_get_byte(ea);
+      TEST_CHECK(x86_get_byte(buf, n, x64) == op);
+      TEST_CHECK(x86_remove_instr(op, buf, n, x64) == ref_x86_remove_instr(op, ea));
+      TEST_CHECK(x86_is_fake_jump(buf, n) == (ref_x86_get_fake_jump(ea) != BADADDR));
+      TEST_CHECK(x86_is_direct_jump(buf, n) == ref_x86_is_direct_jump(ea));
+      TEST_CHECK(x86_is_cond_jump_pos(buf, n) == ref_x86_is_cond_jump_pos(ea));
+      TEST_CHECK(x86_is_end_block(buf, n) == ref_x86_is_end_block(ea));
+      (*checks)++;
+   }
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : test_ppc                            */
+/* description: Compares the PPC heuristics with  */
+/*              the reference at every position   */
+/*------------------------------------------------*/
+
+static int test_ppc(const unsigned char *mem, size_t len, bool be, uint32_t *checks) {
+   const unsigned char *buf;
+   unsigned char op;
+   size_t n;
+   ea_t ea;
+
+   ref_mem = mem;
+   ref_len = len;
+   ref_be = be;
+
+   for (ea = 0; ea < len + 8; ea++) {
+      buf = mem + (ea < len ? ea : 0);
+      n = ea < len ? len - ea : 0;
+
+      op = ref_ppc_get_byte(ea);
+      TEST_CHECK(ppc_get_byte(buf, n, be) == op);
+      TEST_CHECK(ppc_remove_instr(op, buf, n, be) == ref_ppc_remove_instr(op, ea));
+      (*checks)++;
+   }
+
+   return 0;
+}
+
+int main() {
+   static unsigned char mem[TEST_MAXLEN];
+   uint64_t state = 88172645463325252ULL;
+   uint32_t round, checks = 0;
+   size_t i, len;
+
+   if (test_known()) {
+      return 1;
+   }
+
+   for (round = 0; round < TEST_ROUNDS; round++) {
+      len = 1000 + test_rand(&state) % (TEST_MAXLEN - 1000);
+      for (i = 0; i < len; i++) {
+         if (test_rand(&state) % 3) {
+            mem[i] = test_bytes[test_rand(&state) % sizeof(test_bytes)];
+         }
+         else {
+            mem[i] = (unsigned char)test_rand(&state);
+         }
+      }
+
+      if (test_x86(mem, len, false, &checks) || test_x86(mem, len, true, &checks)
+            || test_ppc(mem, len, false, &checks) || test_ppc(mem, len, true, &checks)) {
+         msg("span: round %u differs from the reference\n", round);
+         return 1;
+      }
+   }
+
+   msg("span: %u positions identical to the reference\n", checks);
+   return 0;
+}
@@ -16,15 +16,33 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+// glibc has a sig_t of its own (signal handlers)
+#define sig_t os_sig_t
+
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <errno.h>
+#include <poll.h>
+
+#undef sig_t
 
+#ifdef PDIFF_STANDALONE
+#include "precomp.h"
+#else
 #define USE_DANGEROUS_FUNCTIONS
 
 #include <ida.hpp>
 #include <kernwin.hpp>
+#endif
 
 #include "unix_fct.h"
 #include "system.h"
@@ -35,6 +53,7 @@ struct ipc_data {
    char *sname;
    char *rname;
    pid_t pid;
+   int pidfd;     // readable when pid exits (-1 if not supported)
 };
 
 typedef struct ipc_data ipc_data_t;
@@ -63,6 +82,20 @@ pid_t create_process(char *cmd) {
    return pid;
 }
 
+/*------------------------------------------------*/
+/* function : os_pidfd_open                       */
+/* description: Returns a descriptor signaled     */
+/*              when the process exits            */
+/*------------------------------------------------*/
+
+static int os_pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+   return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+   return -1;
+#endif
+}
+
 /*------------------------------------------------*/
 /* function : os_execute_command                  */
 /* description: Executes a command by creating a  */
@@ -87,6 +120,40 @@ int os_execute_command(char *cmd, bool close, void *data) {
    }
    else {
       id->pid = pid;
+      id->pidfd = os_pidfd_open(pid);
+   }
+
+   return 0;
+}
+
+/*------------------------------------------------*/
+/* function : os_start_command                    */
+/* description: Starts a command without waiting  */
+/*              for it (see os_wait_command)      */
+/*------------------------------------------------*/
+
+void *os_start_command(char *cmd) {
+   pid_t pid;
+
+   pid = create_process(cmd);
+   if (pid == -1) {
+      return NULL;
+   }
+
+   return (void *)(intptr_t)pid;
+}
+
+/*------------------------------------------------*/
+/* function : os_wait_command                     */
+/* description: Waits for a command started with  */
+/*              os_start_command                  */
+/*------------------------------------------------*/
+
+int os_wait_command(void *process) {
+   int status;
+
+   if (waitpid((pid_t)(intptr_t)process, &status, 0) == -1) {
+      return -1;
    }
 
    return 0;
@@ -98,8 +165,15 @@ int os_execute_command(char *cmd, bool close, void *data) {
 /*------------------------------------------------*/
 
 bool os_check_process(pid_t pid) {
-   if (kill(pid, 0) == 0) {
-      return true;
+   int status;
+
+   // kill() succeeds on a zombie: reaps the process instead
+   switch (waitpid(pid, &status, WNOHANG)) {
+      case 0:
+         return true;
+      case -1:
+         // not waitable (SIGCHLD ignored by the host)
+         return errno == ECHILD && kill(pid, 0) == 0;
    }
    return false;
 }
@@ -130,6 +204,66 @@ int os_unlink(const char *path) {
    return unlink(path);
 }
 
+/*------------------------------------------------*/
+/* function : os_file_stamp                       */
+/* description: Returns a stamp which changes     */
+/*              when the file is modified         */
+/*------------------------------------------------*/
+
+bool os_file_stamp(const char *path, uint64_t *stamp) {
+   struct stat st;
+
+   if (stat(path, &st) != 0) {
+      return false;
+   }
+
+   *stamp = ((uint64_t)st.st_mtime << 32) ^ (uint64_t)st.st_size;
+   return true;
+}
+
+// the standalone core maps files itself (standalone.h)
+#ifndef PDIFF_STANDALONE
+/*------------------------------------------------*/
+/* function : os_map_file                         */
+/* description: Maps a whole file read only       */
+/*------------------------------------------------*/
+
+void *os_map_file(const char *path, size_t *size, void **handle) {
+   struct stat st;
+   void *data;
+   int fd;
+
+   *handle = NULL;
+   fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      return NULL;
+   }
+   if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return NULL;
+   }
+
+   data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) {
+      return NULL;
+   }
+   *size = (size_t)st.st_size;
+
+   return data;
+}
+
+/*------------------------------------------------*/
+/* function : os_unmap_file                       */
+/* description: Unmaps a file mapped with         */
+/*              os_map_file                       */
+/*------------------------------------------------*/
+
+void os_unmap_file(void *data, size_t size, void *handle) {
+   munmap(data, size);
+}
+#endif
+
 /*------------------------------------------------*/
 /* function : os_tempnam                          */
 /* description: returns a temporary file name     */
@@ -147,68 +281,155 @@ void os_tempnam(char *data, size_t size, const char *suffix) {
 }
 
 /*------------------------------------------------*/
-/* function : os_ipc_send                         */
-/* description: Sends data on pipe                */
+/* function : os_ipc_wait                         */
+/* description: Waits for the pipe to be ready    */
+/*              (or for the peer to die)          */
 /*------------------------------------------------*/
 
-bool os_ipc_send(void *data, int type, idata_t *d) {
-   ipc_data_t *id = (ipc_data_t *)data;
-   ssize_t num;
+static bool os_ipc_wait(ipc_data_t *id, int fd, short events) {
+   struct pollfd fds[2];
+   int ret, nfds, timeout;
 
-   num = write(id->spipe, d, sizeof(*d));
-   if (num > 0) {
-      return true;
+   fds[0].fd = fd;
+   fds[0].events = events;
+   nfds = 1;
+
+   if (id->pid && id->pidfd >= 0) {
+      fds[1].fd = id->pidfd;
+      fds[1].events = POLLIN;
+      nfds = 2;
+   }
+
+   // without pidfd the child state is checked from time to time
+   timeout = (id->pid && id->pidfd < 0) ? 100 : -1;
+
+   while (1) {
+      fds[0].revents = 0;
+      fds[1].revents = 0;
+
+      ret = poll(fds, nfds, timeout);
+      if (ret < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return false;
+      }
+
+      // pending data is still read after the peer exited
+      if (fds[0].revents & events) {
+         return true;
+      }
+      if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+         return false;
+      }
+      if (nfds == 2 && fds[1].revents) {
+         return false;
+      }
+      if (ret == 0 && !os_check_process(id->pid)) {
+         return false;
+      }
    }
-   return false;
 }
 
 /*------------------------------------------------*/
-/* function : os_ipc_recv                         */
-/* description: Receives data on pipe             */
+/* function : os_ipc_write                        */
+/* description: Writes a whole buffer on pipe     */
 /*------------------------------------------------*/
 
-bool os_ipc_recv(void *data, int type, idata_t *d) {
-   ipc_data_t *id = (ipc_data_t *)data;
-   fd_set rfds, efds;
-   struct timeval tv;
-   int ret;
+static bool os_ipc_write(ipc_data_t *id, const void *buf, size_t len) {
+   const char *p = (const char *)buf;
+   ssize_t num;
 
-   tv.tv_sec = 0;
-   tv.tv_usec = 1000;
+   while (len) {
+      num = write(id->spipe, p, len);
+      if (num > 0) {
+         p += num;
+         len -= num;
+      }
+      else if (num < 0 && errno == EAGAIN) {
+         if (!os_ipc_wait(id, id->spipe, POLLOUT)) {
+            return false;
+         }
+      }
+      else if (num < 0 && errno == EINTR) {
+         continue;
+      }
+      else {
+         return false;
+      }
+   }
+
+   return true;
+}
 
-   if (id->pid) {
-      while (1) {
-         FD_ZERO(&rfds);
-         FD_SET(id->rpipe, &rfds);
+/*------------------------------------------------*/
+/* function : os_ipc_read                         */
+/* description: Reads a whole buffer on pipe      */
+/*------------------------------------------------*/
 
-         FD_ZERO(&efds);
-         FD_SET(id->rpipe, &efds);
+static bool os_ipc_read(ipc_data_t *id, void *buf, size_t len) {
+   char *p = (char *)buf;
+   ssize_t num;
 
-         ret = select(id->rpipe + 1, &rfds, NULL, &efds, &tv);
-         if (ret > 0 && FD_ISSET(id->rpipe, &rfds)) {
-            break;
-         }
-         if (ret < 0 || (ret > 0 && FD_ISSET(id->rpipe, &efds)) || !os_check_process(id->pid)) {
+   while (len) {
+      num = read(id->rpipe, p, len);
+      if (num > 0) {
+         p += num;
+         len -= num;
+      }
+      else if (num < 0 && errno == EAGAIN) {
+         if (!os_ipc_wait(id, id->rpipe, POLLIN)) {
             return false;
          }
       }
+      else if (num < 0 && errno == EINTR) {
+         continue;
+      }
+      else {
+         // end of file: the peer closed the pipe
+         return false;
+      }
    }
-   else {
-       FD_ZERO(&rfds);
-       FD_SET(id->rpipe, &rfds);
 
-       FD_ZERO(&efds);
-       FD_SET(id->rpipe, &efds);
+   return true;
+}
 
-       ret = select(id->rpipe + 1, &rfds, NULL, &efds, NULL);
-       if (!(ret > 0 && FD_ISSET(id->rpipe, &rfds))) {
-          return false;
-         }
+/*------------------------------------------------*/
+/* function : os_ipc_send                         */
+/* description: Sends data on pipe                */
+/*              (header and used data only)       */
+/*------------------------------------------------*/
+
+bool os_ipc_send(void *data, int type, idata_t *d) {
+   ipc_data_t *id = (ipc_data_t *)data;
+
+   if (d->len < 0 || d->len > (long)sizeof(d->data)) {
+      return false;
    }
 
-   read(id->rpipe, d, sizeof(*d));
+   return os_ipc_write(id, d, offsetof(idata_t, data) + d->len);
+}
 
-   return true;
+/*------------------------------------------------*/
+/* function : os_ipc_recv                         */
+/* description: Receives data on pipe             */
+/*------------------------------------------------*/
+
+bool os_ipc_recv(void *data, int type, idata_t *d) {
+   ipc_data_t *id = (ipc_data_t *)data;
+
+   if (!os_ipc_wait(id, id->rpipe, POLLIN)) {
+      return false;
+   }
+
+   if (!os_ipc_read(id, d, offsetof(idata_t, data))) {
+      return false;
+   }
+   if (d->len < 0 || d->len > (long)sizeof(d->data)) {
+      return false;
+   }
+
+   return os_ipc_read(id, d->data, d->len);
 }
 
 /*------------------------------------------------*/
@@ -226,6 +447,7 @@ bool os_ipc_init(void ** data, long pid, int type) {
       return false;
    }
    memset(id, '\0', sizeof(*id));
+   id->pidfd = -1;
 
    qsnprintf(sname, sizeof(sname), "/tmp/pdiff2spipe%ld", pid);
    qsnprintf(rname, sizeof(rname), "/tmp/pdiff2rpipe%ld", pid);
@@ -284,6 +506,9 @@ bool os_ipc_close(void *data) {
    if (id->rpipe) {
       close(id->rpipe);
    }
+   if (id->pidfd >= 0) {
+      close(id->pidfd);
+   }
    os_unlink(id->sname);
    os_unlink(id->rname);
    return true;
@@ -82,6 +82,40 @@ int os_execute_command(char *cmd, bool close, void *data) {
    return ret;
 }
 
+/*------------------------------------------------*/
+/* function : os_start_command                    */
+/* description: Starts a command without waiting  */
+/*              for it (see os_wait_command)      */
+/*------------------------------------------------*/
+
+void *os_start_command(char *cmd) {
+   ipc_data_t id;
+
+   memset(&id, 0, sizeof(id));
+   if (os_execute_command(cmd, false, &id) != 0) {
+      return NULL;
+   }
+
+   return id.process;
+}
+
+/*------------------------------------------------*/
+/* function : os_wait_command                     */
+/* description: Waits for a command started with  */
+/*              os_start_command                  */
+/*------------------------------------------------*/
+
+int os_wait_command(void *process) {
+   int ret = -1;
+
+   if (WaitForSingleObject((HANDLE)process, INFINITE) == WAIT_OBJECT_0) {
+      ret = 0;
+   }
+   CloseHandle((HANDLE)process);
+
+   return ret;
+}
+
 /*------------------------------------------------*/
 /* function : os_check_process                    */
 /* description: checks process state              */
@@ -122,6 +156,72 @@ int os_unlink(const char *path) {
    return _unlink(path);
 }
 
+/*------------------------------------------------*/
+/* function : os_file_stamp                       */
+/* description: Returns a stamp which changes     */
+/*              when the file is modified         */
+/*------------------------------------------------*/
+
+bool os_file_stamp(const char *path, uint64_t *stamp) {
+   WIN32_FILE_ATTRIBUTE_DATA fa;
+
+   if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fa)) {
+      return false;
+   }
+
+   *stamp = (((uint64_t)fa.ftLastWriteTime.dwHighDateTime << 32) | fa.ftLastWriteTime.dwLowDateTime)
+          ^ (((uint64_t)fa.nFileSizeHigh << 32) | fa.nFileSizeLow);
+   return true;
+}
+
+/*------------------------------------------------*/
+/* function : os_map_file                         */
+/* description: Maps a whole file read only       */
+/*------------------------------------------------*/
+
+void *os_map_file(const char *path, size_t *size, void **handle) {
+   HANDLE file, mapping;
+   LARGE_INTEGER fsize;
+   void *data;
+
+   *handle = NULL;
+   file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE) {
+      return NULL;
+   }
+   if (!GetFileSizeEx(file, &fsize) || fsize.QuadPart == 0) {
+      CloseHandle(file);
+      return NULL;
+   }
+
+   mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   CloseHandle(file);
+   if (mapping == NULL) {
+      return NULL;
+   }
+
+   data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (data == NULL) {
+      CloseHandle(mapping);
+      return NULL;
+   }
+   *size = (size_t)fsize.QuadPart;
+   *handle = mapping;
+
+   return data;
+}
+
+/*------------------------------------------------*/
+/* function : os_unmap_file                       */
+/* description: Unmaps a file mapped with         */
+/*              os_map_file                       */
+/*------------------------------------------------*/
+
+void os_unmap_file(void *data, size_t size, void *handle) {
+   UnmapViewOfFile(data);
+   CloseHandle((HANDLE)handle);
+}
+
 /*------------------------------------------------*/
 /* function : os_tempnam                          */
 /* description: returns a temporary file name     */
@@ -145,7 +245,12 @@ bool os_ipc_send(void *data, int type, idata_t *d) {
    ipc_data_t *id = (ipc_data_t *)data;
    HANDLE lock;
 
-   memcpy(id->memory, d, sizeof(*id->memory));
+   if (d->len < 0 || d->len > (long)sizeof(d->data)) {
+      return false;
+   }
+
+   // only the header and the used data are copied
+   memcpy(id->memory, d, offsetof(idata_t, data) + d->len);
 
    lock = (type == IPC_SERVER) ? id->slock : id->rlock;
 
@@ -183,7 +288,11 @@ bool os_ipc_recv(void *data, int type, idata_t *d) {
       }
    }
 
-   memcpy(d, id->memory, sizeof(*d));
+   memcpy(d, id->memory, offsetof(idata_t, data));
+   if (d->len < 0 || d->len > (long)sizeof(d->data)) {
+      return false;
+   }
+   memcpy(d->data, id->memory->data, d->len);
 
    return true;
 }
@@ -35,14 +35,23 @@
 #endif
 #endif
 
+// stream chunks sent before waiting for an acknowledgment (the shared
+// memory holds a single message)
+#define IPC_WINDOW 1
+
 // Preference functions
 bool os_get_pref_int(const char *, int *);
 
 // System functions
 int os_execute_command(char *, bool, void *);
+void *os_start_command(char *);
+int os_wait_command(void *);
 void os_copy_to_clipboard(char *);
 long os_get_pid();
 int os_unlink(const char *path);
+bool os_file_stamp(const char *, uint64_t *);
+void *os_map_file(const char *, size_t *, void **);
+void os_unmap_file(void *, size_t, void *);
 void os_tempnam(char *, size_t, char *);
 
 // Shared memory functions
@@ -19,9 +19,40 @@
 #include "precomp.h"
 
 #include "x86.h"
-#include "patchdiff.h"
 
-extern cpu_t patchdiff_cpu;
+/*------------------------------------------------*/
+/* function : x86_byte                            */
+/* arguments: byte span, offset                   */
+/* description: Returns the byte at offset i of   */
+/*              the span (0xFF past its end, like */
+/*              a missing byte in the database)   */
+/*------------------------------------------------*/
+
+static unsigned char x86_byte(const unsigned char *buf, size_t len, size_t i) {
+   return i < len ? buf[i] : 0xFF;
+}
+
+/*------------------------------------------------*/
+/* function : x86_word                            */
+/* arguments: byte span, offset                   */
+/* description: Returns the little endian word at */
+/*              offset i of the span              */
+/*------------------------------------------------*/
+
+static unsigned short x86_word(const unsigned char *buf, size_t len, size_t i) {
+   return x86_byte(buf, len, i) | (x86_byte(buf, len, i + 1) << 8);
+}
+
+/*------------------------------------------------*/
+/* function : x86_long                            */
+/* arguments: byte span, offset                   */
+/* description: Returns the little endian dword at*/
+/*              offset i of the span              */
+/*------------------------------------------------*/
+
+static unsigned long x86_long(const unsigned char *buf, size_t len, size_t i) {
+   return x86_word(buf, len, i) | ((unsigned long)x86_word(buf, len, i + 2) << 16);
+}
 
 /*------------------------------------------------*/
 /* function : x86_is_rex_prefix                   */
@@ -128,26 +159,28 @@ bool x86_is_dec_register (unsigned char val) {
 
 /*------------------------------------------------*/
 /* function : is_nop                              */
-/* arguments: unsigned char _byte                 */
+/* arguments: unsigned char _byte, byte span,     */
+/*            64-bit mode                         */
 /* description: detect if instruction is nop      */
 /*              (nop, mov reg, reg, ...)          */
 /*------------------------------------------------*/
 
-bool x86_is_nop (unsigned char _byte, ea_t ea) {
+bool x86_is_nop (unsigned char _byte, const unsigned char *buf, size_t len, bool x64) {
+   size_t i = 0;
    unsigned char val;
    unsigned short val2;
    unsigned long val3;
 
-   if (patchdiff_cpu == CPU_X8664 && x86_is_rex_prefix(_byte)) {
+   if (x64 && x86_is_rex_prefix(_byte)) {
       while (x86_is_rex_prefix(_byte)) {
-         ea++;
-         _byte = get_byte(ea);
+         i++;
+         _byte = x86_byte(buf, len, i);
       }
    }
 
    // mov reg, reg - xchg reg, reg
    if (_byte == 0x8A || _byte == 0x8B || _byte == 0x87 || _byte == 0x86) {
-      val = get_byte(ea + 1);
+      val = x86_byte(buf, len, i + 1);
       if ( (val == 0xC0) || // mov eax, eax (al, al)
               (val == 0xC9) || // mov ecx, ecx
               (val == 0xDB) || // mov ebx, ebx
@@ -160,7 +193,7 @@ bool x86_is_nop (unsigned char _byte, ea_t ea) {
       }
    }
    if (_byte == 0x8D) {
-      val = get_byte(ea + 1);
+      val = x86_byte(buf, len, i + 1);
       if ( (val == 0x00) || // lea eax, [eax]
               (val == 0x09) || // lea ecx, [ecx]
               (val == 0x42) || // lea edx, [edx]
@@ -176,7 +209,7 @@ bool x86_is_nop (unsigned char _byte, ea_t ea) {
               (val == 0x6d) || // lea ebp, [ebp+0]
               (val == 0x76) || // lea esi, [esi+0]
               (val == 0x7f) ) { // lea edi, [edi+0]
-         val = get_byte(ea + 2);
+         val = x86_byte(buf, len, i + 2);
          if (val == 0x00) {
             return true;
          }
@@ -188,36 +221,36 @@ bool x86_is_nop (unsigned char _byte, ea_t ea) {
               (val == 0xad) || // lea ebp, [ebp+0x00000000]
               (val == 0xB6) || // lea esi, [esi+0x00000000]
               (val == 0xBf) ) {  // lea edi, [edi+0x00000000]
-         val3 = get_long(ea + 2);
+         val3 = x86_long(buf, len, i + 2);
          if (val3 == 0x00) {
            return true;
          }
       }
       else if (val == 0xb4) {
-         val = get_byte(ea + 2);
+         val = x86_byte(buf, len, i + 2);
          if (val == 0x26) {
-            val3 = get_long(ea + 3);
+            val3 = x86_long(buf, len, i + 3);
             if (val3 == 0x00) {  // lea esi, [esi+0x00000000]
                return true;
             }
          }
       }
       else if (val == 0x24) {
-         val = get_byte(ea + 2);
+         val = x86_byte(buf, len, i + 2);
          if (val == 0x24) {  // lea esp, [esp]
            return true;
          }
       }
       else if (val == 0x64) {
-         val2 = get_word(ea + 2);
+         val2 = x86_word(buf, len, i + 2);
          if (val2 == 0x24) {  // lea esp, [esp+0]
            return true;
          }
       }
       else if (val == 0xa4) {
-         val = get_byte(ea + 2);
+         val = x86_byte(buf, len, i + 2);
          if (val == 0x24) {
-            val3 = get_long(ea + 3);
+            val3 = x86_long(buf, len, i + 3);
             if (val3 == 0x00) {  // lea esp, [esp+0x00000000]
                return true;
             }
@@ -235,14 +268,15 @@ bool x86_is_nop (unsigned char _byte, ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : x86_remove_instr                    */
-/* arguments: unsigned char byte, ea_t ea         */
+/* arguments: unsigned char byte, byte span,      */
+/*            64-bit mode                         */
 /* description: Returns true is the instruction   */
 /*              must be ignored                   */
 /*------------------------------------------------*/
 
-bool x86_remove_instr(unsigned char byte, ea_t ea) {
+bool x86_remove_instr(unsigned char byte, const unsigned char *buf, size_t len, bool x64) {
    // removes nop
-   if (x86_is_nop(byte, ea)) {
+   if (x86_is_nop(byte, buf, len, x64)) {
       return true;
    }
 
@@ -251,17 +285,17 @@ bool x86_remove_instr(unsigned char byte, ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : x86_convert_16bit_rep               */
-/* arguments: unsigned char val, instr address    */
+/* arguments: unsigned char val, byte span        */
 /* description: converts byte if instruction is a */
 /*              16 bit rep/repe/repz/repne/repnz  */
 /* notes: detects changes like 66 F3 -> F3 66     */
 /*------------------------------------------------*/
 
-bool x86_convert_16bit_rep(unsigned char *byte, ea_t ea) {
+bool x86_convert_16bit_rep(unsigned char *byte, const unsigned char *buf, size_t len) {
    unsigned char byte2;
 
    if (*byte == 0x66) {
-      byte2 = get_byte(ea + 1);
+      byte2 = x86_byte(buf, len, 1);
       if (byte2 == 0xF3 || byte2 == 0xF2) {
          *byte = byte2;
          return true;
@@ -273,17 +307,17 @@ bool x86_convert_16bit_rep(unsigned char *byte, ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : x86_convert_cond_jump               */
-/* arguments: unsigned char val, instr address    */
+/* arguments: unsigned char val, byte span        */
 /* description: converts byte if instruction is a */
 /*              conditionnal jump. If jnz returns */
 /*              jz, if jne return je, ...         */
 /*------------------------------------------------*/
 
-bool x86_convert_cond_jump(unsigned char *byte, ea_t ea) {
+bool x86_convert_cond_jump(unsigned char *byte, const unsigned char *buf, size_t len) {
    unsigned char byte2 = *byte;
 
    if (byte2 == 0x0F) {
-      byte2 = get_byte(ea + 1) - 0x10;
+      byte2 = x86_byte(buf, len, 1) - 0x10;
    }
 
    if (byte2 >= 0x70 && byte2 <= 0x7F) {
@@ -323,18 +357,19 @@ bool x86_convert_cond_jump(unsigned char *byte, ea_t ea) {
 }
 
 /*------------------------------------------------*/
-/* function : x86_convert_cond_jump               */
-/* arguments: unsigned char val, instr address    */
-/* description: converts byte if instruction is a */
-/*              conditionnal jump. If jnz returns */
-/*              jz, if jne return je, ...         */
+/* function : x86_is_cond_jump_pos                */
+/* arguments: byte span                           */
+/* description: Returns 1 if the instruction is a */
+/*              positive conditionnal jump (jz,   */
+/*              ja, ...), 2 if negative (jnz, ...)*/
+/*              and 0 otherwise                   */
 /*------------------------------------------------*/
 
-int x86_is_cond_jump_pos(ea_t ea) {
-   unsigned char byte2 = get_byte(ea);
+int x86_is_cond_jump_pos(const unsigned char *buf, size_t len) {
+   unsigned char byte2 = x86_byte(buf, len, 0);
 
    if (byte2 == 0x0F) {
-      byte2 = get_byte(ea + 1) - 0x10;
+      byte2 = x86_byte(buf, len, 1) - 0x10;
    }
 
    if (byte2 >= 0x70 && byte2 <= 0x7F) {
@@ -357,43 +392,33 @@ int x86_is_cond_jump_pos(ea_t ea) {
 }
 
 /*------------------------------------------------*/
-/* function : x86_get_fake_jump                   */
-/* arguments: ea_t ea                             */
-/* description: Returns jump for jump $5/$2       */
+/* function : x86_is_fake_jump                    */
+/* arguments: byte span                           */
+/* description: Returns TRUE for jump $5/$2       */
 /*------------------------------------------------*/
 
-ea_t x86_get_fake_jump(ea_t ea) {
+bool x86_is_fake_jump(const unsigned char *buf, size_t len) {
    unsigned char byte;
-   unsigned long l;
 
-   byte = get_byte(ea);
+   byte = x86_byte(buf, len, 0);
    if (byte == 0xE9) {
-      l = get_long(ea + 1);
-      if (l == 0) {
-         return get_item_end(ea);
-      }
+      return x86_long(buf, len, 1) == 0;
    }
    else if (byte == 0xeb) {
-      byte = get_byte(ea + 1);
-      if (byte == 0) {
-         return get_item_end(ea);
-      }
+      return x86_byte(buf, len, 1) == 0;
    }
 
-   return BADADDR;
+   return false;
 }
 
 /*------------------------------------------------*/
 /* function : x86_is_direct_jump                  */
-/* arguments: ea_t ea                             */
+/* arguments: byte span                           */
 /* description: Returns TRUE if a direct jump     */
 /*------------------------------------------------*/
 
-bool x86_is_direct_jump(ea_t ea) {
-   unsigned char byte;
-
-   byte = get_byte(ea);
-   switch (byte) {
+bool x86_is_direct_jump(const unsigned char *buf, size_t len) {
+   switch (x86_byte(buf, len, 0)) {
    case 0xE9:
    case 0xEA:
    case 0xEB:
@@ -402,18 +427,16 @@ bool x86_is_direct_jump(ea_t ea) {
    default:
       return false;
    }
-
-   return false;
 }
 
 /*------------------------------------------------*/
 /* function : x86_is_end_block                    */
-/* arguments: ea_t ea                             */
+/* arguments: byte span                           */
 /* description: Returns true on int 3             */
 /*------------------------------------------------*/
 
-bool x86_is_end_block(ea_t ea) {
-   if (get_byte(ea) == 0xCC) {
+bool x86_is_end_block(const unsigned char *buf, size_t len) {
+   if (x86_byte(buf, len, 0) == 0xCC) {
       return true;
    }
 
@@ -422,24 +445,29 @@ bool x86_is_end_block(ea_t ea) {
 
 /*------------------------------------------------*/
 /* function : x86_get_byte                        */
-/* arguments: unsigned char _byte                 */
+/* arguments: byte span, 64-bit mode              */
 /* description: Returns opcode                    */
 /* note: convert push/pop registers and remove rex*/
 /*       prefix                                   */
 /*------------------------------------------------*/
 
-unsigned char x86_get_byte(ea_t ea) {
+unsigned char x86_get_byte(const unsigned char *buf, size_t len, bool x64) {
    unsigned char byte;
+   size_t i = 0;
 
-   byte = get_byte(ea);
+   byte = x86_byte(buf, len, 0);
 
-   if (patchdiff_cpu == CPU_X8664) {
+   if (x64) {
       while (x86_is_rex_prefix(byte)) {
-         ea++;
-         byte = get_byte(ea);
+         i++;
+         byte = x86_byte(buf, len, i);
       }
    }
 
+   // the conversions below read the bytes following the prefixes
+   buf += i;
+   len = i < len ? len - i : 0;
+
    if (x86_is_push_register(byte)) {
       byte = 0x50;  // push eax
    }
@@ -453,8 +481,8 @@ unsigned char x86_get_byte(ea_t ea) {
       byte = 0x48;  // dec eax
    }
 
-   x86_convert_16bit_rep(&byte, ea);
-   x86_convert_cond_jump(&byte, ea);
+   x86_convert_16bit_rep(&byte, buf, len);
+   x86_convert_cond_jump(&byte, buf, len);
 
    return byte;
 }
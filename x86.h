@@ -21,11 +21,18 @@
 
 #include "precomp.h"
 
-unsigned char x86_get_byte(ea_t);
-bool x86_remove_instr(unsigned char, ea_t);
-bool x86_is_end_block(ea_t);
-bool x86_is_direct_jump(ea_t ea);
-ea_t x86_get_fake_jump(ea_t);
-int x86_is_cond_jump_pos(ea_t);
+// Instruction heuristics: pure functions of the instruction bytes, given as
+// a span starting at the instruction (bytes past its end read as 0xFF).
+// They do not use the IDA API and are part of the standalone core.
+
+// the largest x86 instruction
+#define X86_MAX_INSN 15
+
+unsigned char x86_get_byte(const unsigned char *, size_t, bool);
+bool x86_remove_instr(unsigned char, const unsigned char *, size_t, bool);
+bool x86_is_end_block(const unsigned char *, size_t);
+bool x86_is_direct_jump(const unsigned char *, size_t);
+bool x86_is_fake_jump(const unsigned char *, size_t);
+int x86_is_cond_jump_pos(const unsigned char *, size_t);
 
 #endif